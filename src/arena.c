@@ -0,0 +1,205 @@
+/* arena.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Memory regions for a proof run. See arena.h
+**/
+#include "common.h"
+#include "arena.h"
+#include "error_handling.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/**
+   Set by the commandline option -A|--allocation-statistics in main.c
+**/
+extern bool allocation_statistics;
+
+/**
+   The allocations counted for each source line calling arena_alloc. 
+   Only used with -A|--allocation-statistics, and protected by arena_sites_mutex, 
+   since the arenas of parallel branches are used by different threads
+**/
+#define ARENA_MAX_SITES 64
+
+typedef struct arena_site_t {
+  const char * file;
+  unsigned int line;
+  unsigned long n_allocs;
+  unsigned long n_bytes;
+} arena_site;
+
+static arena_site arena_sites[ARENA_MAX_SITES];
+static unsigned int n_arena_sites = 0;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t arena_sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void count_arena_site(const char* file, unsigned int line, size_t size){
+  unsigned int i;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& arena_sites_mutex), __FILE__, __LINE__, "arena.c: count_arena_site: mutex lock");
+#endif
+  for(i = 0; i < n_arena_sites; i++){
+    if(arena_sites[i].line == line && strcmp(arena_sites[i].file, file) == 0)
+      break;
+  }
+  if(i == n_arena_sites && n_arena_sites < ARENA_MAX_SITES){
+    arena_sites[i].file = file;
+    arena_sites[i].line = line;
+    arena_sites[i].n_allocs = 0;
+    arena_sites[i].n_bytes = 0;
+    n_arena_sites++;
+  }
+  if(i < n_arena_sites){
+    arena_sites[i].n_allocs++;
+    arena_sites[i].n_bytes += size;
+  }
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& arena_sites_mutex), __FILE__, __LINE__, "arena.c: count_arena_site: mutex unlock");
+#endif
+}
+
+arena* init_arena(size_t block_size){
+  arena* a = malloc_tester(sizeof(arena));
+  a->block_size = block_size;
+  a->first = NULL;
+  a->current = NULL;
+  a->last = NULL;
+  a->n_blocks = 0;
+  a->n_bytes = 0;
+  return a;
+}
+
+void destroy_arena(arena* a){
+  arena_block* block = a->first;
+  while(block != NULL){
+    arena_block* next = block->next;
+    free(block);
+    block = next;
+  }
+  free(a);
+}
+
+/**
+   Makes all blocks free, without touching the blocks after the first. 
+   These are emptied by _arena_alloc when it gets to them. 
+   All memory from the arena is then invalid.
+**/
+void reset_arena(arena* a){
+  a->current = a->first;
+  if(a->current != NULL)
+    a->current->used = 0;
+  a->n_bytes = 0;
+}
+
+/**
+   Moves the blocks of src to dest, and empties src. 
+   The memory allocated from src is then valid until dest is reset or destroyed.
+   The blocks are put first in dest, such that they are reused after the next reset.
+**/
+void merge_arena(arena* dest, arena* src){
+  if(src->first == NULL)
+    return;
+  if(dest->first == NULL){
+    dest->current = src->current;
+    dest->last = src->last;
+  } else 
+    src->last->next = dest->first;
+  dest->first = src->first;
+  dest->n_blocks += src->n_blocks;
+  dest->n_bytes += src->n_bytes;
+  src->first = NULL;
+  src->current = NULL;
+  src->last = NULL;
+  src->n_blocks = 0;
+  src->n_bytes = 0;
+}
+
+/**
+   Appends a new block with room for at least size bytes
+**/
+void add_arena_block(arena* a, size_t size){
+  arena_block* block;
+  if(size < a->block_size)
+    size = a->block_size;
+  block = malloc_tester(sizeof(arena_block) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  if(a->last == NULL)
+    a->first = block;
+  else
+    a->last->next = block;
+  a->last = block;
+  a->current = block;
+  a->n_blocks++;
+}
+
+void* _arena_alloc(arena* a, size_t size, const char* file, unsigned int line){
+  void* retval;
+  if(allocation_statistics)
+    count_arena_site(file, line, size);
+  if(a == NULL)
+    return malloc_tester(size);
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  while(a->current != NULL && a->current->used + size > a->current->size){
+    a->current = a->current->next;
+    if(a->current != NULL)
+      a->current->used = 0;
+  }
+  if(a->current == NULL)
+    add_arena_block(a, size);
+  retval = ((char*) (a->current + 1)) + a->current->used;
+  a->current->used += size;
+  a->n_bytes += size;
+  return retval;
+}
+
+char* _arena_strdup(arena* a, const char* s, const char* file, unsigned int line){
+  char* copy = _arena_alloc(a, strlen(s) + 1, file, line);
+  strcpy(copy, s);
+  return copy;
+}
+
+/**
+   Copies the n first characters of s, which need not be terminated by '\0'
+**/
+char* _arena_strndup(arena* a, const char* s, size_t n, const char* file, unsigned int line){
+  char* copy = _arena_alloc(a, n + 1, file, line);
+  memcpy(copy, s, n);
+  copy[n] = '\0';
+  return copy;
+}
+
+/**
+   Called from main.c after each theory with -A|--allocation-statistics
+**/
+void print_arena_statistics(const arena* a, FILE* f){
+  unsigned int i;
+  fprintf(f, "Allocated %zu bytes in %zu arena blocks.\n", a->n_bytes, a->n_blocks);
+  for(i = 0; i < n_arena_sites; i++)
+    fprintf(f, "\t%s:%u: %lu allocations, %lu bytes\n", arena_sites[i].file, arena_sites[i].line, arena_sites[i].n_allocs, arena_sites[i].n_bytes);
+}
+
+void reset_arena_statistics(void){
+  n_arena_sites = 0;
+}
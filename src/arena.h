@@ -0,0 +1,79 @@
+/* arena.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_ARENA_H
+#define __INCLUDED_ARENA_H
+
+#include "common.h"
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_BRANCH_BLOCK_SIZE 4096
+
+/**
+   Memory regions for the data that lives until the end of a proof run, 
+   such as the fresh constants and the ground atoms.
+
+   The memory is taken from a list of blocks, and is never freed separately. 
+   reset_arena makes all blocks available again, without freeing them, 
+   such that the next theory can use the same blocks. 
+   The blocks after current are free.
+
+   An arena is not locked, and must only be used by one thread at a time. 
+   The copies of the rete state made for parallel branches therefore have their own arenas, 
+   which are added to the arena of the parent by merge_arena when the copy is deleted.
+
+   The blocks have at least block_size bytes. The arenas of the copies use the smaller 
+   ARENA_BRANCH_BLOCK_SIZE, since there may be many short branches.
+   n_bytes is the number of bytes allocated since the last reset.
+**/
+typedef struct arena_block_t {
+  struct arena_block_t * next;
+  size_t size;
+  size_t used;
+} arena_block;
+
+typedef struct arena_t {
+  arena_block * first;
+  arena_block * current;
+  arena_block * last;
+  size_t block_size;
+  size_t n_blocks;
+  size_t n_bytes;
+} arena;
+
+arena* init_arena(size_t);
+void destroy_arena(arena*);
+void reset_arena(arena*);
+void merge_arena(arena*, arena*);
+
+/**
+   Allocates size bytes from the arena, or with malloc_tester if the arena is NULL.
+   With -A|--allocation-statistics the allocations are counted for each line calling arena_alloc
+**/
+#define arena_alloc(a, size) _arena_alloc((a), (size), __FILE__, __LINE__)
+#define arena_strdup(a, s) _arena_strdup((a), (s), __FILE__, __LINE__)
+#define arena_strndup(a, s, n) _arena_strndup((a), (s), (n), __FILE__, __LINE__)
+void* _arena_alloc(arena*, size_t, const char*, unsigned int);
+char* _arena_strdup(arena*, const char*, const char*, unsigned int);
+char* _arena_strndup(arena*, const char*, size_t, const char*, unsigned int);
+
+void print_arena_statistics(const arena*, FILE*);
+void reset_arena_statistics(void);
+#endif
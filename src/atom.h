@@ -47,6 +47,7 @@ void print_fol_atom(const clp_atom*, const constants*, FILE*);
 void print_coq_atom(const clp_atom*, const constants*, FILE*);
 void print_geolog_atom(const clp_atom*, const constants*, FILE*);
 
+unsigned int hash_atom(const clp_atom*, constants*, bool literal);
 bool equal_atoms(const clp_atom*, const clp_atom*, constants*, timestamps* ts, timestamp_store* store, bool update_ts);
 
 #endif
@@ -102,7 +102,7 @@ clp_term* create_function_term(const char* function, const term_list *args){
 
 /**
    Since equality of constants is later checked based on
-   pointer equality of "char* name", we use parser_new_constant
+   pointer equality of "char* name", we use the symbol table of the theory
    to check if this constant name has already been used
 
    In the prover, fresh_exist_constant creates always new constants, 
@@ -110,16 +110,28 @@ clp_term* create_function_term(const char* function, const term_list *args){
 **/
 clp_term* parser_create_constant_term(theory* th, const char* name){
   clp_term* t =  _init_term(constant_term, _create_term_list(0));
-  t->val.constant = parser_new_constant(th->constants, name);
+  symbol* s = intern_symbol(th->symbols, name, strlen(name));
+  if(!s->is_constant){
+    s->is_constant = true;
+    s->constant_no = insert_constant_name(th->constants, s->name).id;
+  }
+  t->val.constant = th->constants->constants[s->constant_no].elem;
   return t;
 }
 
 /**
    Called from constants.c to get a new term.
-   The number is already ok.
+   The number is already ok. The term is allocated in the arena a, 
+   or with malloc if a is NULL
 **/
-clp_term* prover_create_constant_term(dom_elem constant){
-  clp_term* t = _init_term(constant_term, _create_term_list(0));
+clp_term* prover_create_constant_term(dom_elem constant, arena* a){
+  clp_term* t = arena_alloc(a, sizeof(clp_term));
+  term_list* args = arena_alloc(a, sizeof(term_list));
+  args->n_args = 0;
+  args->size_args = 0;
+  args->args = NULL;
+  t->type = constant_term;
+  t->args = args;
   t->val.constant = constant;
   return t;
 }
@@ -346,6 +358,47 @@ bool literally_equal_terms(const clp_term* t1, const clp_term* t2, constants* co
   return _equal_terms(t1, t2, constants, ts, store, update_ts, true);
 }
 
+/**
+   Hash values of terms, used by the indexes of the substitution stores.
+
+   If literal is true, the constant ids are hashed, and the hash value 
+   is compatible with literally_equal_terms. 
+   Otherwise the roots of the equivalence classes of the constants are hashed, 
+   and the value is compatible with equal_terms, but only as long as no new 
+   equalities are added to the constants (see version in constants_struct.h)
+**/
+unsigned int hash_term_list(const term_list* tl, constants* cs, bool literal){
+  unsigned int i;
+  unsigned int h = tl->n_args;
+  for(i = 0; i < tl->n_args; i++)
+    h = (h * 31) ^ hash_term(tl->args[i], cs, literal);
+  return h;
+}
+
+unsigned int hash_term(const clp_term* t, constants* cs, bool literal){
+  unsigned int h;
+  switch(t->type){
+  case constant_term:
+    h = literal ? t->val.constant.id : get_constant_root(t->val.constant, cs);
+    h = (h + 1) * 2654435761u;
+    break;
+  case function_term:
+    h = ((unsigned long) t->val.function) ^ hash_term_list(t->args, cs, literal);
+    break;
+  case variable_term:
+    h = t->val.var->var_no;
+    break;
+  default:
+    fprintf(stderr, "Untreated term type in hash_term in atom_and_term.c.\n");
+    exit(EXIT_FAILURE);
+  }
+  return h;
+}
+
+unsigned int hash_atom(const clp_atom* a, constants* cs, bool literal){
+  return (a->pred->pred_no * 2654435761u) ^ hash_term_list(a->args, cs, literal);
+}
+
 /* 
    Assumes t is a constant or variable. 
    Returns the constant, or the value in sub of the constant
@@ -372,6 +425,8 @@ bool true_ground_equality(const clp_term* t1, const clp_term* t2, const substitu
 bool equal_atoms(const clp_atom* a1, const clp_atom* a2, constants* constants, timestamps* ts, timestamp_store* store, bool update_ts){
   if(a1->pred->pred_no != a2->pred->pred_no)
     return false;
+  if(a1->args == a2->args)
+    return true;
   return equal_term_lists(a1->args, a2->args, constants, ts, store, update_ts, false);
 }
 
@@ -119,29 +119,39 @@ void delete_axiom(clp_axiom* a){
    This is the only place where net->lazy is used, and it leads to setting the
    propagate value of alpha nodes in the left hand side to the opposite value
 
+   If net->plan_joins is set, the conjuncts in the lhs are joined in the order given by
+   create_planned_conjunction in con_dis.c. The axiom itself is not changed.
 **/
 rete_node* create_rete_axiom_node(rete_net* net, const clp_axiom* ax, unsigned int axiom_no, bool use_beta_not){
   rete_node* node;
   const freevars* rule_free_vars;
+  clp_conjunction* planned_lhs = NULL;
+  const clp_conjunction* lhs = ax->lhs;
   if(ax->type != goal) {
     rule_free_vars = ax->rhs->free_vars;
   } else {   // not normal 
     assert(ax->type == goal);
     rule_free_vars = init_freevars();
   }
+  if(net->plan_joins){
+    planned_lhs = create_planned_conjunction(net, ax->lhs);
+    lhs = planned_lhs;
+  }
   node = create_rete_conj_node(net, 
-			       ax->lhs, 
+			       lhs, 
 			       rule_free_vars,
 			       !(net->lazy),
 			       true,
 			       axiom_no);
   if(ax->type != goal && use_beta_not && ax->lhs->n_args > 2) {
     node  = insert_beta_not_nodes(net, 
-				  ax->lhs, 
+				  lhs, 
 				  ax->rhs, 
 				  node, 
 				  axiom_no);
   }
+  if(planned_lhs != NULL)
+    delete_planned_conjunction(planned_lhs);
   return create_rule_node(net, node, ax, rule_free_vars, axiom_no);
 }
     
@@ -204,6 +214,7 @@ bool test_axiom(const clp_axiom* a, size_t no, const constants* cs){
     }
   }
   assert(found_exist == a->is_existential);  
+  del_freevars(fv);
   return true;
 }
 
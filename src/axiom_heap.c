@@ -0,0 +1,133 @@
+/* axiom_heap.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   The weighted heap of axioms used by the strategy. See axiom_heap.h
+**/
+#include "common.h"
+#include "axiom_heap.h"
+
+void init_axiom_heap(axiom_heap* h, unsigned int n_axioms){
+  unsigned int i;
+  h->n_axioms = n_axioms;
+  h->n_heap = 0;
+  h->heap = calloc_tester(n_axioms + 1, sizeof(unsigned int));
+  h->pos = calloc_tester(n_axioms + 1, sizeof(unsigned int));
+  h->weights = calloc_tester(n_axioms + 1, sizeof(unsigned int));
+  for(i = 0; i < n_axioms; i++)
+    h->pos[i] = n_axioms;
+}
+
+void destroy_axiom_heap(axiom_heap* h){
+  free(h->heap);
+  free(h->pos);
+  free(h->weights);
+}
+
+void clear_axiom_heap(axiom_heap* h){
+  unsigned int i;
+  for(i = 0; i < h->n_heap; i++)
+    h->pos[h->heap[i]] = h->n_axioms;
+  h->n_heap = 0;
+}
+
+bool axiom_heap_less(const axiom_heap* h, unsigned int a, unsigned int b){
+  return h->weights[a] < h->weights[b] || (h->weights[a] == h->weights[b] && a < b);
+}
+
+void swap_axiom_heap(axiom_heap* h, unsigned int i, unsigned int j){
+  unsigned int tmp = h->heap[i];
+  h->heap[i] = h->heap[j];
+  h->heap[j] = tmp;
+  h->pos[h->heap[i]] = i;
+  h->pos[h->heap[j]] = j;
+}
+
+void sift_up_axiom_heap(axiom_heap* h, unsigned int pos){
+  while(pos > 0 && axiom_heap_less(h, h->heap[pos], h->heap[(pos - 1) / 2])){
+    swap_axiom_heap(h, pos, (pos - 1) / 2);
+    pos = (pos - 1) / 2;
+  }
+}
+
+void sift_down_axiom_heap(axiom_heap* h, unsigned int pos){
+  while(2 * pos + 1 < h->n_heap){
+    unsigned int child = 2 * pos + 1;
+    if(child + 1 < h->n_heap && axiom_heap_less(h, h->heap[child + 1], h->heap[child]))
+      child++;
+    if(!axiom_heap_less(h, h->heap[child], h->heap[pos]))
+      break;
+    swap_axiom_heap(h, pos, child);
+    pos = child;
+  }
+}
+
+/**
+   Inserts the axiom with the weight, or changes its weight if it is already in the heap
+**/
+void set_axiom_heap_weight(axiom_heap* h, unsigned int axiom_no, unsigned int weight){
+  unsigned int pos = h->pos[axiom_no];
+  assert(axiom_no < h->n_axioms);
+  if(pos == h->n_axioms){
+    pos = h->n_heap++;
+    h->heap[pos] = axiom_no;
+    h->pos[axiom_no] = pos;
+  } else if(h->weights[axiom_no] == weight)
+    return;
+  h->weights[axiom_no] = weight;
+  sift_up_axiom_heap(h, pos);
+  sift_down_axiom_heap(h, h->pos[axiom_no]);
+}
+
+void remove_axiom_heap(axiom_heap* h, unsigned int axiom_no){
+  unsigned int pos = h->pos[axiom_no];
+  if(pos == h->n_axioms)
+    return;
+  h->n_heap--;
+  if(pos != h->n_heap){
+    unsigned int moved = h->heap[h->n_heap];
+    h->heap[pos] = moved;
+    h->pos[moved] = pos;
+    sift_up_axiom_heap(h, pos);
+    sift_down_axiom_heap(h, h->pos[moved]);
+  }
+  h->pos[axiom_no] = h->n_axioms;
+}
+
+bool axiom_heap_is_empty(const axiom_heap* h){
+  return h->n_heap == 0;
+}
+
+bool axiom_in_heap(const axiom_heap* h, unsigned int axiom_no){
+  return h->pos[axiom_no] != h->n_axioms;
+}
+
+/**
+   Returns the axiom with the least weight. The heap must not be empty
+**/
+unsigned int peek_axiom_heap(const axiom_heap* h){
+  assert(h->n_heap > 0);
+  return h->heap[0];
+}
+
+unsigned int get_axiom_heap_weight(const axiom_heap* h, unsigned int axiom_no){
+  assert(axiom_in_heap(h, axiom_no));
+  return h->weights[axiom_no];
+}
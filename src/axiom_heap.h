@@ -0,0 +1,58 @@
+/* axiom_heap.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_AXIOM_HEAP_H
+#define __INCLUDED_AXIOM_HEAP_H
+
+#include "common.h"
+
+/**
+   A binary min-heap of axiom numbers, ordered by a weight per axiom, 
+   used by normal_next_instance in strategy.c. 
+   Ties are broken by the axiom number, such that the order is the same
+   as when scanning the weights from axiom 0 and upwards.
+
+   The heap is kept in the rete state and updated when instances are pushed 
+   or popped, instead of being rebuilt at each step. 
+   pos[i] is the position of axiom i in heap, or n_axioms if it is not in the heap.
+   weights[i] is only defined when axiom i is in the heap.
+
+   The heap is only changed by the prover thread of the rete state, and is not locked.
+**/
+typedef struct axiom_heap_t {
+  unsigned int * heap;
+  unsigned int * pos;
+  unsigned int * weights;
+  unsigned int n_heap;
+  unsigned int n_axioms;
+} axiom_heap;
+
+void init_axiom_heap(axiom_heap*, unsigned int n_axioms);
+void destroy_axiom_heap(axiom_heap*);
+void clear_axiom_heap(axiom_heap*);
+
+void set_axiom_heap_weight(axiom_heap*, unsigned int axiom_no, unsigned int weight);
+void remove_axiom_heap(axiom_heap*, unsigned int axiom_no);
+
+bool axiom_heap_is_empty(const axiom_heap*);
+bool axiom_in_heap(const axiom_heap*, unsigned int axiom_no);
+unsigned int peek_axiom_heap(const axiom_heap*);
+unsigned int get_axiom_heap_weight(const axiom_heap*, unsigned int axiom_no);
+#endif
@@ -33,6 +33,7 @@
 #include "axiom.h"
 #include "theory.h"
 #include "parser.h"
+#include "filereader.h"
 
  
 
@@ -42,7 +43,8 @@
 
   char* theory_name = NULL;
 
-  extern FILE* clpl_in;
+  extern void clpl_scan_input(input_buffer*, symbol_table*);
+  extern void clpl_end_input(void);
   
   extern int fileno(FILE*);
   extern int clpl_lineno;
@@ -59,7 +61,7 @@
 
 
 %union{
-  char* str;
+  const char* str;
   clp_atom* atom;
   clp_term* term;
   term_list* terms;
@@ -229,12 +231,19 @@ void clpl_error(YYLTYPE *locp, char const *msg){
 }
 
 
+/**
+   The input is read from memory, see filereader.h, and the names are interned 
+   in the symbol table of the theory by the lexer, see symbol_table.h
+**/
 theory* clpl_parser(FILE* f){
+  input_buffer* input = init_input_buffer(f);
   th = create_theory();
-  clpl_in = f;
+  clpl_scan_input(input, th->symbols);
   clpl_lineno = 1;
   //yydebug = 1;
   clpl_parse();
+  clpl_end_input();
+  destroy_input_buffer(input);
   finalize_theory(th);
   return th;
 }
@@ -233,6 +233,112 @@ rete_node * create_rete_conj_node(rete_net* net,
   return left_parent;
 }
 
+/**
+   The join planner, used by create_rete_axiom_node when net->plan_joins is set.
+
+   Returns a shallow copy of con with the conjuncts reordered greedily. At each step the
+   cheapest placeable conjunct is chosen, compared in this order:
+   - an equality whose variables are all bound by the conjuncts to the left is always chosen first,
+     an equality with unbound variables cannot be placed
+   - conjuncts sharing a variable with the conjuncts to the left (or having no variables) before cross products
+   - fewer variables not bound to the left (constants in the atom count as bound)
+   - fewer facts with this predicate in the initial model (net->static_fact_counts)
+   - higher arity, that is, more argument positions tested in the alpha nodes and the beta join
+   - the position in the original conjunction
+
+   If no conjunct can be placed, the first remaining conjunct is taken, as in the original order.
+
+   Since the same copy is passed to insert_beta_not_nodes, the beta-not nodes are still inserted
+   as far left as their free variables allow.
+
+   The atoms and freevars are shared with con, only the copy itself must be freed by delete_planned_conjunction
+**/
+typedef struct join_cost_t {
+  bool connected;
+  unsigned int n_new_vars;
+  unsigned int n_facts;
+  size_t arity;
+  unsigned int pos;
+} join_cost;
+
+bool join_cost_less(const join_cost* a, const join_cost* b){
+  if(a->connected != b->connected)
+    return a->connected;
+  if(a->n_new_vars != b->n_new_vars)
+    return a->n_new_vars < b->n_new_vars;
+  if(a->n_facts != b->n_facts)
+    return a->n_facts < b->n_facts;
+  if(a->arity != b->arity)
+    return a->arity > b->arity;
+  return a->pos < b->pos;
+}
+
+join_cost get_join_cost(const rete_net* net, const clp_atom* at, const freevars* bound, unsigned int pos){
+  join_cost cost;
+  freevars* at_vars = free_atom_variables(at, init_freevars());
+  freevars_iter iter = get_freevars_iter(at_vars);
+  cost.connected = at_vars->n_vars == 0 || bound->n_vars == 0;
+  cost.n_new_vars = 0;
+  while(has_next_freevars_iter(&iter)){
+    if(is_in_freevars(bound, next_freevars_iter(&iter)))
+      cost.connected = true;
+    else
+      cost.n_new_vars++;
+  }
+  del_freevars(at_vars);
+  cost.n_facts = net->static_fact_counts[at->pred->pred_no];
+  cost.arity = at->pred->arity;
+  cost.pos = pos;
+  return cost;
+}
+
+clp_conjunction* create_planned_conjunction(const rete_net* net, const clp_conjunction* con){
+  unsigned int i, j;
+  clp_conjunction* ret_val = malloc_tester(sizeof(clp_conjunction));
+  bool* placed = calloc_tester(con->n_args, sizeof(bool));
+  freevars* bound = init_freevars();
+  *ret_val = *con;
+  ret_val->args = calloc_tester(con->size_args, sizeof(clp_atom*));
+  assert(net->static_fact_counts != NULL);
+  for(i = 0; i < con->n_args; i++){
+    unsigned int best = con->n_args;
+    join_cost best_cost = {false, 0, 0, 0, 0};
+    for(j = 0; j < con->n_args; j++){
+      if(placed[j])
+	continue;
+      if(con->args[j]->pred->is_equality){
+	freevars* eq_vars = free_atom_variables(con->args[j], init_freevars());
+	bool placeable = freevars_included(eq_vars, bound);
+	del_freevars(eq_vars);
+	if(placeable){
+	  best = j;
+	  break;
+	}
+      } else {
+	join_cost cost = get_join_cost(net, con->args[j], bound, j);
+	if(best == con->n_args || join_cost_less(&cost, &best_cost)){
+	  best = j;
+	  best_cost = cost;
+	}
+      }
+    }
+    if(best == con->n_args)
+      for(best = 0; placed[best]; best++)
+	;
+    placed[best] = true;
+    ret_val->args[i] = con->args[best];
+    bound = free_atom_variables(con->args[best], bound);
+  }
+  del_freevars(bound);
+  free(placed);
+  return ret_val;
+}
+
+void delete_planned_conjunction(clp_conjunction* con){
+  free(con->args);
+  free(con);
+}
+
 /**
    The newer beta-not implementaion, inserts beta-not nodes as much to the left as possible
    taking into account that all variables in the lhs must occur to the left of the beta-not node
@@ -27,6 +27,20 @@
 #include "theory.h"
 #include "error_handling.h"
 
+/**
+   Source of the version numbers of the constants structures. 
+   See constants_struct.h
+**/
+static unsigned long constants_version_counter = 0;
+
+unsigned long next_constants_version(){
+#ifdef __GNUC__
+  return __sync_add_and_fetch(&constants_version_counter, 1);
+#else
+  return ++constants_version_counter;
+#endif
+}
+
 constants* init_constants(unsigned int init_size){
   constants * new_c = malloc_tester(sizeof(constants));
   new_c->fresh = init_fresh_const(init_size);
@@ -34,6 +48,14 @@ constants* init_constants(unsigned int init_size){
   new_c->size_constants = init_size;
   new_c->constants = calloc_tester(new_c->size_constants, sizeof(constant));
   new_c->n_constants = 0;
+  new_c->retired_constants = NULL;
+  new_c->n_retired_constants = 0;
+  new_c->version = next_constants_version();
+  new_c->trail = NULL;
+  new_c->n_trail = 0;
+  new_c->size_trail = 0;
+  new_c->n_backups = 0;
+  new_c->arena = NULL;
 #ifdef HAVE_PTHREAD
   pthread_mutex_init(&new_c->constants_mutex, NULL);
 #endif
@@ -41,7 +63,12 @@ constants* init_constants(unsigned int init_size){
 }
 
 void destroy_constants(constants* c){
+  unsigned int i;
+  for(i = 0; i < c->n_retired_constants; i++)
+    free(c->retired_constants[i]);
+  free(c->retired_constants);
   free(c->constants);
+  free(c->trail);
 #ifdef HAVE_PTHREAD
   pthread_mutex_destroy(&c->constants_mutex);
 #endif
@@ -55,6 +82,15 @@ constants* copy_constants(const constants * orig, timestamp_store* ts_store){
   copy->constants = calloc_tester(orig->size_constants, sizeof(constant));
   memcpy(copy->constants, orig->constants, orig->size_constants * sizeof(constant));
   assert(copy->n_constants == orig->n_constants);
+  copy->retired_constants = NULL;
+  copy->n_retired_constants = 0;
+  copy->trail = NULL;
+  copy->n_trail = 0;
+  copy->size_trail = 0;
+  copy->n_backups = 0;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init(&copy->constants_mutex, NULL);
+#endif
   for(i = 0; i < copy->n_constants; i++)
     copy_timestamps(& copy->constants[i].steps, & orig->constants[i].steps, ts_store, false);
   return copy;
@@ -64,6 +100,22 @@ const char* get_constant_name(dom_elem c, const constants* cs){
   return c.name;
 }
 
+/**
+   Doubles the array of constants. The finds in the rete workers do not lock, and may 
+   still be reading the old array, so it is kept until the constants are destroyed. 
+   The old arrays are together smaller than the new one. 
+   Only the prover changes the constants, so the entries are not changed during the copying.
+**/
+void grow_constants_array(constants* cs){
+  constant* old = cs->constants;
+  constant* grown = calloc_tester(cs->size_constants * 2, sizeof(constant));
+  memcpy(grown, old, cs->size_constants * sizeof(constant));
+  cs->retired_constants = realloc_tester(cs->retired_constants, (cs->n_retired_constants + 1) * sizeof(constant*));
+  cs->retired_constants[cs->n_retired_constants++] = old;
+  cs->size_constants *= 2;
+  __atomic_store_n(& cs->constants, grown, __ATOMIC_RELEASE);
+}
+
 /**
    
 **/
@@ -73,17 +125,15 @@ dom_elem insert_constant_name(constants * consts, const char* name){
   assert(name != NULL && strlen(name) > 0);
   new_const_ind = consts->n_constants;
   consts->n_constants++;
-  if(consts->size_constants <= consts->n_constants){
-    consts->size_constants *= 2;
-    consts->constants = realloc_tester(consts->constants, consts->size_constants * sizeof(constant));
-  }
+  if(consts->size_constants <= consts->n_constants)
+    grow_constants_array(consts);
   new_c = & consts->constants[new_const_ind];
-  new_c->elem.name = malloc_tester(strlen(name)+2);
-  strcpy((char*) new_c->elem.name, name);
+  new_c->elem.name = arena_strdup(consts->arena, name);
   new_c->rank = 0;
   new_c->parent = new_const_ind;
+  new_c->next_in_class = new_const_ind;
   new_c->elem.id = new_const_ind;
-  init_empty_timestamp_linked_list(& new_c->steps, false);
+  init_empty_timestamp_vector(& new_c->steps, false);
   return new_c->elem;
 }
 
@@ -92,40 +142,99 @@ dom_elem insert_constant_name(constants * consts, const char* name){
 **/
 const clp_term* get_fresh_constant(clp_variable* var, constants* constants){
   dom_elem new_const;
-  char* name;
+  char name[strlen(var->name) + 20];
   const clp_term* t;
   assert(constants->fresh != NULL);
   unsigned int const_no = next_fresh_const_no(constants->fresh, var->var_no);
   constants->n_constants ++;
-  name = calloc_tester(sizeof(char), strlen(var->name) + 20);
   sprintf(name, "%s_%i", var->name, const_no);
   new_const = insert_constant_name(constants, name);
-  t = prover_create_constant_term(new_const);
+  t = prover_create_constant_term(new_const, constants->arena);
   return t;
 }
 
+/**
+   Records the present values of constant c on the trail, if there is a backup. 
+   Must be called with the constants locked, before c is changed
+**/
+void push_constants_trail(constants* cs, unsigned int c){
+  constants_trail_entry* entry;
+  if(cs->n_backups == 0)
+    return;
+  if(cs->n_trail >= cs->size_trail){
+    cs->size_trail = (cs->size_trail == 0) ? 32 : cs->size_trail * 2;
+    cs->trail = realloc_tester(cs->trail, cs->size_trail * sizeof(constants_trail_entry));
+  }
+  entry = & cs->trail[cs->n_trail];
+  entry->c = c;
+  entry->parent = cs->constants[c].parent;
+  entry->rank = cs->constants[c].rank;
+  entry->next_in_class = cs->constants[c].next_in_class;
+  entry->steps = cs->constants[c].steps;
+  cs->n_trail++;
+}
+
+/**
+   Reads the parent of c. Pairs with the compare-and-swap in link_constant_root, 
+   such that the steps of c are completely written when c is seen to have another parent
+**/
+unsigned int get_constant_parent(const constants* cs, unsigned int c){
+  const constant* array = __atomic_load_n(& cs->constants, __ATOMIC_ACQUIRE);
+  return __atomic_load_n(& array[c].parent, __ATOMIC_ACQUIRE);
+}
+
 /**
    Part of union-find alg. 
    http://en.wikipedia.org/wiki/Disjoint-set_data_structure
+
+   Does not lock, and does not change the structure, so it can run concurrently 
+   with other finds and with union_constants. There is no path compression, 
+   the union by rank keeps the paths logarithmic.
+   
+   If update_ts is true, the steps of each constant on the path to the root are added to ts. 
+   These are the timestamps of the equalities used.
+   The steps of the root are not read, since it may be being linked by union_constants.
+   The array of constants is loaded for each read, since insert_constant_name may replace it, see grow_constants_array.
 **/
 unsigned int find_constant_root(unsigned int c, constants* cs, timestamps* ts, timestamp_store* store, bool update_ts){
-  if(cs->constants[c].parent != c)
-    cs->constants[c].parent = find_constant_root(cs->constants[c].parent, cs, ts, store, update_ts);
-  if(update_ts)
-    add_timestamps(ts, & cs->constants[c].steps, store);
-  return cs->constants[c].parent;
+  unsigned int parent = get_constant_parent(cs, c);
+  while(parent != c){
+    if(update_ts)
+      add_timestamps(ts, & __atomic_load_n(& cs->constants, __ATOMIC_ACQUIRE)[c].steps, store);
+    c = parent;
+    parent = get_constant_parent(cs, c);
+  }
+  return c;
+}
+
+/**
+   Makes root a child of new_root, after the steps of root have been updated. 
+   The circular lists of the two classes are joined by swapping the next_in_class of the roots.
+   Only called from union_constants, with the constants locked.
+**/
+void link_constant_root(constants* cs, unsigned int root, unsigned int new_root){
+  unsigned int next = cs->constants[root].next_in_class;
+  cs->constants[root].next_in_class = cs->constants[new_root].next_in_class;
+  cs->constants[new_root].next_in_class = next;
+  if(!__sync_bool_compare_and_swap(& cs->constants[root].parent, root, new_root))
+    assert(false);
 }
 
 
 /**
    Part of union-find alg. 
    http://en.wikipedia.org/wiki/Disjoint-set_data_structure
+
+   The lock only serializes union_constants with other changes of the structure
+   (other unions, backup and restore), which also need the trail. 
+   The finds do not lock. The steps of the old root are therefore written before 
+   it is linked to the new root, see find_constant_root.
 **/
 void union_constants(dom_elem c1, dom_elem c2, constants* consts, unsigned int step, timestamp_store* store){
   timestamps * tmp1 = malloc_tester(sizeof(timestamps));
   timestamps* tmp2 = malloc_tester(sizeof(timestamps));
-  init_empty_timestamp_linked_list(tmp1, false);
-  init_empty_timestamp_linked_list(tmp2, false);
+  init_empty_timestamp_vector(tmp1, false);
+  init_empty_timestamp_vector(tmp2, false);
 #ifdef HAVE_PTHREAD
 #ifdef __DEBUG_RETE_PTHREAD
   fprintf(stderr, "Locking constants (union)\n");
@@ -144,19 +253,24 @@ void union_constants(dom_elem c1, dom_elem c2, constants* consts, unsigned int s
     fprintf(stderr, "Unlocking constants (union 1)\n");
 #endif
 #endif
+    free(tmp1);
+    free(tmp2);
     return;
   }
+  push_constants_trail(consts, c1_root);
+  push_constants_trail(consts, c2_root);
   if(consts->constants[c1_root].rank < consts->constants[c2_root].rank){
-    consts->constants[c1_root].parent = c2_root;
     add_equality_timestamp(& consts->constants[c1_root].steps, step, store, true);
     add_timestamps(& consts->constants[c1_root].steps, tmp2, store);
+    link_constant_root(consts, c1_root, c2_root);
   } else {
-    consts->constants[c2_root].parent = c1_root;
     add_equality_timestamp(& consts->constants[c2_root].steps, step, store, false);
     add_timestamps(& consts->constants[c2_root].steps, tmp1, store);
+    link_constant_root(consts, c2_root, c1_root);
     if(!(consts->constants[c1_root].rank > consts->constants[c2_root].rank))
       consts->constants[c1_root].rank++;
   }
+  consts->version = next_constants_version();
 #ifdef HAVE_PTHREAD
   pt_err(pthread_mutex_unlock(& consts->constants_mutex), __FILE__,  __LINE__, "union_constants: mutex_lock");
 #ifdef __DEBUG_RETE_PTHREAD
@@ -168,6 +282,77 @@ void union_constants(dom_elem c1, dom_elem c2, constants* consts, unsigned int s
 }
 
 
+/**
+   Returns the id of the root of the equivalence class of c.
+   Does not do path compression and does not collect timestamps, 
+   so it does not change the union-find structure. 
+   Used for hashing terms modulo equality
+**/
+unsigned int get_constant_root(dom_elem c, constants* cs){
+  return find_constant_root(c.id, cs, NULL, NULL, false);
+}
+
+bool is_constant_classes_root(unsigned int root, const constant_classes* classes){
+  unsigned int i;
+  for(i = 0; i < classes->n_roots; i++){
+    if(classes->roots[i] == root)
+      return true;
+  }
+  return false;
+}
+
+/**
+   Returns the set of the equivalence classes of the n_ids constants with the given ids.
+   Ids of constants that do not exist anymore, because a backup was restored, are ignored. 
+   The members are found by following next_in_class from each root, so the time is linear 
+   in the size of the classes, not in the number of constants. 
+   Called from the rete workers while the prover does not change the union-find structure, 
+   see recheck_rete_state_net. The array of constants is loaded for each read, since it may be grown.
+**/
+constant_classes get_constant_classes(constants* cs, const unsigned int* ids, unsigned int n_ids){
+  constant_classes classes;
+  unsigned int i, size_members = 0;
+  unsigned int n_constants = cs->n_constants;
+  classes.roots = malloc_tester((n_ids + 1) * sizeof(unsigned int));
+  classes.n_roots = 0;
+  classes.members = NULL;
+  classes.n_members = 0;
+  for(i = 0; i < n_ids; i++){
+    unsigned int root, c;
+    if(ids[i] >= n_constants)
+      continue;
+    root = find_constant_root(ids[i], cs, NULL, NULL, false);
+    if(is_constant_classes_root(root, &classes))
+      continue;
+    classes.roots[classes.n_roots++] = root;
+    c = root;
+    do {
+      if(classes.n_members >= size_members){
+	size_members = (size_members == 0) ? 16 : 2 * size_members;
+	classes.members = realloc_tester(classes.members, size_members * sizeof(unsigned int));
+      }
+      classes.members[classes.n_members++] = c;
+      c = __atomic_load_n(& cs->constants, __ATOMIC_ACQUIRE)[c].next_in_class;
+    } while(c != root);
+  }
+  return classes;
+}
+
+/**
+   Returns true if the constant with the given id is in one of the classes. 
+   Constants created after the classes are only included if they have been 
+   made equal to a constant in the classes
+**/
+bool in_constant_classes(unsigned int id, const constant_classes* classes, constants* cs){
+  return is_constant_classes_root(find_constant_root(id, cs, NULL, NULL, false), classes);
+}
+
+void destroy_constant_classes(constant_classes* classes){
+  free(classes->roots);
+  if(classes->members != NULL)
+    free(classes->members);
+}
+
 /**
    Part of union-find alg. 
    http://en.wikipedia.org/wiki/Disjoint-set_data_structure
@@ -175,48 +360,73 @@ void union_constants(dom_elem c1, dom_elem c2, constants* consts, unsigned int s
    If update_ts is true, the timestamps of the steps needed to infer the equality are added to ts, even if they are not equal
    It is assumed that the timestamps are discarded if the constants are unequal
 
-   TODO: At the moment, locking is disabled, since I did not manage to debug a frequent deadlock.
-   It might be that it is ok not to lock, since the changes done by find_constant_root could be compatible?
+   Does not lock, see find_constant_root. Called from the rete workers when joining and unifying.
 **/
-bool equal_constants_locked(dom_elem c1, dom_elem c2, constants* consts, timestamps* ts, timestamp_store* store, bool update_ts){
+bool equal_constants_mt(dom_elem c1, dom_elem c2, constants* consts, timestamps* ts, timestamp_store* store, bool update_ts){
   if(c1.id == c2.id)
     return true;
-  unsigned int p1 = find_constant_root(c1.id, consts, ts, store, update_ts);
-  unsigned int p2 = find_constant_root(c2.id, consts, ts, store, update_ts);
-  return p1 == p2;
+  return find_constant_root(c1.id, consts, ts, store, update_ts) == find_constant_root(c2.id, consts, ts, store, update_ts);
 }
 
-bool equal_constants_mt(dom_elem c1, dom_elem c2, constants* consts, timestamps* ts, timestamp_store* store, bool update_ts){
-  if(c1.id == c2.id)
-    return true;
-#ifdef __DEBUG_RETE_PTHREAD
-  fprintf(stderr, "Locking constants (equal): %i\n", (unsigned int) pthread_self());
-#endif
+
+/**
+   Called from rete_state_single when in a disjunctive split. 
+   Starts recording changes on the trail, if this is not already done. 
+   The workers must be paused.
+**/
+constants_backup backup_constants(constants* cs){
+  constants_backup backup;
 #ifdef HAVE_PTHREAD
-  pt_err(pthread_mutex_lock(& consts->constants_mutex),__FILE__,  __LINE__,  "union_constants: mutex_lock");
-#ifdef __DEBUG_RETE_PTHREAD
-  fprintf(stderr, "Locked constants (equal): %i\n", (unsigned int) pthread_self());
-#endif
+  pt_err(pthread_mutex_lock(& cs->constants_mutex), __FILE__, __LINE__, "backup_constants: mutex_lock");
 #endif
-  bool rv = equal_constants_locked(c1, c2, consts, ts, store, update_ts);
-#ifdef __DEBUG_RETE_PTHREAD
-  fprintf(stderr, "Unlocking constants (equal): %i\n", (unsigned int) pthread_self());
+  backup.trail_mark = cs->n_trail;
+  backup.n_constants = cs->n_constants;
+  backup.version = cs->version;
+  cs->n_backups++;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& cs->constants_mutex), __FILE__, __LINE__, "backup_constants: mutex_unlock");
 #endif
+  return backup;
+}
+
+/**
+   Undoes all changes to the union-find structure since the backup. 
+   The timestamps put back are still valid, since timestamp blocks 
+   are only appended to, see timestamp_vector.h. 
+   The workers must be paused.
+**/
+void restore_constants(constants* cs, const constants_backup* backup){
 #ifdef HAVE_PTHREAD
-  pt_err(pthread_mutex_unlock(& consts->constants_mutex), __FILE__,  __LINE__,  "union_constants: mutex_unlock");
-#ifdef __DEBUG_RETE_PTHREAD
-  fprintf(stderr, "Unlocked constants (equal): %i\n", (unsigned int) pthread_self());
+  pt_err(pthread_mutex_lock(& cs->constants_mutex), __FILE__, __LINE__, "restore_constants: mutex_lock");
 #endif
+  assert(cs->n_backups > 0 && backup->trail_mark <= cs->n_trail);
+  while(cs->n_trail > backup->trail_mark){
+    constants_trail_entry* entry;
+    constant* c;
+    cs->n_trail--;
+    entry = & cs->trail[cs->n_trail];
+    c = & cs->constants[entry->c];
+    c->parent = entry->parent;
+    c->rank = entry->rank;
+    c->next_in_class = entry->next_in_class;
+    c->steps = entry->steps;
+  }
+  cs->n_constants = backup->n_constants;
+  cs->version = backup->version;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& cs->constants_mutex), __FILE__, __LINE__, "restore_constants: mutex_unlock");
 #endif
-  return rv;
 }
 
-
 /**
-   Called from rete_state when in a disjunctive split. 
+   Called when the backup is no longer needed. 
+   The trail is emptied when there are no more backups.
 **/
-constants* backup_constants(const constants* orig, timestamp_store* ts_store){
-  return copy_constants(orig,ts_store);
+void destroy_constants_backup(constants* cs, constants_backup* backup){
+  assert(cs->n_backups > 0);
+  cs->n_backups--;
+  if(cs->n_backups == 0)
+    cs->n_trail = 0;
 }
 
 /**
@@ -241,20 +451,6 @@ void destroy_constants_iter(constants_iter iter){
 }
 
  
-/**
-   Called from the parser (via create_constant_term in atom_and_term.c) 
-   when seeing a constant
-**/
-dom_elem parser_new_constant(constants* cs, const char* new){
-  unsigned int i;
-  for(i = 0; i < cs->n_constants; i++){
-    constant c = cs->constants[i];
-    if(strcmp(c.elem.name, new) == 0)
-      return c.elem;
-  }
-  return insert_constant_name(cs, new);
-}
-
 bool test_constant(dom_elem c, const constants* cs){
   assert(cs->size_constants > 0);
   assert(cs->constants != NULL);
@@ -32,17 +32,23 @@
 #include "timestamps.h"
 
 
-dom_elem parser_new_constant(constants*, const char*);
+dom_elem insert_constant_name(constants*, const char*);
 void print_coq_constants(const constants*,FILE* stream);
 const clp_term* get_fresh_constant(clp_variable*, constants*);
 const char* get_constant_name(dom_elem, const constants*);
 constants* init_constants(unsigned int);
 void destroy_constants(constants*);
 constants* copy_constants(const constants*, timestamp_store*);
-constants* backup_constants(const constants*, timestamp_store*);
+constants_backup backup_constants(constants*);
+void restore_constants(constants*, const constants_backup*);
+void destroy_constants_backup(constants*, constants_backup*);
 void print_all_constants(constants*, FILE*);
 bool equal_constants_mt(dom_elem, dom_elem, constants*, timestamps*, timestamp_store*, bool);
 void union_constants(dom_elem, dom_elem, constants*, unsigned int, timestamp_store*);
+unsigned int get_constant_root(dom_elem, constants*);
+constant_classes get_constant_classes(constants*, const unsigned int*, unsigned int);
+bool in_constant_classes(unsigned int, const constant_classes*, constants*);
+void destroy_constant_classes(constant_classes*);
 
 constants_iter get_constants_iter(constants*);
 bool constants_iter_has_next(constants*, constants_iter*);
@@ -29,6 +29,7 @@
 #include "common.h"
 #include "fresh_constants.h"
 #include "timestamps.h"
+#include "arena.h"
 #ifdef HAVE_PTHREAD
 #include <pthread.h>
 #endif
@@ -37,6 +38,10 @@
    Part of a union-find / disjoint set structure
 
    http://en.wikipedia.org/wiki/Disjoint-set_data_structure 
+
+   next_in_class links the constants of each equivalence class in a circular list, 
+   such that the members of a class can be found without going through all constants, 
+   see get_constant_classes
 **/
 typedef struct dom_elem_t {
   char* name;
@@ -49,22 +54,84 @@ typedef struct constant_t {
   timestamps steps;
   unsigned int parent;
   unsigned int rank;
+  unsigned int next_in_class;
   timestamps ts;
 } constant;
 
+/**
+   An entry on the undo trail of the union-find structure. 
+   Holds the values of the constant c before it was changed.
+**/
+typedef struct constants_trail_entry_t {
+  unsigned int c;
+  unsigned int parent;
+  unsigned int rank;
+  unsigned int next_in_class;
+  timestamps steps;
+} constants_trail_entry;
+
 /**
    Used by the rete state to keep track of the constants
+
+   version is changed every time two equivalence classes are merged. 
+   The values are taken from a global counter, such that two different
+   states of the union-find structure never have the same version. 
+   Copies keep the version, since they have the same roots, and restore_constants
+   puts back the version of the backup.
+   Used by the hash indexes in the substitution stores to know when they must be rebuilt.
+
+   While n_backups is positive, union_constants records the old values 
+   of the changed constants on the trail, such that restore_constants can undo the changes since a backup.
+
+   constants_mutex is only taken by the functions changing the union-find structure 
+   (union_constants, backup_constants and restore_constants). The finds do not lock, see find_constant_root in constants.c
+
+   The finds may read constants while insert_constant_name grows the array. The old arrays are therefore 
+   kept in retired_constants until the constants are destroyed.
+
+   arena is used for the names and terms of new constants. It is NULL for the constants 
+   of the theory, which then use malloc, and is the arena of the rete state for the copies in the states.
 **/
 typedef struct constants_t {
   fresh_const_counter fresh;
   constant* constants;
   size_t size_constants;
+  constant** retired_constants;
+  unsigned int n_retired_constants;
+  unsigned long version;
+  constants_trail_entry* trail;
+  unsigned int n_trail;
+  unsigned int size_trail;
+  unsigned int n_backups;
+  arena* arena;
 #ifdef HAVE_PTHREAD
   pthread_mutex_t constants_mutex;
 #endif
   unsigned int n_constants;
 } constants;
 
+/**
+   Returned by backup_constants. trail_mark is the length of the trail at the backup
+**/
+typedef struct constants_backup_t {
+  unsigned int trail_mark;
+  unsigned int n_constants;
+  unsigned long version;
+} constants_backup;
+
+/**
+   A set of equivalence classes of constants. roots are the different roots of the classes, 
+   and members are the ids of all constants in the classes when the set was created.
+   Created by get_constant_classes, and used when rechecking the rete network after an equality,
+   to find the substitutions and facts that contain a constant in one of the merged classes.
+**/
+typedef struct constant_classes_t {
+  unsigned int* roots;
+  unsigned int n_roots;
+  unsigned int* members;
+  unsigned int n_members;
+} constant_classes;
+
 typedef unsigned int constants_iter ;
 
 #endif
@@ -26,13 +26,20 @@
 #include "common.h"
 #include "fact_store.h"
 #include "instantiate.h"
+#include "term.h"
+#include "undo_trail.h"
 
 
-fact_store init_fact_store(){
+fact_store init_fact_store(unsigned int arity){
   fact_store new_store;
   new_store.max_n_facts = INIT_FACT_STORE_SIZE;
   new_store.n_facts = 0;
   new_store.store = calloc_tester(new_store.max_n_facts, sizeof(clp_atom));
+  new_store.fact_index = NULL;
+  new_store.arg_indexes = NULL;
+  new_store.arity = arity;
+  new_store.trail = NULL;
+  new_store.trail_generation = 0;
   return new_store;
 }
 
@@ -44,10 +51,37 @@ void destroy_fact_store(fact_store* store){
   }
   destroy_fact_store_iter(&fi);
 #endif
+  unsigned int i;
   free(store->store);
+  if(store->fact_index != NULL)
+    destroy_sub_store_index(store->fact_index);
+  if(store->arg_indexes != NULL){
+    for(i = 0; i < store->arity; i++){
+      if(store->arg_indexes[i] != NULL)
+	destroy_sub_store_index(store->arg_indexes[i]);
+    }
+    free(store->arg_indexes);
+  }
+}
+
+/**
+   Returns a copy of the store, used when the rete state is split in rete_state_single.c.
+   The facts share their arguments with the original. The indexes are created again on first use
+**/
+fact_store copy_fact_store(const fact_store* orig){
+  fact_store copy = *orig;
+  copy.store = calloc_tester(orig->max_n_facts, sizeof(clp_atom));
+  memcpy(copy.store, orig->store, orig->n_facts * sizeof(clp_atom));
+  copy.fact_index = NULL;
+  copy.arg_indexes = NULL;
+  copy.trail = NULL;
+  copy.trail_generation = 0;
+  return copy;
 }
 
 unsigned int alloc_store_fact(fact_store* store){
+  if(needs_undo_trail(store->trail, store->trail_generation))
+    push_fact_store_undo_trail(store->trail, store);
   store->n_facts ++;
   if(store->n_facts >= store->max_n_facts){
     store->max_n_facts *= 2;
@@ -78,17 +112,75 @@ fact_store_iter get_fact_store_iter(fact_store* store){
   fact_store_iter iter;
   iter.n = 0;
   iter.store = store;
+  iter.index = NULL;
+  return iter;
+}
+
+/**
+   Adds the facts not yet in the index. If the equalities between 
+   the constants have changed, all facts are rehashed.
+   If arg_no is negative, the whole facts are hashed, otherwise 
+   only the argument at position arg_no.
+**/
+void update_fact_store_index(fact_store* store, sub_store_index* index, int arg_no, constants* cs){
+  unsigned int i;
+  if(index->version != cs->version || index->n_entries > store->n_facts)
+    reset_sub_store_index(index, cs->version);
+  for(i = index->n_entries; i < store->n_facts; i++){
+    const clp_atom* fact = get_fact(i, store);
+    if(arg_no < 0)
+      add_sub_store_index(index, hash_atom(fact, cs, false));
+    else
+      add_sub_store_index(index, hash_term(fact->args->args[arg_no], cs, false));
+  }
+}
+
+fact_store_iter _get_fact_store_index_iter(fact_store* store, sub_store_index* index, unsigned int hash){
+  fact_store_iter iter = get_fact_store_iter(store);
+  iter.index = index;
+  iter.hash = hash;
+  iter.n = first_sub_store_index(index, hash);
   return iter;
 }
 
+/**
+   Iterates over the facts that may be equal to ground, modulo 
+   equality of constants. The facts are returned in the same order as by get_fact_store_iter
+**/
+fact_store_iter get_fact_store_atom_iter(fact_store* store, const clp_atom* ground, constants* cs){
+  if(store->fact_index == NULL)
+    store->fact_index = init_sub_store_index(NULL, false);
+  update_fact_store_index(store, store->fact_index, -1, cs);
+  return _get_fact_store_index_iter(store, store->fact_index, hash_atom(ground, cs, false));
+}
+
+/**
+   Iterates over the facts that may have a term equal to value at argument position arg_no. 
+   The facts are returned in the same order as by get_fact_store_iter
+**/
+fact_store_iter get_fact_store_arg_iter(fact_store* store, unsigned int arg_no, const clp_term* value, constants* cs){
+  assert(arg_no < store->arity);
+  if(store->arg_indexes == NULL)
+    store->arg_indexes = calloc_tester(store->arity, sizeof(sub_store_index*));
+  if(store->arg_indexes[arg_no] == NULL)
+    store->arg_indexes[arg_no] = init_sub_store_index(NULL, false);
+  update_fact_store_index(store, store->arg_indexes[arg_no], arg_no, cs);
+  return _get_fact_store_index_iter(store, store->arg_indexes[arg_no], hash_term(value, cs, false));
+}
+
 bool has_next_fact_store(fact_store_iter* iter){
+  if(iter->index != NULL)
+    return iter->n != SUB_STORE_INDEX_END;
   return iter->n < iter->store->n_facts;
 }
 
 const clp_atom* get_next_fact_store(fact_store_iter* iter){
   const clp_atom* a = get_fact(iter->n, iter->store);
   assert(iter->n < iter->store->n_facts);
-  iter->n ++;
+  if(iter->index != NULL)
+    iter->n = next_sub_store_index(iter->index, iter->n, iter->hash);
+  else
+    iter->n ++;
   return a;
 }
 
@@ -111,45 +203,23 @@ fact_store_backup backup_fact_store(fact_store* store){
 }
 
 void restore_fact_store(fact_store* store, fact_store_backup backup){
+  unsigned int i;
   assert(store == backup.store);
   store->n_facts = backup.n_facts;
+  if(store->fact_index != NULL && store->fact_index->n_entries > store->n_facts)
+    truncate_sub_store_index(store->fact_index, store->n_facts);
+  if(store->arg_indexes != NULL){
+    for(i = 0; i < store->arity; i++){
+      if(store->arg_indexes[i] != NULL && store->arg_indexes[i]->n_entries > store->n_facts)
+	truncate_sub_store_index(store->arg_indexes[i], store->n_facts);
+    }
+  }
 }
 
 void destroy_fact_backup(fact_store_backup * backup){
   ;
 }
 
-/**
-   Copies a fact_store iter array in orig of length n_iters to 
-   dest. Assumes the necessary memory in dest is already allocated
-**/
-void copy_fact_iter_array(fact_store_iter* dest, const fact_store_iter * orig, unsigned int n_iters){
-  memcpy(dest, orig, n_iters * sizeof(fact_store_iter));
-}
-
-
-/**
-   Auxiliaries for manipulating array of fact store backups
-**/
-
-fact_store_backup * backup_fact_store_array(fact_store* stores, unsigned int n_stores){
-  unsigned int i;
-  fact_store_backup* backups = calloc_tester(n_stores, sizeof(fact_store_backup));
-  for(i = 0; i < n_stores; i++)
-    backups[i] = backup_fact_store(& stores[i]);
-  return backups;
-}
-
-
-void destroy_fact_store_backup_array(fact_store_backup* backups, unsigned int n_backups){
-  unsigned int i;
-  for(i = 0; i < n_backups; i++)
-    destroy_fact_backup(& backups[i]);
-  free(backups);
-}
-
-
-
 /**
    Prints all facts currently in the "factset"
 **/
@@ -26,6 +26,9 @@
 
 #include "common.h"
 #include "atom.h"
+#include "substitution_store_index.h"
+
+struct undo_trail_t;
 
 /**
    A store of facts for use in state factsets
@@ -42,10 +45,26 @@
 **/
 
 
+/**
+   fact_index is a hash index on the whole facts, and arg_indexes
+   has one hash index for each argument position. 
+   The hash values are calculated modulo the equalities between constants, 
+   so the indexes are rebuilt when the version of the constants changes. 
+   The indexes are created on first use, and new facts are added to
+   them lazily, when they are used. arg_indexes is NULL until one of
+   them is used, and then has arity elements, the arity of the predicate.
+
+   trail is NULL, except for the factsets in the rete state, see undo_trail.h
+**/
 typedef struct fact_store_t {
   clp_atom * store; 
   unsigned int max_n_facts;
   unsigned int n_facts;
+  sub_store_index * fact_index;
+  sub_store_index ** arg_indexes;
+  unsigned int arity;
+  struct undo_trail_t* trail;
+  unsigned long trail_generation;
 } fact_store;
 
 typedef struct fact_store_backup_t {
@@ -53,19 +72,29 @@ typedef struct fact_store_backup_t {
   fact_store* store;
 } fact_store_backup;
 
+/**
+   If index is not NULL, only the facts in the index with the 
+   given hash value are iterated over. The caller must still check
+   that the returned facts match
+**/
 typedef struct fact_store_iter_t {
   unsigned int n;
   fact_store* store;
+  const sub_store_index* index;
+  unsigned int hash;
 } fact_store_iter;
 
-fact_store init_fact_store(void);
+fact_store init_fact_store(unsigned int arity);
 void destroy_fact_store(fact_store*);
+fact_store copy_fact_store(const fact_store*);
 unsigned int alloc_store_fact(fact_store*);
 void push_fact_store(fact_store*, const clp_atom*);
 const clp_atom* get_fact(unsigned int, fact_store*);
 bool is_empty_fact_store(fact_store*);
 
 fact_store_iter get_fact_store_iter(fact_store*);
+fact_store_iter get_fact_store_atom_iter(fact_store*, const clp_atom*, constants*);
+fact_store_iter get_fact_store_arg_iter(fact_store*, unsigned int, const clp_term*, constants*);
 bool has_next_fact_store(fact_store_iter*);
 const clp_atom* get_next_fact_store(fact_store_iter*);
 void destroy_fact_store_iter(fact_store_iter*);
@@ -75,9 +104,5 @@ fact_store_backup backup_fact_store(fact_store*);
 void restore_fact_store(fact_store*, fact_store_backup);
 void destroy_fact_backup(fact_store_backup*);
 
-fact_store_backup * backup_fact_store_array(fact_store*, unsigned int);
-void destroy_fact_store_backup_array(fact_store_backup*, unsigned int);
-void copy_fact_iter_array(fact_store_iter*, const fact_store_iter *, unsigned int);
-
 void print_fact_store(fact_store *, const constants*, FILE*);
 #endif
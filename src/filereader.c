@@ -19,159 +19,85 @@
 
 /*   Written July and August, 2008 by Dag Hovland, hovlanddag@gmail.com  */
 
-
-
+/**
+   Reads the input of the parsers into memory, see filereader.h
+**/
+#include "common.h"
+#include "filereader.h"
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <fcntl.h>
-
-#include "common.h"
-
-#define BUF_SIZE 16384
-
-
-char buf[BUF_SIZE];
-int fd;
-bool file_opened = false;
+#include <sys/mman.h>
 
-char * glob_filename = "stdin";
-
-char* line;
-size_t cur_buf_size, buf_pos;
-size_t line_size;
-
-bool file_finished;
-
-void init_all(){
-  file_finished = false;
-  buf_pos = 0;
-  cur_buf_size = 0;
-  line_size = 1024;
-  line = malloc_tester(line_size);
-  return;
-}
-
-
-void inc_line_size(size_t new_size){
-  assert(new_size > line_size);
-  line_size = new_size;
-  line = realloc_tester(line, line_size);
-}
-
-bool init_readfile(char* filename){
-  glob_filename = filename;
-  if(file_opened)
-    close(fd);
-  fd = open(filename, O_RDONLY);
-  if(fd == -1){
-    int error_num = errno;
-    if(error_num == EACCES){
-      fprintf(stderr, "grep: %s: Ikke tilgang\n", filename);
-      return false;
-    }
-    fprintf(stderr, "file open error on %s: ", filename);
-    perror("");
-    abort();
+/**
+   Maps the regular file fd with size bytes into memory, followed by at least two '\0'. 
+   An anonymous mapping large enough for the file and the two '\0' is made first, 
+   and the file is mapped over the start of it. The bytes after the end of the file are then 0, 
+   also when the size of the file is a multiple of the page size. 
+   Returns false if the file could not be mapped.
+**/
+bool map_input_file(input_buffer* input, int fd, size_t size){
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t size_mapping = ((size + 2 + page_size - 1) / page_size) * page_size;
+  void* mapping = mmap(NULL, size_mapping, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(mapping == MAP_FAILED)
+    return false;
+  if(mmap(mapping, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+    munmap(mapping, size_mapping);
+    return false;
   }
-  file_opened = true;
-  init_all();
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  input->data = mapping;
+  input->size = size;
+  input->size_mapping = size_mapping;
   return true;
 }
 
-bool init_readstd(){
-  fd = STDIN_FILENO;
-  init_all();
-  return true;
-}
-
-void fill_buffer(){
-  ssize_t read_ret_val = -1;
-  buf_pos = 0;
-  assert(!file_finished);
-  while(read_ret_val < 0){
-    read_ret_val = read(fd, buf, BUF_SIZE);
-    if(read_ret_val < 0){
-      int error_num = errno;
-      if(error_num == EISDIR)
-	read_ret_val = 0;
-      else if (errno != EINTR){
-	fprintf(stderr, "file read error on %s: ", glob_filename);
-	perror("");
-	abort();
-      }
-    }
-  } 
-  cur_buf_size = (size_t) read_ret_val;
-  if (cur_buf_size == 0) {
-    file_finished = true;
-    return;
-  }
-  return;
-}
-
-bool get_file_finished(){
-  return file_finished;
-}
-
-
 /**
-   line_start is the number of chars that should be skipped before copying text into line
-   line_len is set to the number of chars that are read into it,
-   such that position of end is line_start + line_len
-
-   line_end is the number of characters that should be allocated at the end of the string
+   Reads the rest of f into memory. Used for input that cannot be mapped, such as pipes
 **/
-char* nextline(size_t line_start, size_t* line_len, size_t line_end){
-  size_t line_pos = line_start; 
-  if(file_finished){
-    *line_len = 0;
-    return line;
-  }
-  if(buf_pos >= cur_buf_size){
-    fill_buffer();
-  }
-
-  while(buf[buf_pos] != '\n' && buf[buf_pos] != '\r'){
-    while(line_pos < line_size && buf[buf_pos] != '\n' && buf[buf_pos] != '\r' && buf_pos < cur_buf_size){
-      line[line_pos++] = buf[buf_pos++];
-    }
-    if(file_finished)
-      break;
-    if(buf_pos >= cur_buf_size)
-      fill_buffer();
-    
-    while(line_pos + line_end >= line_size)
-      inc_line_size( 2 * line_size );
-   
-  } 
-  if(!file_finished){
-    while(!file_finished && buf_pos >= cur_buf_size)
-      fill_buffer();
-    if(buf[buf_pos] == '\n')
-      buf_pos++;
-    else if(buf[buf_pos] == '\r'){
-      buf_pos++;
-      while(!file_finished && buf_pos >= cur_buf_size)
-	fill_buffer();
-      if(buf_pos < cur_buf_size && buf[buf_pos] == '\n') 
-	buf_pos++;
+void read_input_file(input_buffer* input, FILE* f){
+  size_t size_data = INPUT_READ_SIZE;
+  size_t n_read;
+  input->data = malloc_tester(size_data);
+  input->size = 0;
+  input->size_mapping = 0;
+  while((n_read = fread(input->data + input->size, 1, size_data - input->size - 2, f)) > 0){
+    input->size += n_read;
+    if(input->size + 2 == size_data){
+      size_data *= 2;
+      input->data = realloc_tester(input->data, size_data);
     }
   }
-  assert(line_pos - line_start >= 0);
-  if(line_pos > line_start || buf_pos != line_pos){
-    line[line_pos] = 0;
-    *line_len = line_pos - line_start;
-  } else {
-    *line_len = -1;
-    return NULL;
+  if(ferror(f)){
+    perror("filereader.c: read_input_file: Could not read input");
+    exit(EXIT_FAILURE);
   }
-  return line;
+  input->data[input->size] = '\0';
+  input->data[input->size + 1] = '\0';
 }
 
+/**
+   Called from the parsers. The file is mapped into memory if it is a regular file 
+   not yet read from, otherwise it is read.
+**/
+input_buffer* init_input_buffer(FILE* f){
+  input_buffer* input = malloc_tester(sizeof(input_buffer));
+  struct stat file_stat;
+  int fd = fileno(f);
+  if(fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0 
+     && ftello(f) == 0 && map_input_file(input, fd, file_stat.st_size))
+    return input;
+  read_input_file(input, f);
+  return input;
+}
 
-void end_readfile(){
-  close(fd);
-  free(line);
+void destroy_input_buffer(input_buffer* input){
+  if(input->size_mapping > 0){
+    if(munmap(input->data, input->size_mapping) != 0)
+      perror("filereader.c: destroy_input_buffer: Could not unmap input");
+  } else
+    free(input->data);
+  free(input);
 }
@@ -0,0 +1,46 @@
+/* filereader.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_FILEREADER_H
+#define __INCLUDED_FILEREADER_H
+
+#include "common.h"
+
+#define INPUT_READ_SIZE 16384
+
+/**
+   The whole input of a parser, followed by two '\0', as needed by yy_scan_buffer in the flex scanners. 
+   The scanners then read the tokens directly from the buffer, and the names are interned 
+   from there without being copied first, see symbol_table.h.
+
+   A regular file is mapped into memory with mmap, and size_mapping is the size of the mapping. 
+   The mapping is private and writable, since the scanners put a '\0' after each token while 
+   it is matched. Each page is therefore copied when it is scanned, but the file is never 
+   read through a separate buffer. 
+   Other input, such as a pipe on stdin, is read into memory with malloc, and size_mapping is 0.
+**/
+typedef struct input_buffer_t {
+  char* data;
+  size_t size;
+  size_t size_mapping;
+} input_buffer;
+
+input_buffer* init_input_buffer(FILE*);
+void destroy_input_buffer(input_buffer*);
+#endif
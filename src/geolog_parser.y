@@ -32,6 +32,7 @@
 #include "axiom.h"
 #include "theory.h"
 #include "parser.h"
+#include "filereader.h"
 
   extern int geolog_lex();
   extern int fileno(FILE*);
@@ -39,7 +40,8 @@
   //  void geolog_error(char*);
   theory *th;
   
-  extern FILE* geolog_in;
+  extern void geolog_scan_input(input_buffer*, symbol_table*);
+  extern void geolog_end_input(void);
   extern int geolog_lineno;
 
   
@@ -54,7 +56,7 @@
 %expect 0
 
 %union{
-  char* str;
+  const char* str;
   clp_atom* atom;
   clp_term* term;
   term_list* terms;
@@ -156,11 +158,18 @@ void geolog_error(YYLTYPE* locp, char const * s){
   exit(2);
 }
 
+/**
+   The input is read from memory, see filereader.h, and the names are interned 
+   in the symbol table of the theory by the lexer, see symbol_table.h
+**/
 theory* geolog_parser(FILE* f){
+  input_buffer* input = init_input_buffer(f);
   th = create_theory();
-  geolog_in = f;
+  geolog_scan_input(input, th->symbols);
   geolog_lineno = 1;
   geolog_parse();
+  geolog_end_input();
+  destroy_input_buffer(input);
   finalize_theory(th);
   return th;
 }
@@ -0,0 +1,168 @@
+/* ground_atoms.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   The hash-consing of ground atoms. See ground_atoms.h
+**/
+#include "common.h"
+#include "ground_atoms.h"
+#include "instantiate.h"
+#include "substitution.h"
+#include "error_handling.h"
+
+ground_atom_table* init_ground_atom_table(void){
+  ground_atom_table* table = malloc_tester(sizeof(ground_atom_table));
+#ifdef HAVE_PTHREAD
+  pthread_mutexattr_t mutex_attr;
+  pt_err(pthread_mutexattr_init(&mutex_attr),__FILE__, __LINE__, "ground_atoms.c: init_ground_atom_table: mutex attr init");
+#ifndef NDEBUG
+  pt_err(pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK_NP), __FILE__, __LINE__,  "ground_atoms.c: init_ground_atom_table: mutex attr settype");
+#endif
+  pt_err(pthread_mutex_init(& table->lock, & mutex_attr), __FILE__, __LINE__,   "ground_atoms.c: init_ground_atom_table: mutex init");
+  pt_err(pthread_mutexattr_destroy(&mutex_attr), __FILE__, __LINE__,   "ground_atoms.c: init_ground_atom_table: mutexattr destroy");
+#endif
+  table->size_table = GROUND_ATOM_TABLE_INIT_SIZE;
+  table->n_atoms = 0;
+  table->atoms = calloc_tester(table->size_table, sizeof(clp_atom*));
+  table->hashes = calloc_tester(table->size_table, sizeof(unsigned int));
+  return table;
+}
+
+/**
+   Frees the table. The atoms are freed with the arenas they are allocated in. 
+   Called when the rete state is deleted, after the proof is written.
+**/
+void destroy_ground_atom_table(ground_atom_table* table){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_destroy(& table->lock),__FILE__, __LINE__,  "ground_atoms.c: destroy_ground_atom_table: mutex destroy");
+#endif
+  free(table->atoms);
+  free(table->hashes);
+  free(table);
+}
+
+/**
+   The hash value of an atom with the predicate and arguments. 
+   Only the ids of the constants are used, not their equivalence classes
+**/
+unsigned int hash_ground_atom_args(const clp_predicate* pred, const clp_term** args, unsigned int n_args){
+  unsigned int i;
+  unsigned int h = (pred->pred_no + 1) * 2654435761u;
+  for(i = 0; i < n_args; i++)
+    h = (h * 31) ^ ((args[i]->val.constant.id + 1) * 2654435761u);
+  return h;
+}
+
+/**
+   The ids of the fresh constants are used again after backtracking, 
+   but with new names. Therefore both the id and the name must be the same.
+**/
+bool ground_atom_has_args(const clp_atom* a, const clp_predicate* pred, const clp_term** args, unsigned int n_args){
+  unsigned int i;
+  if(a->pred != pred)
+    return false;
+  for(i = 0; i < n_args; i++){
+    dom_elem c = a->args->args[i]->val.constant;
+    if(c.id != args[i]->val.constant.id || c.name != args[i]->val.constant.name)
+      return false;
+  }
+  return true;
+}
+
+/**
+   Doubles the size of the hash table. The table must be locked.
+**/
+void grow_ground_atom_table(ground_atom_table* table){
+  size_t i;
+  size_t old_size = table->size_table;
+  const clp_atom ** old_atoms = table->atoms;
+  unsigned int * old_hashes = table->hashes;
+  table->size_table *= 2;
+  table->atoms = calloc_tester(table->size_table, sizeof(clp_atom*));
+  table->hashes = calloc_tester(table->size_table, sizeof(unsigned int));
+  for(i = 0; i < old_size; i++){
+    if(old_atoms[i] != NULL){
+      size_t pos = old_hashes[i] & (table->size_table - 1);
+      while(table->atoms[pos] != NULL)
+	pos = (pos + 1) & (table->size_table - 1);
+      table->atoms[pos] = old_atoms[i];
+      table->hashes[pos] = old_hashes[i];
+    }
+  }
+  free(old_atoms);
+  free(old_hashes);
+}
+
+/**
+   Returns the instance of orig by sub. The atom is found in the table if it 
+   was instantiated before, otherwise it is allocated in a and put in the table.
+   The returned atom must not be freed or changed.
+
+   The arguments of orig must be constants or variables, as in the rete network, see get_dom_elem.
+   Atoms without arguments are not put in the table, orig is then returned.
+**/
+const clp_atom* instantiate_ground_atom(ground_atom_table* table, arena* a, const clp_atom* orig, const substitution* sub, const constants* cs){
+  unsigned int i, n_args = orig->args->n_args;
+  const clp_term* args[n_args > 0 ? n_args : 1];
+  const clp_atom* retval;
+  unsigned int hash;
+  size_t pos;
+  assert(test_atom(orig, cs));
+  assert(test_substitution(sub, cs));
+  if(n_args == 0)
+    return orig;
+  for(i = 0; i < n_args; i++){
+    assert(orig->args->args[i]->type != function_term);
+    args[i] = instantiate_term(orig->args->args[i], sub, cs);
+    assert(args[i]->type == constant_term);
+  }
+  hash = hash_ground_atom_args(orig->pred, args, n_args);
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& table->lock), __FILE__, __LINE__, "ground_atoms.c: instantiate_ground_atom: mutex lock");
+#endif
+  pos = hash & (table->size_table - 1);
+  while(table->atoms[pos] != NULL){
+    if(table->hashes[pos] == hash && ground_atom_has_args(table->atoms[pos], orig->pred, args, n_args))
+      break;
+    pos = (pos + 1) & (table->size_table - 1);
+  }
+  if(table->atoms[pos] == NULL){
+    clp_atom* new_atom = arena_alloc(a, sizeof(clp_atom));
+    term_list* new_args = arena_alloc(a, sizeof(term_list));
+    new_args->args = arena_alloc(a, (n_args + 1) * sizeof(clp_term*));
+    memcpy(new_args->args, args, n_args * sizeof(clp_term*));
+    new_args->n_args = n_args;
+    new_args->size_args = n_args + 1;
+    new_atom->pred = orig->pred;
+    new_atom->args = new_args;
+    table->atoms[pos] = new_atom;
+    table->hashes[pos] = hash;
+    table->n_atoms++;
+    if(2 * table->n_atoms > table->size_table)
+      grow_ground_atom_table(table);
+    retval = new_atom;
+  } else
+    retval = table->atoms[pos];
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& table->lock), __FILE__, __LINE__, "ground_atoms.c: instantiate_ground_atom: mutex unlock");
+#endif
+  assert(test_ground_atom(retval, cs));
+  return retval;
+}
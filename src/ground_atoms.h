@@ -0,0 +1,61 @@
+/* ground_atoms.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_GROUND_ATOMS_H
+#define __INCLUDED_GROUND_ATOMS_H
+
+#include "common.h"
+#include "atom.h"
+#include "substitution_struct.h"
+#include "constants_struct.h"
+#include "arena.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define GROUND_ATOM_TABLE_INIT_SIZE 1024
+
+/**
+   The hash-consing table of the ground atoms inserted by the prover.
+
+   Each ground atom exists only once, with the same predicate and the same constants 
+   (by id and name, not modulo equality). Two such atoms are therefore equal if and only if
+   they are the same pointer, and equal modulo the equalities if their args are the same pointer.
+
+   The atoms, their term lists and argument arrays are allocated in the arena of the 
+   rete state inserting them, see arena.h, and live until the arena of the proof run is reset.
+
+   atoms is an open addressing hash table with linear probing, and size_table is a power of 2.
+   The table is shared by a rete state and all its copies, and is protected by lock.
+**/
+typedef struct ground_atom_table_t {
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t lock;
+#endif
+  const clp_atom ** atoms;
+  unsigned int * hashes;
+  size_t size_table;
+  size_t n_atoms;
+} ground_atom_table;
+
+ground_atom_table* init_ground_atom_table(void);
+void destroy_ground_atom_table(ground_atom_table*);
+const clp_atom* instantiate_ground_atom(ground_atom_table*, arena*, const clp_atom*, const substitution*, const constants*);
+#endif
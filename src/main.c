@@ -76,9 +76,30 @@ extern char * optarg;
 extern int optind, optopt, opterr;
 bool use_substitution_store;
 bool output_theory;
-bool verbose, debug, proof, text, existdom, factset_lhs, coq, multithreaded, use_beta_not, print_model, all_disjuncts, dry_run, multithread_rete;
+bool verbose, debug, proof, text, existdom, factset_lhs, coq, multithreaded, use_beta_not, print_model, all_disjuncts, dry_run, multithread_rete, plan_joins;
+/**
+   Set by -A|--allocation-statistics. Used in arena.c
+**/
+bool allocation_statistics;
+/**
+   The memory of the ground atoms and fresh constants of a proof run. 
+   Reset after each theory, such that the next theory reuses the blocks. See arena.h
+**/
+arena* run_arena;
+/**
+   Set by -B|--batch=N. The files are then proved in parallel, each in its own process, 
+   with at most batch_size processes at a time. See run_batch below
+**/
+bool batch_mode;
+unsigned int batch_size;
+/**
+   The limits in seconds given by -t|--cputimer and -w|--wallclocktimer, or 0. 
+   They are limits for each theory, see start_prover_timers
+**/
+unsigned long cpu_timer_limit, wallclock_timer_limit;
 strategy strat;
 unsigned long maxsteps;
+unsigned int n_rete_threads;
 typedef enum format_type_t {coherent_tptp_format, full_tptp_format, clpl_format, geolog_format} format_type;
 format_type input_format;
 format_type output_format;
@@ -127,43 +148,55 @@ format_type get_format_arg_opt(){
 
 /**
    This is the function that is called when the cpu or wall timer expires.
-   Used in start_timer below
+   Used in start_timer below. 
+   The proof running is cancelled, and the prover continues with the next theory, see expire_prover_deadline. 
+   generation is the deadline generation of the theory the timer was started for. 
+   Since timer_delete does not wait for a running notification, the timer of an earlier theory may 
+   still expire, and is then ignored.
 **/
-void timer_expired(union sigval notify_data){
-  switch(notify_data.sival_int){
+void timer_expired(int timer_type, unsigned int generation){
+  if(!expire_prover_deadline(generation))
+    return;
+  switch(timer_type){
   case CLOCK_REALTIME:
-    printf("The wall-clock-time expired. You may rerun with higher --wallclocktime (-w).\n");
+    printf("The wall-clock-time expired. You may rerun with higher --wallclocktimer (-w).\n");
     break;
   case CLOCK_PROCESS_CPUTIME_ID:
-    printf("The cpu time expired. You may rerun with higher --cputime (-T).\n");
+    printf("The cpu time expired. You may rerun with higher --cputimer (-t).\n");
     break;
   default:
-    fprintf(stderr, "main.c: timer_expired: %i is not a valid timer clock type.\n",notify_data.sival_int);
+    fprintf(stderr, "main.c: timer_expired: %i is not a valid timer clock type.\n", timer_type);
     assert(false);
     break;
   }
-  exit(EXIT_FAILURE);
+}
+
+void wallclock_timer_expired(union sigval notify_data){
+  timer_expired(CLOCK_REALTIME, notify_data.sival_int);
+}
+
+void cpu_timer_expired(union sigval notify_data){
+  timer_expired(CLOCK_PROCESS_CPUTIME_ID, notify_data.sival_int);
 }
 
 /**
-   Called from cpu_timer and wallclock-timer below
-   Command line arguments T and w for timers
-   Starts a timer 
+   Called from start_cpu_timer and start_wallclock_timer below
+   Command line arguments t and w for timers
+   Starts a timer, which must be deleted with timer_delete. 
+   generation is given to timer_expired, see start_prover_deadline
 **/
-void start_timer(unsigned long int maxtimer, int timer_type){
+void start_timer(unsigned long int maxtimer, int timer_type, timer_t* timer, unsigned int generation){
   struct sigevent timer_event;
   struct timespec timeout;
   struct timespec zero_time;
   struct itimerspec timer_val;
-  timer_t * timer = malloc_tester(sizeof(timer_t));
 
   timer_event.sigev_notify = SIGEV_THREAD;
-  timer_event.sigev_notify_function = timer_expired;
+  timer_event.sigev_notify_function = (timer_type == CLOCK_REALTIME) ? wallclock_timer_expired : cpu_timer_expired;
   timer_event.sigev_notify_attributes = NULL;
   
 
-  timer_event.sigev_value.sival_int = timer_type;
-  timer_event.sigev_value.sival_ptr = NULL;
+  timer_event.sigev_value.sival_int = generation;
   
   if(timer_create(timer_type, &timer_event, timer) != 0){
     perror("main.c: file_prover: Could not create timer");
@@ -183,28 +216,48 @@ void start_timer(unsigned long int maxtimer, int timer_type){
 }
 
 /**
-   Called when argument --cputimer is seen
-   Starts a timer based on cpu time used
+   The timers for the theory being proved, started by start_prover_timers
 **/
-void start_cpu_timer(unsigned long int maxtimer){
-  start_timer(maxtimer, CLOCK_PROCESS_CPUTIME_ID);
+timer_t cpu_timer, wallclock_timer;
+
+/**
+   Called from file_prover before each theory is parsed. 
+   Starts the timers given by --cputimer and --wallclocktimer, 
+   such that the limits are for each theory.
+**/
+void start_prover_timers(void){
+  unsigned int generation = start_prover_deadline();
+  if(cpu_timer_limit > 0)
+    start_timer(cpu_timer_limit, CLOCK_PROCESS_CPUTIME_ID, &cpu_timer, generation);
+  if(wallclock_timer_limit > 0)
+    start_timer(wallclock_timer_limit, CLOCK_REALTIME, &wallclock_timer, generation);
 }
+
 /**
-   Called when argument --wallclocktimer is seen
-   Starts a timer based on wall clock time used
+   Called from file_prover when the prover is finished with a theory
 **/
-void start_wallclock_timer(unsigned long int maxtimer){
-    start_timer(maxtimer, CLOCK_REALTIME);
+void stop_prover_timers(void){
+  if(cpu_timer_limit > 0 && timer_delete(cpu_timer) != 0)
+    perror("main.c: stop_prover_timers: Could not delete cpu timer");
+  if(wallclock_timer_limit > 0 && timer_delete(wallclock_timer) != 0)
+    perror("main.c: stop_prover_timers: Could not delete wall clock timer");
 }
 
-int file_prover(FILE* f, const char* prefix, char* filename){
+/**
+   Parses the theory and runs the prover on it. 
+   steps is set to the number of steps in the proof, or 0 if no proof was found.
+   Returns EXIT_SUCCESS if a proof was found, or if the theory was parsed with -D|--dry-run.
+**/
+int file_prover(FILE* f, const char* prefix, char* filename, unsigned int* steps_found){
   theory* th;
   rete_net* net;
   FILE *fp;
-  int retval;
+  int retval = EXIT_FAILURE;
   unsigned int steps;
   SIGNATURE Signature;
   LISTNODE Head;
+  *steps_found = 0;
+  start_prover_timers();
   switch(input_format){
   case clpl_format:
     th = clpl_parser(f);
@@ -230,6 +283,7 @@ int file_prover(FILE* f, const char* prefix, char* filename){
       Head = ParseFileOfFormulae(filename,NULL, Signature,1,NULL);
     }
     PrintListOfAnnotatedTSTPNodes(stdout,Signature,Head,tptp,1);
+    stop_prover_timers();
     return false;
   case coherent_tptp_format:
     th = tptp_parser(f);
@@ -260,10 +314,15 @@ int file_prover(FILE* f, const char* prefix, char* filename){
   assert(test_theory(th));
   if(!has_theory_name(th))
     set_theory_name(th, prefix);
-  net = create_rete_net(th, maxsteps, existdom, strat, lazy, coq, use_beta_not, factset_lhs, print_model, all_disjuncts, verbose, multithread_rete);
+  net = create_rete_net(th, maxsteps, existdom, strat, lazy, coq, use_beta_not, factset_lhs, print_model, all_disjuncts, verbose, multithread_rete, n_rete_threads, plan_joins);
 
-  if(dry_run)
-    exit(EXIT_SUCCESS);
+  if(dry_run){
+    stop_prover_timers();
+    delete_rete_net(net);
+    delete_theory(th);
+    reset_arena(run_arena);
+    return EXIT_SUCCESS;
+  }
   if(!factset_lhs){  
     if(debug){
       fp = fopen("rete.dot", "w");
@@ -284,7 +343,9 @@ int file_prover(FILE* f, const char* prefix, char* filename){
     init_proof_coq_writer(net);
   
 
-  steps = prover_single(net, multithreaded);
+  steps = prover_single(net, multithreaded, run_arena);
+  stop_prover_timers();
+  *steps_found = steps;
   //steps = prover(net, multithreaded);
   if(steps > 0){
     printf("Found a proof after %i steps that the theory has no model\n", steps);
@@ -300,14 +361,238 @@ int file_prover(FILE* f, const char* prefix, char* filename){
   delete_rete_net(net);
     
   delete_theory(th);
-  //if(brk(mem_break) != 0)
-  //  perror("Error with resetting memory after proving file\n");
+  if(allocation_statistics){
+    print_arena_statistics(run_arena, stdout);
+    reset_arena_statistics();
+  }
+  reset_arena(run_arena);
   if(input_format == full_tptp_format){
     FreeListOfAnnotatedFormulae(&Head);
     FreeSignature(&Signature);
   }
   return retval;
 }
+
+/**
+   Proves the theory in the file at path, with the input format given on the commandline
+**/
+int prove_file(char* path, unsigned int* steps){
+  int retval;
+  FILE* f;
+  if(input_format == full_tptp_format)
+    return file_prover(NULL, basename(path), path, steps);
+  f = fopen(path, "r");
+  if(f == NULL){
+    perror("main: Could not open theory file");
+    fprintf(stderr, "Filename: '%s'\n", path); 
+    exit(EXIT_FAILURE);
+  }
+  retval = file_prover(f, basename(path), NULL, steps);
+  if(fclose(f) != 0){
+    perror("main(): Could not close theory file\n");
+    fprintf(stderr, "File name: %s\n", path); 
+    exit(EXIT_FAILURE);
+  }
+  return retval;
+}
+
+/**
+   The number of seconds a file in batch mode may run after the limits 
+   given by -t and -w before the process is killed, see run_batch_job
+**/
+#define BATCH_TIMER_GRACE 5
+
+/**
+   A file proved in its own process in batch mode. 
+   The process writes its result on the pipe result_fd before exiting, 
+   and its output to logname, see set_batch_log_names
+**/
+typedef struct batch_job_t {
+  char* path;
+  char* logname;
+  pid_t pid;
+  int result_fd;
+  struct timeval start;
+} batch_job;
+
+/**
+   Called in the process of a file in batch mode. 
+   The output is written to the file logname of the job in the current directory. 
+   The time limits are handled by the timers in file_prover. In addition, 
+   limits BATCH_TIMER_GRACE seconds higher are set with setrlimit and alarm, 
+   such that the process is killed by SIGXCPU or SIGALRM if it does not stop, 
+   for example when the limit is reached while parsing.
+**/
+void run_batch_job(batch_job* job, int result_fd){
+  unsigned int steps;
+  int retval;
+  const char* result;
+  prover_outcome outcome;
+  FILE* log;
+  struct rlimit limit;
+  log = fopen(job->logname, "w");
+  if(log == NULL){
+    perror("main.c: run_batch_job: Could not open log file");
+    fprintf(stderr, "File name: %s\n", job->logname);
+    exit(EXIT_FAILURE);
+  }
+  if(dup2(fileno(log), STDOUT_FILENO) < 0 || dup2(fileno(log), STDERR_FILENO) < 0){
+    perror("main.c: run_batch_job: Could not redirect output to log file");
+    exit(EXIT_FAILURE);
+  }
+  fclose(log);
+  limit.rlim_cur = 0;
+  limit.rlim_max = 0;
+  setrlimit(RLIMIT_CORE, &limit);
+  if(cpu_timer_limit > 0){
+    limit.rlim_cur = cpu_timer_limit + BATCH_TIMER_GRACE;
+    limit.rlim_max = cpu_timer_limit + BATCH_TIMER_GRACE + 1;
+    if(setrlimit(RLIMIT_CPU, &limit) != 0)
+      perror("main.c: run_batch_job: Could not set cpu time limit");
+  }
+  if(wallclock_timer_limit > 0)
+    alarm(wallclock_timer_limit + BATCH_TIMER_GRACE);
+  run_arena = init_arena(ARENA_BLOCK_SIZE);
+  retval = prove_file(job->path, &steps);
+  outcome = get_prover_outcome();
+  if(dry_run)
+    result = "dry-run";
+  else if(outcome == proof_outcome)
+    result = "proof";
+  else if(outcome == timeout_outcome)
+    result = "timeout";
+  else if(outcome == max_steps_outcome)
+    result = "max-steps";
+  else if(outcome == model_outcome)
+    result = "model";
+  else
+    result = "error";
+  dprintf(result_fd, "%s %u\n", result, steps);
+  close(result_fd);
+  exit(retval);
+}
+
+void start_batch_job(batch_job* job){
+  int fds[2];
+  if(pipe(fds) != 0){
+    perror("main.c: start_batch_job: Could not create pipe");
+    exit(EXIT_FAILURE);
+  }
+  fflush(stdout);
+  fflush(stderr);
+  gettimeofday(& job->start, NULL);
+  job->pid = fork();
+  if(job->pid < 0){
+    perror("main.c: start_batch_job: Could not fork");
+    exit(EXIT_FAILURE);
+  }
+  if(job->pid == 0){
+    close(fds[0]);
+    run_batch_job(job, fds[1]);
+  }
+  close(fds[1]);
+  job->result_fd = fds[0];
+}
+
+/**
+   Prints the summary line of a finished job: 
+   The file, the result, the number of steps, the cpu time and the wall clock time in seconds, separated by tabs.
+   The result is one of proof, model, max-steps, timeout, dry-run, error and crash. 
+   Returns true if a proof was found, or the file was parsed with -D|--dry-run.
+**/
+bool finish_batch_job(batch_job* job, int status, const struct rusage* usage){
+  char line[64];
+  char result[32] = "error";
+  unsigned int steps = 0;
+  ssize_t n_read;
+  struct timeval end;
+  double cpu, wall;
+  gettimeofday(&end, NULL);
+  n_read = read(job->result_fd, line, sizeof(line) - 1);
+  close(job->result_fd);
+  if(n_read > 0){
+    line[n_read] = '\0';
+    if(sscanf(line, "%31s %u", result, &steps) != 2)
+      strcpy(result, "error");
+  } else if(WIFSIGNALED(status))
+    strcpy(result, (WTERMSIG(status) == SIGXCPU || WTERMSIG(status) == SIGALRM) ? "timeout" : "crash");
+  cpu = usage->ru_utime.tv_sec + usage->ru_stime.tv_sec + (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e6;
+  wall = (end.tv_sec - job->start.tv_sec) + (end.tv_usec - job->start.tv_usec) / 1e6;
+  printf("%s\t%s\t%u\t%.2f\t%.2f\n", job->path, result, steps, cpu, wall);
+  fflush(stdout);
+  return strcmp(result, "proof") == 0 || strcmp(result, "dry-run") == 0;
+}
+
+/**
+   Sets the name of the log file of each job to the name of its file with the suffix .log. 
+   If several files have the same name, in different directories, the number of the file 
+   in the batch, starting from 1, is put before the suffix, such that the logs are not overwritten.
+**/
+void set_batch_log_names(batch_job* jobs, unsigned int n_jobs){
+  unsigned int i, j;
+  for(i = 0; i < n_jobs; i++){
+    const char* name = basename(jobs[i].path);
+    bool shared_name = false;
+    for(j = 0; j < n_jobs && !shared_name; j++)
+      shared_name = j != i && strcmp(name, basename(jobs[j].path)) == 0;
+    jobs[i].logname = malloc_tester(strlen(name) + 20);
+    if(shared_name)
+      sprintf(jobs[i].logname, "%s.%u.log", name, i + 1);
+    else
+      sprintf(jobs[i].logname, "%s.log", name);
+  }
+}
+
+/**
+   Proves the files in parallel, each in its own process, with at most batch_size processes at a time.
+   Since each file has its own process, the files share no global state or memory, 
+   and the time limits from -t and -w are for each file.
+   One summary line is printed for each file when it is finished, see finish_batch_job.
+   Returns EXIT_SUCCESS if all files were proved.
+**/
+int run_batch(char* paths[], unsigned int n_paths){
+  unsigned int i, n_started = 0, n_running = 0;
+  int retval = EXIT_SUCCESS;
+  batch_job* jobs = calloc_tester(n_paths, sizeof(batch_job));
+  if(batch_size == 0){
+    long n_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    batch_size = n_procs > 0 ? n_procs : 1;
+  }
+  for(i = 0; i < n_paths; i++)
+    jobs[i].path = paths[i];
+  set_batch_log_names(jobs, n_paths);
+  printf("# file\tresult\tsteps\tcpu\twall\n");
+  while(n_started < n_paths || n_running > 0){
+    if(n_started < n_paths && n_running < batch_size){
+      start_batch_job(& jobs[n_started]);
+      n_started++;
+      n_running++;
+    } else {
+      int status;
+      struct rusage usage;
+      pid_t pid = wait4(-1, &status, 0, &usage);
+      if(pid < 0){
+	if(errno == EINTR)
+	  continue;
+	perror("main.c: run_batch: wait4");
+	exit(EXIT_FAILURE);
+      }
+      for(i = 0; i < n_started; i++){
+	if(jobs[i].pid == pid){
+	  if(!finish_batch_job(& jobs[i], status, &usage))
+	    retval = EXIT_FAILURE;
+	  n_running--;
+	  break;
+	}
+      }
+    }
+  }
+  for(i = 0; i < n_paths; i++)
+    free(jobs[i].logname);
+  free(jobs);
+  return retval;
+}
+
 void print_help(char* exec){
   printf("Usage: %s [OPTION...] [FILE...]\n\n", exec);
   printf("Reads a coherent theory given in the format supported by John Fisher's geolog prover <http://johnrfisher.net/GeologUI/index.html> or in the format supported by Marc Bezem and Dimitri Hendriks CL.pl <http://www.few.vu.nl/~diem/research/ht/#tool>. The strategy information in the latter format is not used, only the axioms. ");
@@ -315,13 +600,13 @@ void print_help(char* exec){
   printf("If no file name is given, a single theory is read from standard input. ");
   printf("Several file names can be given, each will then be parsed as a single theory and a proof search done for each of them.\n\n");
   printf(" Explanation of options:\n");
-  printf("\t-p, --proof\t\tOutput a proof if one is found\n");
+  printf("\t-p, --proof\t\tOutput a proof if one is found. Not available if clp was configured with --disable-timestamps.\n");
   printf("\t-g, --debug \t\tGives (lots of) extra output useful for debugging or understanding the prover\n");
   printf("\t-x, --text\t\tGives output of proof in separate text file. Same prefix of name as input file, but with .out as suffix. \n");
   printf("\t-v, --verbose\t\tGives extra output about the proving process\n");
   printf("\t-V, --version\t\tSome info about the program, including copyright and license\n");
   printf("\t-e, --eager\t\tUses the eager version of RETE. This is probably always slower.\n");
-  printf("\t-q, --coq\t\tOutputs coq format proof to a file in the current working directory.\n");
+  printf("\t-q, --coq\t\tOutputs coq format proof to a file in the current working directory. Not available if clp was configured with --disable-timestamps.\n");
   printf("\t-d, --depth-first\t\tUses a depth-first strategy, similar to in CL.pl. \n");
   printf("\t-f, --factset_lhs\t\tUses standard fact-set method to determine whether the lhs of an instance is satisified. The default is to use rete. Implies -n|--not. Work in progress.\n");
   printf("\t-P, --print=TPTP|Geolog|CL.pl\t\tOnly outputs the theory in the chosen format.\n");
@@ -331,12 +616,16 @@ void print_help(char* exec){
   printf("\t-C, --CL.pl\t\tParses the input file as in CL.pl. This is the default.\n");
   printf("\t-G, --geolog\t\tParses the input file as in Fisher's geolog.See http://johnrfisher.net/GeologUI/index.html#geolog for a description\n");
   printf("\t-T, --TPTP\t\tParses the input as TPTP simple, and translates to CL. See http://www.cs.miami.edu/~tptp/. Not finished. \n");
-  printf("\t-M, --multithreaded\t\tUses a multithreaded algorithm. Should probably be used with -a|--all-disjuncts.\n");
-  printf("\t-t, --cpu_timer=LIMIT\t\tSets a limit to total number of seconds of CPU time spent.\n");
+  printf("\t-M, --multithreaded\t\tRuns the branches of disjunctions in parallel, each on its own copy of the state. All branches are then treated, as with -a|--all-disjuncts. Half of the threads given by -W|--workers then run branches, the other half the rete network.\n");
+  printf("\t-t, --cpu_timer=LIMIT\t\tSets a limit to the number of seconds of CPU time spent on each theory. When the limit is reached, the prover reports the number of steps done and continues with the next theory.\n");
+  printf("\t-B, --batch=N\t\tProves the files given on the commandline in parallel, each in its own process, with at most N at a time. 0 is the number of processors. The output for each file is written to a file with the same name as the input file and suffix .log in the current directory. If several input files have the same name, the number of the file on the commandline is put before the suffix. One line is printed for each file when it is finished, with the file name, the result (proof, model, max-steps, timeout, dry-run, error or crash), the number of steps, and the cpu and wall clock time in seconds, separated by tabs.\n");
   printf("\t-S, --single-threaded-rete\t\tPrevents the multithreaded rete implementation to run. Probably only interesting for testing.\n");
-  printf("\t-w, --wallclocktimer=LIMIT\t\tSets a limit to total number of seconds that may elapse before prover exits.\n");
+  printf("\t-W, --workers=N, --threads=N\t\tNumber of threads running the multithreaded rete network, shared with the branches with -M|--multithreaded. The default is the number of processors. --threads is another name for --workers.\n");
+  printf("\t-w, --wallclocktimer=LIMIT\t\tSets a limit to the number of seconds that may elapse while proving each theory. When the limit is reached, the prover reports the number of steps done and continues with the next theory.\n");
   printf("\t-a, --all-disjuncts\t\tAlways treats all disjuncts of all treated disjuncts.\n");
+  printf("\t-j, --join-order\t\tReorders the conjuncts in the left hand sides of the rules when constructing the rete network, such that the most selective conjuncts are joined first. Ignored with -q|--coq and -p|--proof.\n");
   printf("\t-n, --no-beta-not\t\tPrevents construction of beta-not rete nodes for the rhs of rules. \n");
+  printf("\t-A, --allocation-statistics\t\tPrints the memory used for the ground atoms, fresh constants and names of proof branches after each theory, with the number of allocations for each line in the source code.\n");
   printf("\t-s, --substitution_store\t\tTries to avoid all single mallocs for each substitution. (Enables substitution_memory.c) \n");
   printf("\nReport bugs to <hovlanddag@gmail.com>\n");
 }
@@ -380,10 +669,15 @@ int main(int argc, char *argv[]){
     {"substitution_store", no_argument, NULL, 's'}, 
     {"all-disjuncts", no_argument, NULL, 'a'}, 
     {"single-threaded-rete", no_argument, NULL, 'S'},
+    {"workers", required_argument, NULL, 'W'},
+    {"threads", required_argument, NULL, 'W'},
     {"full-tptp", no_argument, NULL, 'F'},
+    {"join-order", no_argument, NULL, 'j'},
+    {"allocation-statistics", no_argument, NULL, 'A'},
+    {"batch", required_argument, NULL, 'B'},
     {0,0,0,0}
   };
-  char shortargs[] = "w:vfVphgdoat:cCSsDP:aTGeqMnm:F";
+  char shortargs[] = "w:vfVphgdoat:cCSsDP:aTGeqMnm:FW:jAB:";
   int longindex;
   char argval;
   verbose = false;
@@ -398,19 +692,29 @@ int main(int argc, char *argv[]){
   use_beta_not = true;
   multithreaded = false;
   multithread_rete = true;
+  plan_joins = false;
+  allocation_statistics = false;
+  batch_mode = false;
+  batch_size = 0;
+  cpu_timer_limit = 0;
+  wallclock_timer_limit = 0;
   factset_lhs = false;
   all_disjuncts = false;
   use_substitution_store = false;
   strat = normal_strategy;
   maxsteps = MAX_PROOF_STEPS;
+  n_rete_threads = 0;
   dry_run = false;
   while( ( argval = getopt_long(argc, argv, shortargs, &longargs[0], &longindex )) != -1){
     switch(argval){
-      unsigned long int maxtimer;
     case 'v':
       verbose = true;
       break;
     case 'p':
+#ifdef NO_TIMESTAMPS
+      fprintf(stderr, "clp was configured with --disable-timestamps, and cannot output proofs.\n");
+      exit(EXIT_FAILURE);
+#endif
       proof = true;
       break;
     case 'D':
@@ -423,6 +727,10 @@ int main(int argc, char *argv[]){
       strat = clpl_strategy;
       break;
     case 'q':
+#ifdef NO_TIMESTAMPS
+      fprintf(stderr, "clp was configured with --disable-timestamps, and cannot output proofs.\n");
+      exit(EXIT_FAILURE);
+#endif
       coq = true;
       break;
     case 'T':
@@ -432,8 +740,7 @@ int main(int argc, char *argv[]){
       input_format = full_tptp_format;
       break;
     case 't':
-      maxtimer = get_ui_arg_opt();
-      start_cpu_timer(maxtimer);
+      cpu_timer_limit = get_ui_arg_opt();
       break;
     case 'a':
       all_disjuncts = true;
@@ -441,17 +748,29 @@ int main(int argc, char *argv[]){
     case 'S':
       multithread_rete = false;
       break;
+    case 'W':
+      n_rete_threads = get_ui_arg_opt();
+      break;
     case 'P':
       output_theory = true;
       output_format = get_format_arg_opt();
       break;
     case 'w':
-      maxtimer = get_ui_arg_opt();
-      start_wallclock_timer(maxtimer);
+      wallclock_timer_limit = get_ui_arg_opt();
       break;
     case 'f':
       factset_lhs = true;
       break;
+    case 'j':
+      plan_joins = true;
+      break;
+    case 'A':
+      allocation_statistics = true;
+      break;
+    case 'B':
+      batch_mode = true;
+      batch_size = get_ui_arg_opt();
+      break;
     case 'n':
       use_beta_not = false;
       break;
@@ -491,37 +810,41 @@ int main(int argc, char *argv[]){
       exit(EXIT_FAILURE);
     }
   } 
+#ifdef NO_TIMESTAMPS
+  if(!all_disjuncts){
+    // Without timestamps it is not known whether a disjunctive step was used in the proof of a branch
+    fprintf(stderr, "%s: clp was configured with --disable-timestamps, all disjuncts are treated as with -a|--all-disjuncts.\n", argv[0]);
+    all_disjuncts = true;
+  }
+#endif
+  if(plan_joins && (coq || proof)){
+    // The proof writers expect the premisses of the rule instances in the order of the input
+    fprintf(stderr, "%s: -j|--join-order is ignored with -q|--coq and -p|--proof.\n", argv[0]);
+    plan_joins = false;
+  }
+  if(batch_mode){
+    if(optind == argc){
+      fprintf(stderr, "%s: -B|--batch needs the theory files on the commandline\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    return run_batch(& argv[optind], argc - optind);
+  }
+  run_arena = init_arena(ARENA_BLOCK_SIZE);
   if(optind < argc){
     retval = EXIT_SUCCESS;
     while( optind < argc ) {
-      FILE* f;
-      if(input_format == clpl_format || input_format == geolog_format || input_format == coherent_tptp_format){
-	f = fopen(argv[optind], "r");
-	if(f == NULL){
-	  perror("main: Could not open theory file");
-	  fprintf(stderr, "Filename: '%s'\n", argv[optind]); 
-	  exit(EXIT_FAILURE);
-	}
-	if(file_prover(f, basename(argv[optind]), NULL) == EXIT_FAILURE)
-	  retval = EXIT_FAILURE;
-	if(fclose(f) != 0){
-	  perror("main(): Could not close theory file\n");
-	  fprintf(stderr, "File name: %s\n", argv[optind]); 
-	  exit(EXIT_FAILURE);
-	}
-      } else {
-	assert(input_format == full_tptp_format);
-	if(file_prover(NULL, basename(argv[optind]), argv[optind]) == EXIT_FAILURE)
-	  retval = EXIT_FAILURE;
-      }
+      unsigned int steps;
+      if(prove_file(argv[optind], &steps) == EXIT_FAILURE)
+	retval = EXIT_FAILURE;
       optind++;
     } // end for
   } else {
+    unsigned int steps;
     assert(optind == argc);
     printf("Reading theory from standard input\n");
-    retval =  file_prover(stdin, "STDIN", "STDIN");
+    retval =  file_prover(stdin, "STDIN", "STDIN", &steps);
   }
-  
+  destroy_arena(run_arena);
   return retval;
 }
 
@@ -1,7 +1,8 @@
 /**
    Only used by the parser to create the original list of predicates
 
-   Identity of predicates is based on the string name and arity
+   Identity of predicates is based on the string name and arity. 
+   The predicates are found by their names in the symbol table of the theory, see symbol_table.h
 **/
 
 #include "common.h"
@@ -19,20 +20,33 @@ clp_predicate* _create_predicate(const char* name, size_t arity, bool is_equalit
   return p;
 }
 
+/**
+   The symbol has the number of the first predicate with the name. 
+   Only when the same name is used with another arity, the list of predicates is searched.
+**/
 const clp_predicate* parser_new_predicate(theory* th, const char* new, size_t arity){
   unsigned int i;
   clp_predicate * p;
+  symbol* s = intern_symbol(th->symbols, new, strlen(new));
+  if(s->is_predicate){
+    p = th->predicates[s->pred_no];
+    if(p->arity == arity)
+      return p;
+    for(i = s->pred_no + 1; i < th->n_predicates; i++){
+      p = th->predicates[i];
+      if(p->name == s->name && arity == p->arity)
+	return p;
+    }
+  }
   if(strcmp(new, DOMAIN_SET_NAME) == 0){
     fprintf(stderr, "The predicate name \"%s\" cannot be used, as it is reserved for the domain of the prover.\n", DOMAIN_SET_NAME);
     exit(EXIT_FAILURE);
   }
-    
-  for(i = 0; i < th->n_predicates; i++){
-    p = th->predicates[i];
-    if(strcmp(p->name, new) == 0 && arity == p->arity)
-      return p;
+  if(!s->is_predicate){
+    s->is_predicate = true;
+    s->pred_no = th->n_predicates;
   }
-  p = _create_predicate(new, arity, (strcmp(new, "=") == 0 && arity == 2), th->n_predicates);
+  p = _create_predicate(s->name, arity, (strcmp(new, "=") == 0 && arity == 2), th->n_predicates);
   if(th->n_predicates+1 >= th->size_predicates){
     th->size_predicates *= 2;
     th->predicates = realloc_tester(th->predicates, sizeof(clp_predicate) * th->size_predicates);
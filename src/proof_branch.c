@@ -23,6 +23,19 @@
 #include "proof_branch.h"
 #include <stdio.h>
 
+/**
+   Source of the ids of the branches. See create_child_branch
+**/
+static unsigned int proof_branch_id_counter = 0;
+
+unsigned int next_proof_branch_id(){
+#ifdef __GNUC__
+  return __sync_add_and_fetch(&proof_branch_id_counter, 1);
+#else
+  return ++proof_branch_id_counter;
+#endif
+}
+
 /**
    Only called from create_rete_state_single
 **/
@@ -74,15 +87,17 @@ void end_proof_branch(proof_branch* br, timestamp step, unsigned int n_children)
    Called during treatment of disjunctions
 
    Assumes that end_proof_branch has been called first, 
-   with the right number of children
+   with the right number of children. 
+   The name is allocated in the arena of the rete state, since it is used until the proof is written.
 **/
-proof_branch* create_child_branch(proof_branch* br, const theory* th){
+proof_branch* create_child_branch(proof_branch* br, const theory* th, arena* a){
   proof_branch* child = malloc_tester(sizeof(proof_branch));
   assert(br->n_children < br->size_children);
   br->children[br->n_children] = child;
+  child->id = next_proof_branch_id();
   child->start_step = br->end_step;
   child->n_children = 0;
-  child->name = malloc_tester(strlen(br->name) + 20);
+  child->name = arena_alloc(a, strlen(br->name) + 20);
   sprintf(child->name, "%s_%i", br->name, br->n_children);
   child->elim_stack = initialize_ri_stack();
   child->parent = br;
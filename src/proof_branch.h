@@ -29,6 +29,9 @@
    Used by rete_state_single, (In rete_state the state has this information)
 
    The component array children has size 0 or rule->rhs->n_args, since this is known at the point when the children are added at all
+
+   id is unique for each branch created during the run, also after branches are deleted by prune_proof. 
+   The root has id 0. Used to find the split rete state running a branch, see rete_state_single_struct.h
 **/
 typedef struct proof_branch_t {
   unsigned int id;
@@ -45,6 +48,6 @@ typedef struct proof_branch_t {
 proof_branch* create_root_proof_branch(void);
 void delete_proof_branch_tree(proof_branch*);
 void end_proof_branch(proof_branch*, timestamp, unsigned int);
-proof_branch* create_child_branch(proof_branch*, const theory*);
+proof_branch* create_child_branch(proof_branch*, const theory*, arena*);
 void prune_proof(proof_branch* parent, unsigned int);
 #endif
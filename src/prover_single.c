@@ -20,7 +20,8 @@
 /*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
 
 /**
-   An attempt at a simpler prover with no or-parallellism
+   An attempt at a simpler prover. The or-parallellism is limited to running 
+   the branches of a disjunction on copies of the state, with -M|--multithreaded
 **/
 
 #include "common.h"
@@ -37,12 +38,179 @@
 #include "rete_state_single.h"
 #include "instantiate.h"
 #include "rule_instance.h"
+#include "error_handling.h"
 #include <errno.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 extern bool debug, verbose;
 
-bool foundproof, reached_max;
+bool foundproof;
+
+/**
+   timed_out is set by expire_prover_deadline when the time limit given by -t or -w is reached, 
+   and is reset by start_prover_deadline before each theory.
+   running_state is the root state of the proof running, or NULL, and is cancelled when the time limit is reached.
+   deadline_generation is increased by start_prover_deadline for each theory. 
+   A timer of an earlier theory may still expire after it is deleted, and is then ignored.
+   outcome is set by the first branch finding a model or reaching the maximal number of steps, 
+   and otherwise by prover_single when the proof ends, see get_prover_outcome. 
+   All are protected by prover_result_mutex
+**/
+bool timed_out;
+rete_state_single* running_state;
+unsigned int deadline_generation;
+prover_outcome outcome;
+
+/**
+   parallel_branches is true with -M|--multithreaded. The branches of disjunctions are then 
+   run in parallel on copies of the rete state, see start_parallel_disjunction_single. 
+   n_free_branch_threads is the number of threads of branch_threads not claimed for running branches. 
+
+   The n threads given by -W|--workers are then shared between the rete pool, 
+   which gets n - n/2 threads, and branch_threads, which gets n/2 threads. 
+   The thread of the prover also runs branches, so there are n + 1 threads in all, 
+   as without -M, when the rete pool gets all n threads. See prover_single
+**/
+bool parallel_branches;
+unsigned int n_free_branch_threads;
 
+#ifdef HAVE_PTHREAD
+/**
+   Makes sure only the first branch finding a model or reaching the maximal number of steps prints this
+**/
+pthread_mutex_t prover_result_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+   Called from main.c before the timers of a theory are started. 
+   Also forgets the outcome of the previous theory. Returns the generation the timers must give to expire_prover_deadline
+**/
+unsigned int start_prover_deadline(void){
+  unsigned int generation;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  timed_out = false;
+  outcome = no_prover_outcome;
+  generation = ++deadline_generation;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+  return generation;
+}
+
+/**
+   Called from the timers in main.c when the time limit is reached. 
+   The proof running is cancelled, and prover_single returns at the next step, 
+   see run_prover_single. If no proof is running yet, the next proof is cancelled when it starts.
+   Returns false, and does nothing, if the timer belongs to an earlier theory.
+**/
+bool expire_prover_deadline(unsigned int generation){
+  bool expired;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  expired = generation == deadline_generation;
+  if(expired){
+    timed_out = true;
+    if(running_state != NULL)
+      cancel_rete_state(running_state);
+  }
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+  return expired;
+}
+
+/**
+   Returns how the last proof ended. Called from main.c after prover_single. 
+   A timer expiring after the proof ended does not change this, even if timed_out is set.
+**/
+prover_outcome get_prover_outcome(void){
+  prover_outcome result;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  result = outcome;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+  return result;
+}
+
+/**
+   Sets the outcome of the proof, if no branch has set it already
+**/
+void set_prover_outcome(prover_outcome new_outcome){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  if(outcome == no_prover_outcome)
+    outcome = new_outcome;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+}
+
+/**
+   Sets the state of the proof running, see expire_prover_deadline
+**/
+void set_running_state(rete_state_single* state){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  running_state = state;
+  if(state != NULL && timed_out)
+    cancel_rete_state(state);
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+
+/**
+   The information shared by the threads running the branches of a disjunction in parallel. 
+   next_branch is the next branch not yet taken by any thread. 
+   total_steps[i] is the number of the last step in branch i.
+   n_helpers is the number of threads of branch_threads given the disjunction that have not 
+   finished it, and is protected by the lock of branch_threads.
+**/
+typedef struct parallel_disjunction_t {
+  rete_state_single* state;
+  const clp_axiom* rule;
+  timestamp step;
+  proof_branch* parent_branch;
+  proof_branch** branches;
+  unsigned int* total_steps;
+  unsigned int next_branch;
+  unsigned int n_helpers;
+  bool proved;
+} parallel_disjunction;
+
+/**
+   The threads running the branches of parallel disjunctions. They are started once for each proof 
+   by start_branch_threads, instead of once for each disjunction. 
+   start_parallel_disjunction_single pushes the disjunction on tasks once for each thread it 
+   has claimed, and each idle thread takes a task and runs run_parallel_disjunction_single. 
+   There are never more tasks than threads, since the threads are claimed first. 
+   finished is signalled each time a thread has finished a task.
+**/
+typedef struct branch_thread_pool_t {
+  pthread_mutex_t lock;
+  pthread_cond_t has_task;
+  pthread_cond_t finished;
+  pthread_t * threads;
+  unsigned int n_threads;
+  parallel_disjunction ** tasks;
+  unsigned int n_tasks;
+  bool stop_signalled;
+} branch_thread_pool;
+
+branch_thread_pool branch_threads;
+#endif
 
 
 
@@ -73,7 +241,11 @@ bool start_rete_disjunction_coq_single(rete_state_single* state, rule_instance*
 
 
 
-
+/**
+   Inserts the instances of the atoms in con into the factsets and the rete network.
+   The facts are given to the rete workers together at the end, 
+   or before an equality, since the workers are then paused
+**/
 void insert_rete_net_conjunction_single(rete_state_single* state, 
 					clp_conjunction* con, 
 					substitution* sub){
@@ -83,7 +255,7 @@ void insert_rete_net_conjunction_single(rete_state_single* state,
   assert(test_is_conj_instantiation(con, sub, state->constants));
   for(i = 0; i < con->n_args; i++){
     bool fact_is_new = true;
-    clp_atom* ground = instantiate_atom(con->args[i], sub, state->constants);
+    const clp_atom* ground = instantiate_ground_atom(state->ground_atoms, state->arena, con->args[i], sub, state->constants);
     assert(test_ground_atom(ground, state->constants));
 #ifdef __DEBUG_RETE_STATE
     printf("New fact: ");
@@ -91,6 +263,7 @@ void insert_rete_net_conjunction_single(rete_state_single* state,
     printf("\n");
 #endif
     if(ground->pred->is_equality){
+      flush_state_rete_net_facts(state);
       pause_rete_state_workers(state);
       union_constants(ground->args->args[0]->val.constant
 		      , ground->args->args[1]->val.constant
@@ -101,25 +274,35 @@ void insert_rete_net_conjunction_single(rete_state_single* state,
 #ifdef __DEBUG_RETE_STATE
       printf("New equality: Rechecking relevant parts of rete net.\n");
 #endif
-      recheck_rete_state_net(state);
+      recheck_rete_state_net(state, ground->args->args[0]->val.constant, ground->args->args[1]->val.constant);
     }
     else
       fact_is_new = insert_state_factset_single(state, ground);
     if(fact_is_new && (!state->net->factset_lhs || state->net->use_beta_not))
-      insert_state_rete_net_fact(state, ground);
-    if(!fact_is_new)
-      delete_instantiated_atom(ground);
+      add_state_rete_net_fact(state, ground);
   } // end for
+  flush_state_rete_net_facts(state);
 }
 
 /**
    Called from run_prover_rete_coq when not finding new instance
+   The other branches are cancelled, since the model shows the theory cannot be proved
 **/
 bool return_found_model_mt(rete_state_single* state){
-  fprintf(stdout, "Found a model of the theory \n");
-  print_all_constants(state->constants, stdout);
-  print_state_fact_store(state, stdout);
-  foundproof = false;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  if(foundproof){
+    fprintf(stdout, "Found a model of the theory \n");
+    print_all_constants(state->constants, stdout);
+    print_state_fact_store(state, stdout);
+    foundproof = false;
+    outcome = model_outcome;
+    cancel_rete_state(state);
+  }
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
   return false;
 }
 
@@ -128,9 +311,18 @@ bool return_found_model_mt(rete_state_single* state){
    commandline option -m|--max=LIMIT
 **/
 bool return_reached_max_steps_mt(rete_state_single* state, const rule_instance* ri){
-  printf("Reached %i proof steps, higher than given maximum\n", get_state_step_no_single(state));
-  foundproof = false;
-  reached_max = true;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& prover_result_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  if(foundproof){
+    printf("Reached %i proof steps, higher than given maximum\n", get_state_total_steps(state));
+    foundproof = false;
+    outcome = max_steps_outcome;
+    cancel_rete_state(state);
+  }
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& prover_result_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
   return false;
 }
 
@@ -140,6 +332,10 @@ bool return_reached_max_steps_mt(rete_state_single* state, const rule_instance*
    Should be thread-safe. 
    Note that the rule instance on the stack is discarded, as the 
    conjunction is already inserted by insert_rete_net_disjunction_coq_single below
+
+   Returns false without doing anything more when the search is cancelled, because a branch 
+   run in parallel has found a model or the time limit is reached, see cancel_rete_state. 
+   The instance chosen may then be NULL because the workers have stopped, and this does not mean there is a model.
 **/
 
 bool run_prover_single(rete_state_single* state){
@@ -147,9 +343,13 @@ bool run_prover_single(rete_state_single* state){
       timestamp ts;
       rule_instance* next;
       bool incval;
+      if(is_rete_state_cancelled(state))
+	return false;
       assert(test_rete_state(state));
       next = choose_next_instance_single(state);
       assert(test_rete_state(state));
+      if(is_rete_state_cancelled(state))
+	return false;
       if(next == NULL)
 	return return_found_model_mt(state);
       fresh_exist_constants(next->rule, & next->sub, state->constants);
@@ -178,6 +378,164 @@ bool run_prover_single(rete_state_single* state){
     } // end while(true)
  }
 
+#ifdef HAVE_PTHREAD
+/**
+   Claims at most n of the free threads for running branches. 
+   Returns the number of threads claimed
+**/
+unsigned int claim_branch_threads(unsigned int n){
+  unsigned int n_free, n_claimed;
+  do {
+    n_free = n_free_branch_threads;
+    n_claimed = (n < n_free) ? n : n_free;
+    if(n_claimed == 0)
+      return 0;
+  } while(!__sync_bool_compare_and_swap(& n_free_branch_threads, n_free, n_free - n_claimed));
+  return n_claimed;
+}
+
+void release_branch_threads(unsigned int n){
+  __sync_add_and_fetch(& n_free_branch_threads, n);
+}
+
+/**
+   Run by the threads started in start_parallel_disjunction_single, and by the thread starting them. 
+   Takes the next branch not yet taken and runs it on a copy of the state, 
+   until all branches are taken or the search is cancelled.
+**/
+void * run_parallel_disjunction_single(void* arg){
+  parallel_disjunction* disj = arg;
+  unsigned int n_branches = disj->rule->rhs->n_args;
+  unsigned int i;
+  while(!is_rete_state_cancelled(disj->state) && (i = __sync_fetch_and_add(& disj->next_branch, 1)) < n_branches){
+    bool rv;
+    const substitution * sub;
+    substitution *tmp_sub;
+    rete_state_single* branch_state = split_rete_state_single(disj->state, disj->branches[i]);
+    sub = & (get_historic_rule_instance(branch_state, disj->step.step))->sub;
+    tmp_sub = copy_substitution(sub, & branch_state->tmp_subs, branch_state->net->th->sub_size_info, branch_state->timestamp_store, branch_state->constants);
+    assert(test_substitution(tmp_sub, branch_state->constants));
+    insert_rete_net_conjunction_single(branch_state, disj->rule->rhs->args[i], tmp_sub);
+    free_substitution(tmp_sub);
+    write_proof_edge(disj->parent_branch->name, disj->step.step, branch_state->current_proof_branch->name, branch_state->cur_step);
+    rv = run_prover_single(branch_state);
+    if(!rv)
+      __atomic_store_n(& disj->proved, false, __ATOMIC_RELEASE);
+    disj->total_steps[i] = branch_state->total_steps;
+    finish_split_rete_state_single(branch_state, rv && branch_state->net->coq);
+  }
+  return NULL;
+}
+
+/**
+   Run by the threads of branch_threads, see start_branch_threads
+**/
+void * run_branch_thread(void* arg){
+  parallel_disjunction* disj;
+  pt_err(pthread_mutex_lock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: run_branch_thread: mutex lock");
+  while(true){
+    while(branch_threads.n_tasks == 0 && !branch_threads.stop_signalled)
+      pt_err(pthread_cond_wait(& branch_threads.has_task, & branch_threads.lock), __FILE__, __LINE__, "prover_single.c: run_branch_thread: cond wait");
+    if(branch_threads.n_tasks == 0)
+      break;
+    disj = branch_threads.tasks[--branch_threads.n_tasks];
+    pt_err(pthread_mutex_unlock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: run_branch_thread: mutex unlock");
+    run_parallel_disjunction_single(disj);
+    pt_err(pthread_mutex_lock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: run_branch_thread: mutex lock");
+    disj->n_helpers--;
+    pt_err(pthread_cond_broadcast(& branch_threads.finished), __FILE__, __LINE__, "prover_single.c: run_branch_thread: cond broadcast");
+  }
+  pt_err(pthread_mutex_unlock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: run_branch_thread: mutex unlock");
+  return NULL;
+}
+
+/**
+   Starts at most n threads for running branches. Called from prover_single with -M|--multithreaded. 
+   Returns the number of threads started, which is less than n if a thread cannot be started.
+**/
+unsigned int start_branch_threads(unsigned int n){
+  pt_err(pthread_mutex_init(& branch_threads.lock, NULL), __FILE__, __LINE__, "prover_single.c: start_branch_threads: mutex init");
+  pt_err(pthread_cond_init(& branch_threads.has_task, NULL), __FILE__, __LINE__, "prover_single.c: start_branch_threads: cond init");
+  pt_err(pthread_cond_init(& branch_threads.finished, NULL), __FILE__, __LINE__, "prover_single.c: start_branch_threads: cond init");
+  branch_threads.threads = calloc_tester(n + 1, sizeof(pthread_t));
+  branch_threads.tasks = calloc_tester(n + 1, sizeof(parallel_disjunction*));
+  branch_threads.n_tasks = 0;
+  branch_threads.stop_signalled = false;
+  for(branch_threads.n_threads = 0; branch_threads.n_threads < n; branch_threads.n_threads++){
+    if(pthread_create(& branch_threads.threads[branch_threads.n_threads], NULL, run_branch_thread, NULL) != 0)
+      break;
+  }
+  return branch_threads.n_threads;
+}
+
+/**
+   Called at the end of prover_single, when no branches are running
+**/
+void stop_branch_threads(void){
+  unsigned int i;
+  pt_err(pthread_mutex_lock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: mutex lock");
+  branch_threads.stop_signalled = true;
+  pt_err(pthread_cond_broadcast(& branch_threads.has_task), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: cond broadcast");
+  pt_err(pthread_mutex_unlock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: mutex unlock");
+  for(i = 0; i < branch_threads.n_threads; i++)
+    pt_err(pthread_join(branch_threads.threads[i], NULL), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: join thread");
+  pt_err(pthread_cond_destroy(& branch_threads.has_task), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: cond destroy");
+  pt_err(pthread_cond_destroy(& branch_threads.finished), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: cond destroy");
+  pt_err(pthread_mutex_destroy(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: stop_branch_threads: mutex destroy");
+  free(branch_threads.threads);
+  free(branch_threads.tasks);
+}
+
+/**
+   Called from start_rete_disjunction_coq_single with -M|--multithreaded, 
+   when n_threads threads of branch_threads are claimed for the branches. 
+   
+   The state is not changed while the branches run, each branch is run 
+   on its own copy, made by split_rete_state_single. 
+   All branches are run, also with treat_all_disjuncts false, 
+   since the other branches may be finished before it is known whether the disjunction was used. 
+   Returns when all the claimed threads have finished with the disjunction.
+**/
+bool start_parallel_disjunction_single(rete_state_single* state, rule_instance* next, timestamp step, unsigned int n_threads){
+  unsigned int i, total_steps = 0;
+  const clp_axiom* rule = next->rule;
+  unsigned int n_branches = rule->rhs->n_args;
+  parallel_disjunction disj;
+  disj.state = state;
+  disj.rule = rule;
+  disj.step = step;
+  disj.parent_branch = state->current_proof_branch;
+  disj.branches = calloc_tester(n_branches, sizeof(proof_branch*));
+  disj.total_steps = calloc_tester(n_branches, sizeof(unsigned int));
+  disj.next_branch = 0;
+  disj.n_helpers = n_threads;
+  disj.proved = true;
+  for(i = 0; i < n_branches; i++)
+    disj.branches[i] = create_child_branch(disj.parent_branch, state->net->th, state->arena);
+  begin_rete_state_split(state);
+  pt_err(pthread_mutex_lock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: mutex lock");
+  for(i = 0; i < n_threads; i++)
+    branch_threads.tasks[branch_threads.n_tasks++] = & disj;
+  assert(branch_threads.n_tasks <= branch_threads.n_threads);
+  pt_err(pthread_cond_broadcast(& branch_threads.has_task), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: cond broadcast");
+  pt_err(pthread_mutex_unlock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: mutex unlock");
+  run_parallel_disjunction_single(& disj);
+  pt_err(pthread_mutex_lock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: mutex lock");
+  while(disj.n_helpers > 0)
+    pt_err(pthread_cond_wait(& branch_threads.finished, & branch_threads.lock), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: cond wait");
+  pt_err(pthread_mutex_unlock(& branch_threads.lock), __FILE__, __LINE__, "prover_single.c: start_parallel_disjunction_single: mutex unlock");
+  release_branch_threads(n_threads);
+  for(i = 0; i < n_branches; i++){
+    if(disj.total_steps[i] > total_steps)
+      total_steps = disj.total_steps[i];
+  }
+  end_rete_state_split(state, total_steps);
+  free(disj.branches);
+  free(disj.total_steps);
+  return disj.proved && foundproof;
+}
+#endif
+
 /**
    Called from the thread runner when a disjunction is popped which is treated for the second time.
 
@@ -192,8 +550,16 @@ bool start_rete_disjunction_coq_single(rete_state_single* state, rule_instance*
   unsigned int i;
   const clp_axiom* rule = next->rule;
   unsigned int n_branches = rule->rhs->n_args;
-  rete_state_backup backup = backup_rete_state(state);
+  rete_state_backup backup;
   proof_branch* parent_prf_branch = state->current_proof_branch;
+#ifdef HAVE_PTHREAD
+  if(parallel_branches){
+    unsigned int n_threads = claim_branch_threads(n_branches - 1);
+    if(n_threads > 0)
+      return start_parallel_disjunction_single(state, next, step, n_threads);
+  }
+#endif
+  backup = backup_rete_state(state);
   for(i = 0; i < n_branches; i++){
     bool rv;
     const substitution * sub;
@@ -262,7 +628,7 @@ void write_single_coq_proof(rete_state_single* state, proof_branch* branch){
       assert(branch != branch->children[i]);
       if(i > 0)
 	write_disj_proof_start(end_ri, step, i, state->constants);
-      write_single_coq_proof(state, branch->children[i]);
+      write_single_coq_proof(get_proof_branch_state_single(state, branch->children[i]), branch->children[i]);
     }
     if(is_fact(end_ri->rule)){
       fprintf(coq_fp, "(* disjunction at %i is a fact, no lhs to prove *)\n", step.step);
@@ -287,13 +653,25 @@ void write_single_coq_proof(rete_state_single* state, proof_branch* branch){
 /**
    The main prover function 
 **/
-unsigned int prover_single(const rete_net* rete, bool multithread){
-  rete_state_single * state = create_rete_state_single(rete, verbose);
+unsigned int prover_single(const rete_net* rete, bool multithread, arena* run_arena){
+  rete_state_single * state;
   bool has_fact = false;
   unsigned int i, retval;
+  unsigned int n_pool_threads = rete->n_rete_threads;
+  bool proved;
   clp_atom * true_atom;
   foundproof = true;
-  reached_max = false;
+  parallel_branches = multithread;
+  n_free_branch_threads = 0;
+#ifdef HAVE_PTHREAD
+  if(parallel_branches){
+    if(n_pool_threads == 0)
+      n_pool_threads = default_rete_worker_pool_size();
+    n_free_branch_threads = n_pool_threads / 2;
+    n_pool_threads -= n_free_branch_threads;
+  }
+#endif
+  state = create_rete_state_single(rete, verbose, n_pool_threads, run_arena);
   srand(1000);
   for(i = 0; i < rete->th->n_init_model; i++){
     assert(!rete->th->init_model[i]->is_existential);
@@ -311,6 +689,7 @@ unsigned int prover_single(const rete_net* rete, bool multithread){
     }
     if(!has_fact){
       printf("The theory has no facts, hence the empty model satisifies it.\n");
+      set_prover_outcome(model_outcome);
       return 0;
     }
   }
@@ -318,16 +697,34 @@ unsigned int prover_single(const rete_net* rete, bool multithread){
   insert_state_factset_single(state, true_atom);
   if(!state->net->factset_lhs || state->net->use_beta_not)
     insert_state_rete_net_fact(state, true_atom);
-  run_prover_single(state);
+#ifdef HAVE_PTHREAD
+  if(parallel_branches)
+    n_free_branch_threads = start_branch_threads(n_free_branch_threads);
+#endif
+  set_running_state(state);
+  proved = run_prover_single(state);
+#ifdef HAVE_PTHREAD
+  if(parallel_branches)
+    stop_branch_threads();
+#endif
   stop_rete_state_single(state);
-  if(foundproof && rete->coq && !reached_max){
+  set_running_state(NULL);
+  if(!proved && foundproof){
+    assert(timed_out);
+    printf("Reached the time limit after %i proof steps\n", get_state_total_steps(state));
+    foundproof = false;
+    set_prover_outcome(timeout_outcome);
+  }
+  if(foundproof)
+    set_prover_outcome(proof_outcome);
+  if(foundproof && rete->coq){
     write_single_coq_proof(state, state->root_branch);
     end_proof_coq_writer(rete->th);
   }
   retval = get_state_total_steps(state);
   delete_rete_state_single(state);
   
-  if(foundproof && !reached_max)
+  if(foundproof)
     return retval;
   else
     return 0;
@@ -98,7 +98,7 @@ const rete_node* get_const_selector(unsigned int pred_no, const rete_net* net){
    Note that is is safe to have selectors as an array of structures, since
    the array is never realloced
 **/
-rete_net* init_rete(const theory* th, unsigned long maxsteps, bool lazy, bool coq, bool multithread_rete){
+rete_net* init_rete(const theory* th, unsigned long maxsteps, bool lazy, bool coq, bool multithread_rete, unsigned int n_rete_threads){
   unsigned int i;
   rete_net* net = malloc_tester(sizeof(rete_net) + th->n_predicates * sizeof(rete_node));
   net->n_selectors = th->n_predicates;
@@ -107,6 +107,9 @@ rete_net* init_rete(const theory* th, unsigned long maxsteps, bool lazy, bool co
   net->lazy = lazy;
   net->coq = coq;
   net->multithread_rete = multithread_rete;
+  net->n_rete_threads = n_rete_threads;
+  net->plan_joins = false;
+  net->static_fact_counts = NULL;
 
   net->n_subs = 0;
   for(i = 0; i < net->n_selectors; i++)
@@ -162,6 +165,7 @@ rete_node* _create_beta_node(rete_net* net, rete_node* left_parent, rete_node* r
   add_rete_child(right_parent, node);
   assert(right_parent->n_children > 0);
 
+  node->val.beta.join_vars = NULL;
   node->val.beta.b_store_no = net->n_subs++;
   node->val.beta.a_store_used_no = net->n_subs++;
   node->val.beta.a_store_no = net->n_subs++;
@@ -170,10 +174,99 @@ rete_node* _create_beta_node(rete_net* net, rete_node* left_parent, rete_node* r
 }
 
 
+/**
+   The variables bound by the alpha nodes above node
+**/
+freevars* alpha_bound_vars(const rete_node* node, freevars* vars){
+  while(node != NULL && node->type == alpha){
+    vars = free_term_variables(node->val.alpha.value, vars);
+    node = node->left_parent;
+  }
+  return vars;
+}
+
+/**
+   The variables bound by the substitutions coming from the left parent of a beta node.
+   Equality nodes do not bind new variables, see fix_equality_vars in con_dis.c
+**/
+freevars* beta_bound_vars(const rete_node* node, freevars* vars){
+  while(node != NULL && node->type != beta_root){
+    if(node->type == beta_and)
+      vars = alpha_bound_vars(node->val.beta.right_parent, vars);
+    node = node->left_parent;
+  }
+  return vars;
+}
+
+/**
+   Returns true if an alpha node above node tests a constant or function term, 
+   or a variable occurring earlier in the same atom
+**/
+bool alpha_uses_equality(const rete_node* node){
+  bool retval = false;
+  freevars* vars = init_freevars();
+  while(!retval && node != NULL && node->type == alpha){
+    const clp_term* t = node->val.alpha.value;
+    if(t->type != variable_term || is_in_freevars(vars, t->val.var))
+      retval = true;
+    else
+      vars = add_freevars(vars, t->val.var);
+    node = node->left_parent;
+  }
+  del_freevars(vars);
+  return retval;
+}
+
+/**
+   Returns true if the matching in the part of the rete net above the 
+   rule node may depend on the equalities between constants. This is the case
+   if there are join variables, equality nodes or beta-not nodes, or if some alpha node 
+   tests a constant or a repeated variable. 
+
+   Used by rete_worker to know whether the worker must be paused and 
+   rechecked when a new equality is found
+**/
+bool rete_node_uses_equality(const rete_node* node){
+  assert(node->type == rule_node);
+  node = node->left_parent;
+  while(node->type != beta_root){
+    if(node->type != beta_and)
+      return true;
+    if(node->val.beta.join_vars != NULL && node->val.beta.join_vars->n_vars > 0)
+      return true;
+    if(node->val.beta.right_parent->type != alpha || alpha_uses_equality(node->val.beta.right_parent))
+      return true;
+    node = node->left_parent;
+  }
+  return false;
+}
+
+/**
+   The join variables are the variables bound both in the left and the right parent.
+   These are used for hash indexing the stores of beta_and nodes, 
+   and for scanning the right store of beta_not nodes
+**/
+freevars* beta_join_vars(const rete_node* left_parent, const rete_node* right_parent){
+  unsigned int i;
+  freevars* left = beta_bound_vars(left_parent, init_freevars());
+  freevars* right = (right_parent->type == alpha) ? alpha_bound_vars(right_parent, init_freevars()) : beta_bound_vars(right_parent, init_freevars());
+  freevars* join = init_freevars();
+  for(i = 0; i < right->n_vars; i++){
+    if(is_in_freevars(left, right->vars[i]))
+      join = add_freevars(join, right->vars[i]);
+  }
+  del_freevars(left);
+  del_freevars(right);
+  return join;
+}
+
 rete_node* create_beta_and_node(rete_net* net, rete_node* left_parent, rete_node* right_parent, const freevars* free_vars, bool in_positive_lhs_part, unsigned int rule_no){
+  rete_node* node;
   assert(left_parent->type == beta_and || left_parent->type == equality_node || left_parent->type == beta_not || left_parent->type == beta_root || left_parent->type == beta_or);
   assert(right_parent->type == alpha || right_parent->type == beta_not  || left_parent->type == beta_or || right_parent->type == beta_and || right_parent->type == selector_node);
-  return  _create_beta_node(net, left_parent, right_parent, beta_and, free_vars, in_positive_lhs_part, rule_no);
+  node = _create_beta_node(net, left_parent, right_parent, beta_and, free_vars, in_positive_lhs_part, rule_no);
+  node->val.beta.join_vars = beta_join_vars(left_parent, right_parent);
+  return node;
 }
 
 
@@ -186,7 +279,9 @@ rete_node* create_beta_or_node(rete_net* net, rete_node* left_parent, rete_node*
 rete_node* create_beta_not_node(rete_net* net, rete_node* left_parent, rete_node* right_parent, const freevars* free_vars, unsigned int rule_no){
   assert(left_parent->type == beta_and  || left_parent->type == equality_node ||left_parent->type == beta_not   || left_parent->type == beta_or ||  left_parent->type == alpha);
   assert(right_parent->type == alpha || right_parent->type == beta_and || right_parent->type == beta_or || right_parent->type == equality_node);
-  return  _create_beta_node(net, left_parent, right_parent, beta_not, free_vars, false, rule_no);
+  rete_node* node = _create_beta_node(net, left_parent, right_parent, beta_not, free_vars, false, rule_no);
+  node->val.beta.join_vars = beta_join_vars(left_parent, right_parent);
+  return node;
 }
 
 rete_node* create_rule_node(rete_net* net, rete_node* parent, const clp_axiom* ax, const freevars* vars, unsigned int rule_no){
@@ -248,6 +343,8 @@ void delete_rete_net(rete_net* net){
   unsigned int i;
   for(i = 0; i < net->n_selectors; i++)
     delete_rete_node((rete_node*) & net->selectors[i]);
+  if(net->static_fact_counts != NULL)
+    free(net->static_fact_counts);
   free(net);
 }
 
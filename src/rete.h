@@ -57,7 +57,7 @@ void insert_rete_alpha_fact_children(rete_net_state*, const rete_node*, const cl
 
 // Creates root of network
 // Initializes the rete_net_state structure
-rete_net* init_rete(const theory*, unsigned long, bool lazy, bool coq, bool multithread_rete);
+rete_net* init_rete(const theory*, unsigned long, bool lazy, bool coq, bool multithread_rete, unsigned int n_rete_threads);
 
 /** 
     Creates a "copy" of a rete net state
@@ -100,10 +100,14 @@ const rete_node* get_const_selector(unsigned int, const rete_net*);
 // Updates network with possibly new predicate name, returns the bottom alpha node for this atom
 rete_node* create_rete_atom_node(rete_net*, const clp_atom*, const freevars*, bool propagate, bool in_positive_lhs_part, unsigned int axiom_no);
 rete_node* create_rete_axiom_node(rete_net*, const clp_axiom*, unsigned int axiom_no, bool);
-rete_net* create_rete_net(const theory*, unsigned long, bool, strategy, bool, bool, bool, bool, bool, bool, bool, bool);
+rete_net* create_rete_net(const theory*, unsigned long, bool, strategy, bool, bool, bool, bool, bool, bool, bool, bool, unsigned int, bool plan_joins);
 rete_node* create_rete_conj_node(rete_net*, const clp_conjunction*, const freevars*, bool propagate, bool in_postive_lhs_part, unsigned int axiom_no);
 rete_node* create_rete_disj_node(rete_net*, rete_node*, const clp_disjunction*, unsigned int axiom_no);
 rete_node * insert_beta_not_nodes(rete_net* net, const clp_conjunction* con, const clp_disjunction* dis, rete_node* beta_node, unsigned int axiom_no);
+clp_conjunction* create_planned_conjunction(const rete_net*, const clp_conjunction*);
+void delete_planned_conjunction(clp_conjunction*);
+
+bool rete_node_uses_equality(const rete_node*);
 
 bool true_ground_equality(const clp_term*, const clp_term*, const substitution*, constants*, timestamps*, timestamp_store*, bool update_ts);
 
@@ -120,7 +124,15 @@ rule_instance* choose_next_instance(rule_queue_state
 				    , rule_instance* (*pop_axiom)(rule_queue_state, unsigned int)
 				    , void (*) (const clp_axiom*, const substitution*, rule_queue_state)
 				    , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+				    , axiom_heap* (*axiom_heaps)(rule_queue_state, axiom_heap_kind)
 				    );
+axiom_heap_kind get_axiom_heap_kind(const clp_axiom*);
+unsigned int axiom_heap_weight(rule_queue_state
+			       , const rete_net*
+			       , unsigned int
+			       , unsigned int (*possible_age)(rule_queue_state, unsigned int)
+			       , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+			       );
 
 
 
@@ -131,7 +143,15 @@ void delete_rete_net(rete_net*);
 // In prover.c
 unsigned int prover(const rete_net*, bool);
 // In prover_single.c
-unsigned int prover_single(const rete_net*, bool);
+/**
+   How the last proof ended, see get_prover_outcome. 
+   no_prover_outcome if no proof has ended, for example if the theory could not be parsed.
+**/
+typedef enum prover_outcome_t { no_prover_outcome, proof_outcome, model_outcome, max_steps_outcome, timeout_outcome } prover_outcome;
+unsigned int prover_single(const rete_net*, bool, arena*);
+prover_outcome get_prover_outcome(void);
+unsigned int start_prover_deadline(void);
+bool expire_prover_deadline(unsigned int);
 
 
 bool test_rete_net(const rete_net*);
@@ -108,12 +108,11 @@ void insert_rete_beta_sub_single(const rete_net* net,
     fprintf(out, "\n");
     finished_logging(__FILE__, __LINE__);
 #endif	
-    if(insert_substitution_single(node_caches, node->val.rule.store_no, sub, node->free_vars, cs, ts_store)){
+    if(insert_compact_substitution_single(node_caches, node->val.rule.store_no, sub, node->free_vars)){
       push_rule_instance_single(rule_queue
 				, node->val.rule.axm
 				, sub
 				, step
-				, net->strat == clpl_strategy
 				, ts_store
 				, cs
 				);
@@ -137,11 +136,10 @@ void insert_rete_beta_sub_single(const rete_net* net,
       t2 = node->val.equality.t2;
       c2 = get_instantiated_constant(t2, sub, cs);
       add_reflexivity_timestamp(&sub->sub_ts, step, ts_store);
-      if(insert_substitution_single(node_caches, 
-				    node->val.equality.b_store_no, 
-				    sub, node->free_vars, cs, 
-				    ts_store
-				    ))
+      if(insert_compact_substitution_single(node_caches, 
+					    node->val.equality.b_store_no, 
+					    sub, node->free_vars
+					    ))
 	{
 	  if(equal_constants_mt(c1, c2, cs, &sub->sub_ts, ts_store, true))
 	    insert_rete_beta_sub_single(net, node_caches, tmp_subs, ts_store, rule_queue, node, node->children[0], step, sub, cs);
@@ -162,7 +160,8 @@ void insert_rete_beta_sub_single(const rete_net* net,
 	  fprintf(out, "\n");
 	  finished_logging(__FILE__, __LINE__);
 #endif	
-	  iter = get_array_sub_store_iter(node_caches, node->val.beta.a_store_no);
+	  unsigned int key[SUB_STORE_COLUMNS_KEY_SIZE(node->val.beta.join_vars)];
+	  iter = get_array_sub_store_join_iter(node_caches, node->val.beta.a_store_no, node->val.beta.join_vars, sub, cs, key);
 	  while(has_next_sub_store(& iter)){
 	    bool overlapping_subs = false;
 	    if(node->in_positive_lhs_part)
@@ -178,14 +177,14 @@ void insert_rete_beta_sub_single(const rete_net* net,
     case beta_not:
       if(parent == node->left_parent){
 	if(
-	   insert_substitution_single(node_caches, 
-				      node->val.beta.b_store_no, 
-				      sub, node->free_vars, cs, 
-				      ts_store
-				      ))
+	   insert_compact_substitution_single(node_caches, 
+					      node->val.beta.b_store_no, 
+					      sub, node->free_vars
+					      ))
 	  {
 	    bool found_overlapping_sub = false;
-	    iter = get_array_sub_store_iter(node_caches, node->val.beta.a_store_no);
+	    unsigned int key[SUB_STORE_COLUMNS_KEY_SIZE(node->val.beta.join_vars)];
+	    iter = get_array_sub_store_columns_iter(node_caches, node->val.beta.a_store_no, node->val.beta.join_vars, sub, cs, key);
 	    while(has_next_sub_store(& iter)){
 	      if(subs_equal_intersection(sub, get_next_sub_store(& iter), cs)){
 		found_overlapping_sub = true;
@@ -236,7 +235,8 @@ void insert_rete_alpha_beta(const rete_net* net,
   else {
     substitution* tmp_sub = create_empty_substitution(net->th, tmp_subs);
     substitution_size_info ssi = net->th->sub_size_info;
-    sub_store_iter iter = get_array_sub_store_iter(node_caches, node->val.beta.b_store_no);
+    unsigned int key[SUB_STORE_COLUMNS_KEY_SIZE(node->val.beta.join_vars)];
+    sub_store_iter iter = get_array_sub_store_join_iter(node_caches, node->val.beta.b_store_no, node->val.beta.join_vars, sub, cs, key);
     while(has_next_sub_store(& iter)){
       bool has_overlap;
       if(node->in_positive_lhs_part)
@@ -256,6 +256,12 @@ void insert_rete_alpha_beta(const rete_net* net,
    For each beta node, first re-inserts all beta into the next beta-node, 
    then reinserts all from the alpha node into the beta node.
 
+   If classes is not NULL, only the substitutions in the alpha stores containing
+   a constant in one of the classes are reinserted. These are the equivalence classes 
+   merged by the new equalities. Any new join or passed equality test must involve 
+   a constant from such a class, and the substitutions from the other alpha stores
+   are found by the joins in insert_rete_alpha_beta
+
    Should first be called at the rule node, iterates backwards
 **/
 void recheck_beta_node(const rete_net* net,
@@ -265,7 +271,8 @@ void recheck_beta_node(const rete_net* net,
 		       const rete_node* node, 
 		       rule_queue_single * rule_queue,
 		       unsigned int step, 
-		       constants* cs)
+		       constants* cs,
+		       const constant_classes* classes)
 {
   sub_store_iter iter;
   substitution* tmp_sub;
@@ -273,14 +280,17 @@ void recheck_beta_node(const rete_net* net,
   case beta_root:
     return;
   case equality_node:
-    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->left_parent, rule_queue, step, cs);
+    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->left_parent, rule_queue, step, cs, classes);
     break;
   case beta_not:
-    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->val.beta.right_parent, rule_queue, step, cs);
+    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->val.beta.right_parent, rule_queue, step, cs, classes);
     break;
   case beta_and:
     tmp_sub = create_empty_substitution(net->th, tmp_subs);
-    iter= get_array_sub_store_iter(node_caches, node->val.beta.a_store_no);
+    if(classes != NULL)
+      iter = get_array_sub_store_class_iter(node_caches, node->val.beta.a_store_no, classes, cs);
+    else
+      iter = get_array_sub_store_iter(node_caches, node->val.beta.a_store_no);
     while(has_next_sub_store(& iter)){
       copy_substitution_struct(tmp_sub, get_next_sub_store(&iter), net->th->sub_size_info, ts_store, false, cs);
       insert_rete_alpha_beta(net, node_caches, tmp_subs, ts_store, node, rule_queue, step, tmp_sub, cs);
@@ -295,7 +305,7 @@ void recheck_beta_node(const rete_net* net,
     exit(EXIT_FAILURE);
   }
   if(node->type != equality_node)
-    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->left_parent, rule_queue, step, cs);
+    recheck_beta_node(net, node_caches, tmp_subs, ts_store, node->left_parent, rule_queue, step, cs, classes);
 }
 /**
    Inserting fact into all alpha children 
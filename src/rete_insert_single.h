@@ -49,5 +49,6 @@ void recheck_beta_node(const rete_net* net,
 		       const rete_node* node, 
 		       rule_queue_single * rule_queue,
 		       unsigned int step, 
-		       constants* cs);
+		       constants* cs,
+		       const constant_classes* classes);
 #endif
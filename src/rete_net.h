@@ -53,6 +53,15 @@
 
    n_rules is the number of rules entered into the rete net. 
    This is set in create_rete_net in theory.c, usually to the number of axioms that are not facts.
+
+   n_rete_threads is the number of threads given by -W|--workers. 0 means the number of online processors. 
+   These are the threads of the rete_worker_pool, except with -M|--multithreaded, 
+   where they are shared with the branches, see prover_single.c
+
+   plan_joins is set by the commandline option -j|--join-order. The lhs conjuncts are then reordered
+   by create_planned_conjunction in con_dis.c before the beta nodes are constructed.
+   static_fact_counts is then the number of facts with each predicate in the initial model, indexed by pred_no.
+   It is NULL otherwise.
 **/
 typedef struct rete_net_t {
   unsigned int n_subs;
@@ -66,6 +75,9 @@ typedef struct rete_net_t {
   bool factset_lhs;
   bool use_beta_not;
   bool multithread_rete;
+  unsigned int n_rete_threads;
+  bool plan_joins;
+  unsigned int * static_fact_counts;
   strategy strat;
 #ifdef HAVE_PTHREAD
   pthread_mutex_t * sub_mutexes;
@@ -55,6 +55,11 @@
  a_store_no, b_store_no are indexes into the subsititution_list array "subs" in the rete_state.
  They represent the caches/stores of already treated substitutions in the alpha and beta node, respectively.
  
+ join_vars is the set of variables bound both by the left and the right parent of 
+ a beta_and or beta_not node. The alpha and beta stores of beta_and nodes are hash-indexed on these, 
+ and the alpha store of beta_not nodes is scanned column-wise on these. 
+ It is NULL for other node types.
+
  a_store_used_no is also an index into subs, 
  but points to the last used substitution_list entry for the alpha store.
  The latter is used by the "lazy" extension of rete.
@@ -82,6 +87,7 @@ struct rete_node_t {
       unsigned int a_store_no;
       unsigned int a_store_used_no;
       unsigned int b_store_no;
+      const freevars* join_vars;
     } beta;
     struct equality_t {
       const clp_term* t1;
@@ -30,15 +30,26 @@
 #include "theory.h"
 #include "rete.h"
 #include "instantiate.h"
+#include "error_handling.h"
 
 #include <string.h>
 #include <error.h>
 
+#ifdef HAVE_PTHREAD
+/**
+   Protects the parts of the proof shared between split states: 
+   The used_in_proof flags in the histories, the elim stacks of the proof branches, 
+   and the lists of split states
+**/
+pthread_mutex_t split_proof_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 /**
    Called after the rete net is created.
-   Initializes the substition lists and queues in the state
+   Initializes the substition lists and queues in the state. 
+   n_threads is the number of threads in the rete pool, 0 means the number of online processors. 
 **/
-rete_state_single* create_rete_state_single(const rete_net* net, bool verbose){
+rete_state_single* create_rete_state_single(const rete_net* net, bool verbose, unsigned int n_threads, arena* run_arena){
   unsigned int i;
   substitution_size_info ssi = net->th->sub_size_info;
   rete_state_single* state = malloc_tester(sizeof(rete_state_single));
@@ -50,65 +61,205 @@ rete_state_single* create_rete_state_single(const rete_net* net, bool verbose){
   state->fresh = init_fresh_const(net->th->vars->n_vars);
   assert(state->fresh != NULL);
   //  state->constants = init_constants(net->th->vars->n_vars);
+  state->arena = run_arena;
   state->constants = copy_constants(net->th->constants, state->timestamp_store);
+  state->constants->arena = state->arena;
+  init_undo_trail(& state->trail);
+  for(i = 0; i < state->node_subs->n_stores; i++)
+    state->node_subs->stores[i].trail = & state->trail;
   state->cur_step = 0;
   state->total_steps = 0;
+  state->steps_done = malloc_tester(sizeof(unsigned int));
+  *(state->steps_done) = 0;
+  state->cancelled = malloc_tester(sizeof(bool));
+  *(state->cancelled) = false;
+  state->ground_atoms = init_ground_atom_table();
+  state->parent = NULL;
+  state->history_start = 0;
+  state->split_states = NULL;
+  state->n_split_states = 0;
+  state->size_split_states = 0;
   state->rule_queues = calloc_tester(net->th->n_axioms, sizeof(rule_queue_single*));
   state->worker_queues = calloc_tester(net->th->n_axioms, sizeof(rete_worker_queue*));
+  state->worker_batches = calloc_tester(net->th->n_axioms, sizeof(worker_queue_batch));
 #ifdef HAVE_PTHREAD
   state->workers = calloc_tester(net->th->n_axioms, sizeof(rete_worker*));
+  state->worker_pool = init_rete_worker_pool(n_threads);
 #endif
   for(i = 0; i < net->th->n_axioms; i++){
-    state->rule_queues[i] = initialize_queue_single(ssi, i, false, false);
+    state->rule_queues[i] = initialize_queue_single(ssi, i, false, false, net->strat == clpl_strategy);
     state->worker_queues[i] = init_rete_worker_queue();
+    init_worker_queue_batch(& state->worker_batches[i]);
+    state->rule_queues[i]->trail = & state->trail;
+    state->worker_queues[i]->trail = & state->trail;
 #ifdef HAVE_PTHREAD
-    state->workers[i] = init_rete_worker(state->net, i, & state->tmp_subs, state->node_subs, state->timestamp_store,  state->rule_queues[i], state->worker_queues[i], & state->constants);
+    state->workers[i] = init_rete_worker(state->net, i, & state->tmp_subs, state->node_subs, state->timestamp_store,  state->rule_queues[i], state->worker_queues[i], & state->constants, state->worker_pool, state->cancelled);
 #endif
   }
-  state->history = initialize_queue_single(ssi, 0, true, true);
+  for(i = 0; i < n_axiom_heap_kinds; i++)
+    init_axiom_heap(& state->axiom_heaps[i], net->th->n_axioms);
+  state->history = initialize_queue_single(ssi, 0, true, true, false);
   state->factsets = calloc_tester(net->th->n_predicates, sizeof(fact_store));
   state->new_facts_iters = calloc_tester(net->th->n_predicates, sizeof(fact_store_iter));
   for(i = 0; i < net->th->n_predicates; i++){
-    state->factsets[i] = init_fact_store();
+    state->factsets[i] = init_fact_store(net->th->predicates[i]->arity);
+    state->factsets[i].trail = & state->trail;
     state->new_facts_iters[i] = get_fact_store_iter(&state->factsets[i]);
   }
   state->root_branch = create_root_proof_branch();
+  state->root_branch_id = state->root_branch->id;
   state->current_proof_branch = state->root_branch;
   state->finished = false;
   return state;
 }
 
+/**
+   Called before the state is split by split_rete_state_single. 
+   Pauses all workers until end_rete_state_split, such that the state 
+   does not change while it is copied
+**/
+void begin_rete_state_split(rete_state_single* state){
+#ifdef HAVE_PTHREAD
+  unsigned int i;
+  for(i = 0; i < state->net->th->n_axioms; i++)
+    pause_rete_worker(state->workers[i]);
+  for(i = 0; i < state->net->th->n_axioms; i++)
+    wait_for_worker_to_pause(state->workers[i]);
+#endif
+}
+
+/**
+   Called when the branches split from the state are finished. 
+   total_steps is the highest step number used in the branches. 
+   Later steps in the state are numbered after this, such that the 
+   step numbers are unique in the whole proof.
+**/
+void end_rete_state_split(rete_state_single* state, unsigned int total_steps){
+#ifdef HAVE_PTHREAD
+  unsigned int i;
+#endif
+  if(total_steps > state->total_steps)
+    state->total_steps = total_steps;
+#ifdef HAVE_PTHREAD
+  for(i = 0; i < state->net->th->n_axioms; i++)
+    continue_rete_worker(state->workers[i]);
+#endif
+}
+
+/**
+   Creates a copy of orig for running the branch br of a disjunction, 
+   in parallel with the other branches. Called between begin_rete_state_split 
+   and end_rete_state_split on orig. 
+
+   The node caches, the queues and the factsets are copied, 
+   without indexes. The substitutions, rule instances and constants 
+   share timestamp blocks with orig, see timestamps.h. 
+   The copy starts with an empty history and undo trail. 
+
+   The steps of all the branches are numbered from the step after the last step of orig, 
+   so parallel branches use the same step numbers. This is harmless, since the branches never 
+   look up each others steps: get_historic_rule_instance only goes to the parents. 
+   The nodes in the dot proof (-p) are named by both the branch and the step, and 
+   the branches are separate subproofs in the coq proof. 
+   Its workers are run by the pool of orig, and use the substitution store 
+   of the state without parent, since the threads in the pool keep their substitutions.
+**/
+rete_state_single* split_rete_state_single(rete_state_single* orig, proof_branch* br){
+  unsigned int i;
+  const rete_net* net = orig->net;
+  substitution_size_info ssi = net->th->sub_size_info;
+  rete_state_single* state = malloc_tester(sizeof(rete_state_single));
+#ifdef HAVE_PTHREAD
+  rete_state_single* root = orig;
+  while(root->parent != NULL)
+    root = root->parent;
+#endif
+  state->net = net;
+  state->verbose = orig->verbose;
+  state->fresh = orig->fresh;
+  state->timestamp_store = init_timestamp_store(ssi);
+  state->tmp_subs = init_substitution_store_mt(ssi);
+  state->arena = init_arena(ARENA_BRANCH_BLOCK_SIZE);
+  state->constants = copy_constants(orig->constants, state->timestamp_store);
+  state->constants->arena = state->arena;
+  init_undo_trail(& state->trail);
+  state->node_subs = copy_substitution_store_array(orig->node_subs);
+  for(i = 0; i < state->node_subs->n_stores; i++)
+    state->node_subs->stores[i].trail = & state->trail;
+  state->cur_step = orig->cur_step;
+  state->total_steps = orig->total_steps;
+  state->steps_done = orig->steps_done;
+  state->cancelled = orig->cancelled;
+  state->ground_atoms = orig->ground_atoms;
+  state->parent = orig;
+  state->history_start = orig->total_steps + 1;
+  state->split_states = NULL;
+  state->n_split_states = 0;
+  state->size_split_states = 0;
+  state->rule_queues = calloc_tester(net->th->n_axioms, sizeof(rule_queue_single*));
+  state->worker_queues = calloc_tester(net->th->n_axioms, sizeof(rete_worker_queue*));
+  state->worker_batches = calloc_tester(net->th->n_axioms, sizeof(worker_queue_batch));
+#ifdef HAVE_PTHREAD
+  state->workers = calloc_tester(net->th->n_axioms, sizeof(rete_worker*));
+  state->worker_pool = orig->worker_pool;
+#endif
+  for(i = 0; i < net->th->n_axioms; i++){
+    state->rule_queues[i] = copy_rule_queue_single(orig->rule_queues[i]);
+    state->worker_queues[i] = copy_rete_worker_queue(orig->worker_queues[i]);
+    init_worker_queue_batch(& state->worker_batches[i]);
+    state->rule_queues[i]->trail = & state->trail;
+    state->worker_queues[i]->trail = & state->trail;
+#ifdef HAVE_PTHREAD
+    state->workers[i] = copy_rete_worker(orig->workers[i], & root->tmp_subs, state->node_subs, state->timestamp_store, state->rule_queues[i], state->worker_queues[i], & state->constants);
+#endif
+  }
+  for(i = 0; i < n_axiom_heap_kinds; i++)
+    init_axiom_heap(& state->axiom_heaps[i], net->th->n_axioms);
+  state->history = initialize_queue_single(ssi, 0, true, true, false);
+  state->factsets = calloc_tester(net->th->n_predicates, sizeof(fact_store));
+  state->new_facts_iters = calloc_tester(net->th->n_predicates, sizeof(fact_store_iter));
+  for(i = 0; i < net->th->n_predicates; i++){
+    state->factsets[i] = copy_fact_store(& orig->factsets[i]);
+    state->factsets[i].trail = & state->trail;
+    state->new_facts_iters[i] = get_fact_store_iter(&state->factsets[i]);
+    state->new_facts_iters[i].n = orig->new_facts_iters[i].n;
+  }
+  state->root_branch = br;
+  state->root_branch_id = br->id;
+  state->current_proof_branch = br;
+  state->finished = false;
+#ifdef HAVE_PTHREAD
+  for(i = 0; i < net->th->n_axioms; i++)
+    notify_rete_worker(state->workers[i]);
+#endif
+  reset_axiom_weights_single(state);
+  return state;
+}
+
 /**
    Creates information necessary to return to a branching point after treating a branch
 
-   Backs up factsets, rule queues, and node caches. 
+   Backs up the constants and the timestamp store, and starts a new generation on the undo trail. 
+   The factsets, rule queues, worker queues and node caches are pushed on the trail when they are 
+   first changed after this, see undo_trail.h
 **/
 rete_state_backup backup_rete_state(rete_state_single* state){
   rete_state_backup backup;
-  unsigned int i;
 #ifdef HAVE_PTHREAD
+  unsigned int i;
   for(i = 0; i < state->net->th->n_axioms; i++)
     pause_rete_worker(state->workers[i]);
 #endif
   backup.current_proof_branch = state->current_proof_branch;
   backup.cur_step = state->cur_step;
-  backup.factset_backups = backup_fact_store_array(state->factsets, state->net->th->n_predicates);
-  backup.new_facts_backups = calloc(state->net->th->n_predicates, sizeof(fact_store_iter));
-  copy_fact_iter_array(backup.new_facts_backups, state->new_facts_iters, state->net->th->n_predicates);
   backup.state = state;
 #ifdef HAVE_PTHREAD
   for(i = 0; i < state->net->th->n_axioms; i++)
     wait_for_worker_to_pause(state->workers[i]);
 #endif
-  backup.constants = backup_constants(state->constants, state->timestamp_store);
-  backup.node_sub_backups = backup_substitution_store_array(state->node_subs);
+  backup.constants = backup_constants(state->constants);
   backup.timestamp_backup = backup_timestamp_store(state->timestamp_store);
-  backup.rq_backups = calloc_tester(state->net->th->n_axioms, sizeof(rule_queue_single_backup));
-  backup.worker_backups = calloc_tester(state->net->th->n_axioms, sizeof(rete_worker_queue_backup));
-  for(i = 0; i < state->net->th->n_axioms; i++){
-    backup.rq_backups[i] = backup_rule_queue_single(state->rule_queues[i]);
-    backup.worker_backups[i] = backup_rete_worker_queue(state->worker_queues[i]);
-  }
+  backup.trail_backup = backup_undo_trail(& state->trail);
 #ifdef HAVE_PTHREAD
 
   for(i = 0; i < state->net->th->n_axioms; i++)
@@ -117,25 +268,40 @@ rete_state_backup backup_rete_state(rete_state_single* state){
   return backup;
 }
 
+/**
+   Called when the prover sees an equality, before changing the constants. 
+   Only the workers of axioms that depend on equalities are paused, 
+   the others continue running
+**/
 void pause_rete_state_workers(rete_state_single* state){
 #ifdef HAVE_PTHREAD
    unsigned int i;
-  for(i = 0; i < state->net->th->n_axioms; i++)
-    pause_rete_worker(state->workers[i]);
-  for(i = 0; i < state->net->th->n_axioms; i++)
-    wait_for_worker_to_pause(state->workers[i]);
+  for(i = 0; i < state->net->th->n_axioms; i++){
+    if(state->workers[i]->uses_equality)
+      pause_rete_worker(state->workers[i]);
+  }
+  for(i = 0; i < state->net->th->n_axioms; i++){
+    if(state->workers[i]->uses_equality)
+      wait_for_worker_to_pause(state->workers[i]);
+  }
 #endif
 }
 
 /**
-   Called when the prover sees an equality
+   Called when the prover sees an equality between c1 and c2, 
+   after pause_rete_state_workers and union_constants.
+   The workers paused there recheck the parts of the net containing the 
+   equivalence class of c1 and c2
 **/
-void recheck_rete_state_net(rete_state_single* state){
+void recheck_rete_state_net(rete_state_single* state, dom_elem c1, dom_elem c2){
 #ifdef HAVE_PTHREAD
   unsigned int i;
   for(i = 0; i < state->net->th->n_axioms; i++){
-    set_recheck_net(state->workers[i]);
-    continue_rete_worker(state->workers[i]);
+    if(state->workers[i]->uses_equality){
+      set_recheck_net(state->workers[i], c1, c2);
+      continue_rete_worker(state->workers[i]);
+      update_axiom_weight_single(state, i, true);
+    }
   }
 #endif
 }
@@ -145,7 +311,7 @@ void recheck_rete_state_net(rete_state_single* state){
    Called when treating disjunction in prover_single
 **/
 void enter_proof_disjunct(rete_state_single* state){
-  state->current_proof_branch = create_child_branch(state->current_proof_branch, state->net->th);
+  state->current_proof_branch = create_child_branch(state->current_proof_branch, state->net->th, state->arena);
 }
 
 /**
@@ -159,7 +325,7 @@ unsigned int get_state_step_no_single(const rete_state_single* state){
    Returns the total number of steps done. Called at the end of prover method
 **/
 unsigned int get_state_total_steps(const rete_state_single* state){
-  return state->total_steps;
+  return *(state->steps_done);
 }
 
 
@@ -168,52 +334,47 @@ unsigned int get_state_total_steps(const rete_state_single* state){
    the backup itself, since this is assumed to be static in prover_single.c
 **/
 void destroy_rete_backup(rete_state_backup* backup){
-  destroy_substitution_store_array_backup(backup->node_sub_backups);
-  destroy_fact_store_backup_array(backup->factset_backups, backup->state->net->th->n_predicates);
-  free(backup->new_facts_backups);
-  free(backup->rq_backups);
-  free(backup->worker_backups);
+  destroy_undo_trail_backup(& backup->state->trail, & backup->trail_backup);
+  destroy_timestamp_store_backup(& backup->timestamp_backup);
+  destroy_constants_backup(backup->state->constants, & backup->constants);
 }
 
 void restore_rete_state(rete_state_backup* backup, rete_state_single* state){
-  unsigned int i;
 #ifdef HAVE_PTHREAD
+  unsigned int i;
   for(i = 0; i < state->net->th->n_axioms; i++)
     pause_rete_worker(state->workers[i]);
 #endif
   state->current_proof_branch = backup->current_proof_branch;
   state->cur_step = backup->cur_step;
-  for(i = 0; i < state->net->th->n_predicates; i++)
-    restore_fact_store(& state->factsets[i], backup->factset_backups[i]);
-  copy_fact_iter_array(state->new_facts_iters, backup->new_facts_backups, state->net->th->n_predicates);
 #ifdef HAVE_PTHREAD
   for(i = 0; i < state->net->th->n_axioms; i++)
     wait_for_worker_to_pause(state->workers[i]);
 #endif
-  state->constants = copy_constants(backup->constants, state->timestamp_store);
-  state->node_subs = restore_substitution_store_array(backup->node_sub_backups);
+  restore_constants(state->constants, & backup->constants);
+  restore_undo_trail(& state->trail, & backup->trail_backup);
   state->timestamp_store = restore_timestamp_store(backup->timestamp_backup);
-  for(i = 0; i < backup->state->net->th->n_axioms; i++){
-    backup->state->rule_queues[i] = restore_rule_queue_single(backup->state->rule_queues[i], & backup->rq_backups[i]);
-    backup->state->worker_queues[i] = restore_rete_worker_queue(backup->state->worker_queues[i], & backup->worker_backups[i]);
-  }
 #ifdef HAVE_PTHREAD
   for(i = 0; i < state->net->th->n_axioms; i++)
     continue_rete_worker(state->workers[i]);
 #endif
+  reset_axiom_weights_single(state);
 }
 
 
 /**
-   Completely deletes rete state. Called at the end of prover() in prover.c
+   Deletes everything in the state, except the history, the constants and the split states, 
+   which are used for writing the coq proof. The workers are stopped first.
 **/
-void delete_rete_state_single(rete_state_single* state){
+void destroy_rete_state_single_net(rete_state_single* state){
   unsigned int i;
 #ifdef HAVE_PTHREAD
   for(i = 0; i < state->net->th->n_axioms; i++)
     destroy_rete_worker(state->workers[i]);
+  free(state->workers);
 #endif
   destroy_substitution_store_array(state->node_subs);
+  state->node_subs = NULL;
   for(i = 0; i < state->net->th->n_predicates; i++){
     destroy_fact_store(& state->factsets[i]);
     destroy_fact_store_iter(& state->new_facts_iters[i]);
@@ -223,27 +384,124 @@ void delete_rete_state_single(rete_state_single* state){
   for(i = 0; i < state->net->th->n_axioms; i++){
     destroy_rule_queue_single(state->rule_queues[i]);
     destroy_rete_worker_queue(state->worker_queues[i]);
+    destroy_worker_queue_batch(& state->worker_batches[i]);
   }
-  destroy_rule_queue_single(state->history);
   destroy_substitution_store_mt(& state->tmp_subs);
   destroy_timestamp_store(state->timestamp_store);
   free(state->rule_queues);
   free(state->worker_queues);
+  free(state->worker_batches);
+  for(i = 0; i < n_axiom_heap_kinds; i++)
+    destroy_axiom_heap(& state->axiom_heaps[i]);
+  destroy_undo_trail(& state->trail);
+}
+
+/**
+   Completely deletes rete state. Called at the end of prover() in prover.c
+   The proof branches are deleted with the state without parent, 
+   and the pool of workers is shared with this. 
+   The arena of a copy is merged into the arena of its parent, since the ground atoms, 
+   constants and branch names allocated there may be used by the other states.
+**/
+void delete_rete_state_single(rete_state_single* state){
+  unsigned int i;
+  if(state->node_subs != NULL)
+    destroy_rete_state_single_net(state);
+  for(i = 0; i < state->n_split_states; i++)
+    delete_rete_state_single(state->split_states[i]);
+  free(state->split_states);
+  destroy_rule_queue_single(state->history);
   destroy_constants(state->constants);
-  delete_proof_branch_tree(state->root_branch);  
+  if(state->parent == NULL){
+#ifdef HAVE_PTHREAD
+    destroy_rete_worker_pool(state->worker_pool);
+#endif
+    delete_proof_branch_tree(state->root_branch);  
+    free(state->steps_done);
+    free(state->cancelled);
+    destroy_ground_atom_table(state->ground_atoms);
+  } else {
+#ifdef HAVE_PTHREAD
+    pt_err(pthread_mutex_lock(& split_proof_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+    merge_arena(state->parent->arena, state->arena);
+#ifdef HAVE_PTHREAD
+    pt_err(pthread_mutex_unlock(& split_proof_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+    destroy_arena(state->arena);
+  }
   free(state);
 }
 
+/**
+   Called when the branch run on a state from split_rete_state_single is finished. 
+   If keep is true, the history and constants are kept for writing the coq proof, 
+   and the state is added to the split states of its parent. Otherwise the state is deleted. 
+   Note that the constants then only can be used for the names, 
+   since their timestamps are deleted with the timestamp store.
+**/
+void finish_split_rete_state_single(rete_state_single* state, bool keep){
+  rete_state_single* parent = state->parent;
+  if(!keep){
+    delete_rete_state_single(state);
+    return;
+  }
+  destroy_rete_state_single_net(state);
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& split_proof_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  if(parent->n_split_states >= parent->size_split_states){
+    parent->size_split_states = 2 * parent->size_split_states + 2;
+    parent->split_states = realloc_tester(parent->split_states, parent->size_split_states * sizeof(rete_state_single*));
+  }
+  parent->split_states[parent->n_split_states] = state;
+  parent->n_split_states++;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& split_proof_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+}
+
+/**
+   Returns the state that ran the branch br, which is either state, or 
+   one of the states kept by finish_split_rete_state_single. 
+   br must be a child of a branch run by state. 
+   Called when writing the coq proof, after the prover is finished.
+**/
+rete_state_single* get_proof_branch_state_single(rete_state_single* state, const proof_branch* br){
+  unsigned int i;
+  for(i = 0; i < state->n_split_states; i++){
+    if(state->split_states[i]->root_branch_id == br->id)
+      return state->split_states[i];
+  }
+  return state;
+}
 
 /**
-   Called after the prover is done. Stops all the worker threads, 
-   such that the rule queues are not invalidated.
+   Called when the proof search is over, because a model is found or the maximal number of steps is reached. 
+   The provers and the workers of the state and all its copies stop as soon as they see this, 
+   see is_rete_state_cancelled and run_rete_worker
+**/
+void cancel_rete_state(rete_state_single* state){
+  __atomic_store_n(state->cancelled, true, __ATOMIC_RELEASE);
+}
+
+bool is_rete_state_cancelled(const rete_state_single* state){
+  return __atomic_load_n(state->cancelled, __ATOMIC_ACQUIRE);
+}
+
+
+
+/**
+   Called after the prover is done. Stops all the workers and the threads
+   in the pool, such that the rule queues are not invalidated.
 **/
 void stop_rete_state_single(rete_state_single* state){
 #ifdef HAVE_PTHREAD
   unsigned int i;
   for(i = 0; i < state->net->th->n_axioms; i++)
     stop_rete_worker(state->workers[i]);
+  if(state->parent == NULL)
+    stop_rete_worker_pool(state->worker_pool);
 #endif
 }
 
@@ -264,12 +522,14 @@ bool test_rete_state(rete_state_single* state){
 }
   
 /**
-   This function is at the moment not threadsafe
+   The maximal number of steps given by -m|--max=LIMIT is compared with the 
+   number of steps done in all branches, also those run in parallel. 
 **/
 bool inc_proof_step_counter_single(rete_state_single* state){
+  unsigned int steps_done = __sync_add_and_fetch(state->steps_done, 1);
   state->total_steps ++;
   state->cur_step = state->total_steps;
-  return(state->net->maxsteps == 0 || state->total_steps < state->net->maxsteps);
+  return(state->net->maxsteps == 0 || steps_done < state->net->maxsteps);
 }
 
 sub_store_iter get_state_sub_store_iter(rete_state_single* state, unsigned int node_no){
@@ -304,6 +564,7 @@ rule_instance* transfer_from_rule_queue_to_history(rete_state_single* state, siz
 #ifdef HAVE_PTHREAD
   unlock_queue_single(rq, __FILE__, __LINE__);
 #endif
+  update_axiom_weight_single(state, axiom_no, false);
   assert(test_rule_instance(next, state->constants));
   return next;
 }
@@ -315,7 +576,6 @@ void add_rule_to_queue_single(const clp_axiom* rule, const substitution* sub, ru
                             , rule
                             , sub
                             , get_state_step_no_single(state)
-                            , state->net->strat == clpl_strategy
 			    , state->timestamp_store
 			    , state->constants
                             );
@@ -338,6 +598,25 @@ rule_instance* peek_axiom_rule_queue_single_state(rete_state_single * state, siz
 }
 
 
+/**
+   Iterates over the facts that may match the atom at under sub. 
+   Uses the index on the first argument position that is a constant
+   or a variable with a value in sub. 
+   Iterates over all facts with the predicate if there is no such position
+**/
+fact_store_iter get_conjunct_fact_store_iter(rete_state_single* state, const clp_atom* at, const substitution* sub){
+  unsigned int i;
+  fact_store* store = & state->factsets[at->pred->pred_no];
+  for(i = 0; i < at->args->n_args; i++){
+    const clp_term* t = at->args->args[i];
+    if(t->type == variable_term)
+      t = find_substitution(sub, t->val.var, state->constants);
+    if(t != NULL && t->type == constant_term)
+      return get_fact_store_arg_iter(store, i, t, state->constants);
+  }
+  return get_fact_store_iter(store);
+}
+
 /**
    For testing whether a conjunction with some substitutions already done, is true in the fact set
 
@@ -345,7 +624,6 @@ rule_instance* peek_axiom_rule_queue_single_state(rete_state_single * state, siz
 **/
 bool remaining_conjunction_true_in_fact_store(rete_state_single* state, const clp_conjunction* con, unsigned int conjunct, const substitution* sub){
   fact_store_iter iter;
-  unsigned int pred_no;
   substitution* tmp_sub;
   bool found_true = false;
 
@@ -356,8 +634,7 @@ bool remaining_conjunction_true_in_fact_store(rete_state_single* state, const cl
       return remaining_conjunction_true_in_fact_store(state, con, conjunct+1, sub);
     return false;
   }
-  pred_no = con->args[conjunct]->pred->pred_no;
-  iter = get_state_fact_store_iter(state, pred_no);
+  iter = get_conjunct_fact_store_iter(state, con->args[conjunct], sub);
   tmp_sub = create_empty_substitution(state->net->th, & state->tmp_subs);
 
   while(!found_true && has_next_fact_store(&iter)){
@@ -400,34 +677,37 @@ bool disjunction_true_in_fact_store(rete_state_single* state, const clp_disjunct
    Note that this pointer may be invalidated on the next call to this function
    (But not before)
 
+   The instance gets the position of the next step. Steps done in split states 
+   are not in the history, their positions are filled with dummies.
+
    Assumes the queue is locked. 
 **/
 rule_instance* insert_rule_instance_history_single(rete_state_single* state, const rule_instance* ri){
-  unsigned int step =  get_state_step_no_single(state) + 1;
-  while(get_rule_queue_single_size(state->history) < step) {
+  unsigned int step =  state->total_steps + 1;
+  while(state->history_start + get_rule_queue_single_size(state->history) < step) {
 #ifndef NDEBUG
     fprintf(stderr, "Pushing dummy rule instance on history for step %i\n", step);
 #endif
-    push_rule_instance_single(state->history, ri->rule, & ri->sub, step, false, state->timestamp_store, state->constants);
+    push_rule_instance_single(state->history, ri->rule, & ri->sub, step, state->timestamp_store, state->constants);
   }
   assert(test_rule_instance(ri, state->constants));
   assert(test_rule_queue_single(state->rule_queues[ri->rule->axiom_no], state->constants));
-  return push_rule_instance_single(state->history, ri->rule, & ri->sub, step, false, state->timestamp_store, state->constants);
+  return push_rule_instance_single(state->history, ri->rule, & ri->sub, step, state->timestamp_store, state->constants);
 }
 
+/**
+   The steps before the history of a split state are found in the history of the parent
+**/
 rule_instance* get_historic_rule_instance(rete_state_single* state, unsigned int step_no){
-  return get_rule_instance_single(state->history, step_no);
+  while(step_no < state->history_start)
+    state = state->parent;
+  return get_rule_instance_single(state->history, step_no - state->history_start);
 }
 
 /**
-   Called at the end of a disjunctive branch
-   Checks what rule instances were used
-   Called from run_prover_rete_coq_mt
-
-   At the moment, all rule instances are unique in each branch (they are copied when popped from the queue)
-   So we know that changing the "used_in_proof" here is ok.
+   Auxiliary for check_used_rule_instances_coq_single, which takes the mutex
 **/
-void check_used_rule_instances_coq_single(rule_instance* ri, rete_state_single* state, proof_branch* branch, timestamp historic_ts, timestamp current_ts){
+void mark_used_rule_instances_coq_single(rule_instance* ri, rete_state_single* state, proof_branch* branch, timestamp historic_ts, timestamp current_ts){
   assert(compare_timestamp(branch->end_step, historic_ts) >= 0 && compare_timestamp(branch->start_step, historic_ts) <= 0);
   if(!ri->used_in_proof){
     ri->used_in_proof = true; 
@@ -443,7 +723,7 @@ void check_used_rule_instances_coq_single(rule_instance* ri, rete_state_single*
 	  while(compare_timestamp(br->start_step,premiss_no) > 0)
 	    br = br->parent;
 	  assert(compare_timestamp(br->end_step, premiss_no) >= 0 && compare_timestamp(br->start_step, premiss_no) <= 0);
-	  check_used_rule_instances_coq_single(premiss_ri, state, br, premiss_no, current_ts);
+	  mark_used_rule_instances_coq_single(premiss_ri, state, br, premiss_no, current_ts);
 	}
       }
       destroy_timestamps_iter(&iter);
@@ -453,6 +733,26 @@ void check_used_rule_instances_coq_single(rule_instance* ri, rete_state_single*
   } // end if !ri->used in proof
 }
 
+/**
+   Called at the end of a disjunctive branch
+   Checks what rule instances were used
+   Called from run_prover_rete_coq_mt
+
+   At the moment, all rule instances are unique in each branch (they are copied when popped from the queue)
+   So we know that changing the "used_in_proof" here is ok.
+   The instances in the history of a parent are shared with the other split states, 
+   this is why the mutex is taken.
+**/
+void check_used_rule_instances_coq_single(rule_instance* ri, rete_state_single* state, proof_branch* branch, timestamp historic_ts, timestamp current_ts){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& split_proof_mutex), __FILE__, __LINE__, ": mutex lock");
+#endif
+  mark_used_rule_instances_coq_single(ri, state, branch, historic_ts, current_ts);
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& split_proof_mutex), __FILE__, __LINE__, ": mutex unlock");
+#endif
+}
+
 
 bool axiom_may_have_new_instance_single_state(rete_state_single* state, size_t axiom_no){
 #ifdef HAVE_PTHREAD
@@ -501,6 +801,9 @@ bool axiom_has_new_instance_single(rule_queue_state rqs, unsigned int axiom_no){
       pop_rule_queue_single(state->rule_queues[axiom_no], get_state_step_no_single(state), state->constants);
 #ifdef HAVE_PTHREAD
       unlock_queue_single(rq, __FILE__, __LINE__);
+#endif
+      update_axiom_weight_single(state, axiom_no, false);
+#ifdef HAVE_PTHREAD
     }
 #endif
   }
@@ -512,7 +815,11 @@ bool axiom_has_new_instance_single(rule_queue_state rqs, unsigned int axiom_no){
 
 
 /**
-   Inserts fact into rete network.
+   Adds fact to the rete network.
+
+   With the multithreaded rete network, the fact is put in the batches of the axioms 
+   with alpha nodes for its predicate, and is not seen by the workers before flush_state_rete_net_facts.
+   Otherwise it is inserted directly.
 
    An empty substitution is created on the heap and passed to the network
    This must not be touched after the call to insert_rete_alpha_fact, since it
@@ -521,7 +828,7 @@ bool axiom_has_new_instance_single(rule_queue_state rqs, unsigned int axiom_no){
    Note that calling this function may invalidate any rule_instance pointer, since these all 
    point to members of the rule_queue_single arrays, which may be realloced as a consqequence of this call
 **/
-void insert_state_rete_net_fact(rete_state_single* state, const clp_atom* fact){
+void add_state_rete_net_fact(rete_state_single* state, const clp_atom* fact){
   unsigned int i;
   substitution * tmp_sub = create_empty_substitution(state->net->th, &state->tmp_subs);
   const rete_node* sel = get_const_selector(fact->pred->pred_no, state->net);
@@ -530,18 +837,44 @@ void insert_state_rete_net_fact(rete_state_single* state, const clp_atom* fact){
   assert(sel != NULL && sel->val.selector == fact->pred);
   for(i = 0; i < sel->n_children; i++){
     const rete_node* child = sel->children[i];
-    if(state->net->multithread_rete){
-      push_rete_worker_queue(state->worker_queues[child->rule_no], fact, child, step);
-    } else {
+    if(state->net->multithread_rete)
+      add_worker_queue_batch(& state->worker_batches[child->rule_no], fact, child, step);
+    else {
       init_substitution(tmp_sub, state->net->th, step, state->timestamp_store);
       if(!insert_rete_alpha_fact_single(state->net, state->node_subs, &state->tmp_subs, state->timestamp_store, state->rule_queues[child->rule_no], child, fact, step, tmp_sub, state->net->th->constants))
 	// TODO: Add code to replace the worker->uninserted  for multithreaded case
 	assert(false);
+      update_axiom_weight_single(state, child->rule_no, true);
     }
   }
   free_substitution(tmp_sub);
 }
 
+/**
+   Pushes the facts added by add_state_rete_net_fact on the worker queues. 
+   Each queue is locked, and each worker woken, once for all the facts.
+**/
+void flush_state_rete_net_facts(rete_state_single* state){
+  unsigned int i;
+  for(i = 0; i < state->net->th->n_axioms; i++){
+    if(!worker_queue_batch_is_empty(& state->worker_batches[i])){
+      push_rete_worker_queue_batch(state->worker_queues[i], & state->worker_batches[i]);
+#ifdef HAVE_PTHREAD
+      notify_rete_worker(state->workers[i]);
+#endif
+      update_axiom_weight_single(state, i, true);
+    }
+  }
+}
+
+/**
+   Inserts fact into rete network. 
+**/
+void insert_state_rete_net_fact(rete_state_single* state, const clp_atom* fact){
+  add_state_rete_net_fact(state, fact);
+  flush_state_rete_net_facts(state);
+}
+
 
 /**
    Factset functions
@@ -549,7 +882,7 @@ void insert_state_rete_net_fact(rete_state_single* state, const clp_atom* fact){
 bool insert_state_factset_single(rete_state_single* state, const clp_atom* ground){
   bool already_in_factset = false;
   unsigned int pred_no = ground->pred->pred_no;
-  fact_store_iter iter = get_fact_store_iter(& state->factsets[pred_no]);
+  fact_store_iter iter = get_fact_store_atom_iter(& state->factsets[pred_no], ground, state->constants);
   while(has_next_fact_store(&iter)){
     const clp_atom* fact = get_next_fact_store(&iter);
     if(equal_atoms(fact, ground, state->constants, NULL, NULL, false)){
@@ -588,6 +921,8 @@ void print_state_new_fact_store(rete_state_single* state, FILE* f){
   unsigned int i;
   for(i = 0; i < state->net->th->n_predicates; i++){
     fact_store_iter* iter = & state->new_facts_iters[i];
+    if(has_next_fact_store(iter))
+      push_fact_iter_undo_trail(& state->trail, iter);
     while(has_next_fact_store(iter)){
       print_fol_atom(get_next_fact_store(iter), state->constants, f);
       fprintf(f, ", ");
@@ -681,6 +1016,46 @@ rule_instance* peek_axiom_rule_queue_single(rule_queue_state rqs, unsigned int a
 }
 
 
+axiom_heap* axiom_heaps_single(rule_queue_state rqs, axiom_heap_kind kind){
+  return & rqs.single->axiom_heaps[kind];
+}
+
+
+/**
+   Updates the weight of the axiom in its heap used by normal_next_instance, see axiom_heap.h. 
+   Called when the axiom may have got new instances, with insert true, and when instances are popped. 
+   If insert is false, only an axiom already in the heap is updated, since the strategy takes 
+   the axioms it tries out of the heap.
+**/
+void update_axiom_weight_single(rete_state_single* state, unsigned int axiom_no, bool insert){
+  axiom_heap* heap = & state->axiom_heaps[get_axiom_heap_kind(state->net->th->axioms[axiom_no])];
+  rule_queue_state rqs;
+  if(state->net->strat != normal_strategy)
+    return;
+  if(!insert && !axiom_in_heap(heap, axiom_no))
+    return;
+  rqs.single = state;
+  if(axiom_may_have_new_instance_single_state(state, axiom_no))
+    set_axiom_heap_weight(heap
+			  , axiom_no
+			  , axiom_heap_weight(rqs, state->net, axiom_no, rule_queue_possible_age_single, axiom_queue_previous_application_single));
+  else
+    remove_axiom_heap(heap, axiom_no);
+}
+
+/**
+   Rebuilds the axiom heaps after the rule queues were restored on 
+   backtracking, or copied when splitting
+**/
+void reset_axiom_weights_single(rete_state_single* state){
+  unsigned int i;
+  for(i = 0; i < n_axiom_heap_kinds; i++)
+    clear_axiom_heap(& state->axiom_heaps[i]);
+  for(i = 0; i < state->net->th->n_axioms; i++)
+    update_axiom_weight_single(state, i, true);
+}
+
+
 rule_instance* choose_next_instance_single(rete_state_single* state)
 {
   rule_queue_state rqs;
@@ -697,5 +1072,6 @@ rule_instance* choose_next_instance_single(rete_state_single* state)
 			      , pop_axiom_rule_queue_single
 			      , add_rule_to_queue_single
 			      , axiom_queue_previous_application_single
+			      , axiom_heaps_single
 			      );
 }
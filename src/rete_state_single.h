@@ -28,18 +28,28 @@
 #include "rule_queue_state.h"
 
 
-rete_state_single* create_rete_state_single(const rete_net*, bool);
+rete_state_single* create_rete_state_single(const rete_net*, bool, unsigned int, arena*);
 void stop_rete_state_single(rete_state_single*);
 void delete_rete_state_single(rete_state_single*);
 void pause_rete_state_workers(rete_state_single*);
 bool test_rete_state(rete_state_single*);
 
 rule_instance* choose_next_instance_single(rete_state_single*);
+void update_axiom_weight_single(rete_state_single*, unsigned int, bool);
+void reset_axiom_weights_single(rete_state_single*);
 rule_instance* insert_rule_instance_history_single(rete_state_single* state, const rule_instance*);
 rete_state_backup backup_rete_state(rete_state_single*);
 void destroy_rete_backup(rete_state_backup*);
 void restore_rete_state(rete_state_backup*, rete_state_single*);
 
+void begin_rete_state_split(rete_state_single*);
+void end_rete_state_split(rete_state_single*, unsigned int);
+rete_state_single* split_rete_state_single(rete_state_single*, proof_branch*);
+void finish_split_rete_state_single(rete_state_single*, bool);
+rete_state_single* get_proof_branch_state_single(rete_state_single*, const proof_branch*);
+void cancel_rete_state(rete_state_single*);
+bool is_rete_state_cancelled(const rete_state_single*);
+
 void check_used_rule_instances_coq_single(rule_instance*, rete_state_single*, proof_branch*, timestamp, timestamp);
 rule_instance* get_historic_rule_instance(rete_state_single*, unsigned int);
 void enter_proof_disjunct(rete_state_single*);
@@ -54,9 +64,11 @@ sub_store_iter get_state_sub_store_iter(rete_state_single*, unsigned int);
 fact_store_iter get_state_fact_store_iter(rete_state_single*, unsigned int);
 
 void insert_rete_worker_queue(rete_state_single*, substitution*, const clp_atom*, const rete_node*);
-void recheck_rete_state_net(rete_state_single*);
+void recheck_rete_state_net(rete_state_single*, dom_elem, dom_elem);
 
 void insert_state_rete_net_fact(rete_state_single* state, const clp_atom* fact);
+void add_state_rete_net_fact(rete_state_single* state, const clp_atom* fact);
+void flush_state_rete_net_facts(rete_state_single* state);
 
 void print_state_single_rule_queues(rete_state_single*, FILE*);
 void print_state_fact_store(rete_state_single *, FILE*);
@@ -29,6 +29,9 @@
 #include "substitution_store_array.h"
 #include "rete_worker.h"
 #include "proof_branch.h"
+#include "undo_trail.h"
+#include "ground_atoms.h"
+#include "axiom_heap.h"
 
 /**
    This version of a rete state is intended for a prover without or-parallellism, but
@@ -37,6 +40,31 @@
    subs is the substitutions stored in the node caches in the rete net
 
    new_facts_iters is used to keep track of what are the new facts at each step
+
+   trail is the undo trail used for backtracking. The node caches, the rule queues and worker queues 
+   of the axioms, the factsets and new_facts_iters push themselves on it when changed after a backup
+
+   With -M|--multithreaded, the branches of a disjunction may be run in parallel, each on its own copy of 
+   the state made by split_rete_state_single. parent is then the state that was split, and is NULL for the 
+   state created by create_rete_state_single. The parent is not changed while the copies run. 
+   root_branch is the branch the copy was made for, and root_branch_id is its id. 
+   The history of a copy only contains the steps from history_start, the earlier steps are in the history of the parent. 
+   steps_done counts the steps done by the state and all copies of it, and is owned by the state without a parent.
+   cancelled is set by cancel_rete_state when a branch has found a model or reached the maximal number of steps. 
+   It is shared like steps_done, and makes the prover and the workers of all copies stop.
+   ground_atoms contains the facts inserted by the prover, see ground_atoms.h, and is shared like steps_done.
+   arena is used for the ground atoms, the fresh constants and the names of the proof branches. 
+   The state without parent uses the arena of the proof run, given to create_rete_state_single. 
+   The copies have their own arena, which is merged into the arena of the parent when the copy is deleted.
+   total_steps is the number of the last step in the history, which is also steps_done if the state was never split. 
+   worker_batches collects the facts for the worker queues of each axiom until flush_state_rete_net_facts, 
+   such that the facts of a conjunction are pushed with one wakeup of each worker. They are empty between the steps.
+   split_states are the copies of the state kept after their branches were finished, 
+   because the coq proof is written from their histories. 
+   axiom_heaps are the heaps of the axioms that may have new instances, used by normal_next_instance in strategy.c, 
+   one for each axiom_heap_kind. An axiom may only get new instances when it gets new facts or the net is rechecked, 
+   and is then put in its heap. It is taken out when it has no more instances. 
+   The heaps are rebuilt on backtracking and splitting.
 **/
 typedef struct rete_state_single_t {
   proof_branch * current_proof_branch;
@@ -48,17 +76,31 @@ typedef struct rete_state_single_t {
   rule_queue_single * history;
 #ifdef HAVE_PTHREAD
   rete_worker ** workers;
+  rete_worker_pool * worker_pool;
 #endif
   rete_worker_queue ** worker_queues;
+  worker_queue_batch * worker_batches;
   fact_store * factsets;
   fact_store_iter * new_facts_iters;
   const rete_net* net;
   fresh_const_counter fresh;  
   constants* constants;
+  undo_trail trail;
   bool verbose;
   bool finished;
   unsigned int cur_step;
   unsigned int total_steps;
+  unsigned int * steps_done;
+  bool * cancelled;
+  ground_atom_table * ground_atoms;
+  arena * arena;
+  struct rete_state_single_t * parent;
+  unsigned int root_branch_id;
+  unsigned int history_start;
+  struct rete_state_single_t ** split_states;
+  unsigned int n_split_states;
+  unsigned int size_split_states;
+  axiom_heap axiom_heaps[n_axiom_heap_kinds];
 } rete_state_single;
 
 
@@ -68,13 +110,9 @@ typedef struct rete_state_single_t {
 typedef struct rete_state_backup_t {
   proof_branch * current_proof_branch;
   unsigned int cur_step;
-  rule_queue_single_backup * rq_backups;
-  substitution_store_array_backup * node_sub_backups;
-  constants* constants;
+  constants_backup constants;
   timestamp_store_backup timestamp_backup;
-  rete_worker_queue_backup * worker_backups;
-  fact_store_backup * factset_backups;
-  fact_store_iter * new_facts_backups;
+  undo_trail_backup trail_backup;
   rete_state_single* state;
 } rete_state_backup;
 
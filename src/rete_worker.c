@@ -22,6 +22,8 @@
 #include "common.h"
 #include "rete_worker.h"
 #include "rete_insert_single.h"
+#include "rete.h"
+#include "constants.h"
 #include <errno.h>
 #include <string.h>
 #include <sys/resource.h>
@@ -30,64 +32,55 @@
 #include <pthread.h>
 
 
-bool worker_pause(rete_worker* worker){
-  return worker->pause_signalled && !worker->stop_signalled;
-}
-
-bool worker_wait_for_pop(rete_worker*  worker){
-  return rete_worker_queue_is_empty(worker->work) && !worker->pause_signalled && !worker->stop_signalled && !worker->recheck_net;
-}
-
-bool worker_should_pop(rete_worker* worker){
-  return !rete_worker_queue_is_empty(worker->work) && !worker->pause_signalled && !worker->stop_signalled && !worker->recheck_net;
-}
-
 bool worker_may_have_new_instance(rete_worker* worker){
   bool retval;
+  if(__atomic_load_n(worker->cancelled, __ATOMIC_ACQUIRE))
+    return false;
   lock_worker_queue(worker->work, __FILE__, __LINE__);
   retval =  ! rule_queue_single_is_empty(worker->output)
     || ! rete_worker_queue_is_empty(worker->work)
+    || worker->recheck_net
     || rete_worker_is_working(worker);
   unlock_worker_queue(worker->work, __FILE__, __LINE__);
   return retval;
 }
 
 /**
-   Called by the worker to see if it must reevaluate the beta nodes
+   Pushes the worker on the pool if it has work and is not already scheduled.
+   The worker queue must be locked
 **/
-bool read_recheck_net(rete_worker* w){
-  bool retval = w->recheck_net;
-  w->recheck_net = false;
-  return retval;
+void schedule_rete_worker(rete_worker* worker){
+  if(!worker->scheduled && !worker->pause_signalled && !worker->stop_signalled && !__atomic_load_n(worker->cancelled, __ATOMIC_ACQUIRE)
+     && (worker->recheck_net || !rete_worker_queue_is_empty(worker->work))){
+    worker->scheduled = true;
+    push_rete_worker_pool(worker->pool, worker);
+  }
 }
+
 /**
-   Called by the prover when a new equality is inserted
+   Called by the prover after pushing on the worker queue
 **/
-void set_recheck_net(rete_worker* w){
-#ifdef HAVE_PTHREAD
-  lock_worker_queue(w->work, __FILE__, __LINE__);
-#endif
-  w->recheck_net = true;
-#ifdef HAVE_PTHREAD
-  signal_worker_queue(w->work, __FILE__, __LINE__);
-  unlock_worker_queue(w->work, __FILE__, __LINE__);
-#endif
+void notify_rete_worker(rete_worker* worker){
+  lock_worker_queue(worker->work, __FILE__, __LINE__);
+  schedule_rete_worker(worker);
+  unlock_worker_queue(worker->work, __FILE__, __LINE__);
 }
 
 /**
-   Called from rete_worker.
-   Waits for new elements to be added to the queue
+   Called by the prover when a new equality between c1 and c2 is inserted. 
+   The workers are then paused, and the worker is scheduled by continue_rete_worker
 **/
-void worker_thread_pop_worker_queue(rete_worker* worker, const clp_atom** fact, const rete_node ** alpha, unsigned int * step){
-  lock_worker_queue(worker->work, __FILE__, __LINE__);
-  while(worker_wait_for_pop(worker))
-    wait_worker_queue(worker->work, __FILE__, __LINE__);
-  if(worker_should_pop(worker)){
-    pop_rete_worker_queue(worker->work, fact, alpha, step);
-    __sync_lock_test_and_set(&worker->state, has_popped);
-    worker->step = *step;
+void set_recheck_net(rete_worker* w, dom_elem c1, dom_elem c2){
+  lock_worker_queue(w->work, __FILE__, __LINE__);
+  if(w->n_recheck_constants + 2 > w->size_recheck_constants){
+    w->size_recheck_constants = 2 * w->size_recheck_constants + 2;
+    w->recheck_constants = realloc_tester(w->recheck_constants, w->size_recheck_constants * sizeof(unsigned int));
   }
-  unlock_worker_queue(worker->work, __FILE__, __LINE__);
+  w->recheck_constants[w->n_recheck_constants++] = c1.id;
+  w->recheck_constants[w->n_recheck_constants++] = c2.id;
+  w->recheck_net = true;
+  schedule_rete_worker(w);
+  unlock_worker_queue(w->work, __FILE__, __LINE__);
 }
 
 /**
@@ -103,16 +96,33 @@ void insert_worker_uninserted_queue(rete_worker* worker, const clp_atom * fact,
 }
 
 /**
-   Reinserts all elements from the uninserted queue. Called when rechecking net
+   Returns true if some argument of the fact is a constant in one of the classes
+**/
+bool fact_in_constant_classes(const clp_atom* fact, const constant_classes* classes, constants* cs){
+  unsigned int i;
+  for(i = 0; i < fact->args->n_args; i++){
+    const clp_term* t = fact->args->args[i];
+    if(t->type == constant_term && in_constant_classes(t->val.constant.id, classes, cs))
+      return true;
+  }
+  return false;
+}
+
+/**
+   Reinserts the elements from the uninserted queue containing constants in the classes. 
+   Called when rechecking net. The other elements are put back in the queue in the same order.
 **/
-void worker_reinsert_uninserted(rete_worker* worker){
+void worker_reinsert_uninserted(rete_worker* worker, substitution* tmp_sub, const constant_classes* classes){
   unsigned int start_size;
   const clp_atom* fact;
   const rete_node* node;
   unsigned int step;
-  substitution* tmp_sub = create_empty_substitution(worker->net->th, worker->tmp_subs);
   for(start_size = get_rete_worker_queue_size(worker->uninserted); start_size > 0; start_size--){
     pop_rete_worker_queue(worker->uninserted, &fact, &node, &step);
+    if(!fact_in_constant_classes(fact, classes, *(worker->constants))){
+      push_rete_worker_queue(worker->uninserted, fact, node, step);
+      continue;
+    }
     worker->step = step;
     init_substitution(tmp_sub, worker->net->th, step, worker->timestamp_store);
     if (!insert_rete_alpha_fact_single(worker->net, worker->node_subs, worker->tmp_subs, worker->timestamp_store, worker->output, node, fact, step, tmp_sub, *(worker->constants)) )
@@ -121,95 +131,95 @@ void worker_reinsert_uninserted(rete_worker* worker){
 }
 
 /**
-   The main routine of the queue worker
+   The main routine of the queue worker. Called by a thread in the rete_worker_pool
 
-   This is set to asynchronous canceling, since the data it changes is 
-   not used after cancelation. 
+   Pops at most RETE_WORKER_BATCH_SIZE elements from the worker queue, 
+   or until the worker is paused or stopped. 
+   tmp_sub belongs to the calling thread, and is created on the first call.
 
-   The main loop runs for the whole runtime of the prover (stop_signalled arrives
-   at the very end.)
-   The first internal loop runs when the worker is paused, during treatment of disjunctions.
+   The prover is signalled once after the elements are treated, since it may wait for the worker to 
+   become idle, such that the backup process in the disjunction treatment can continue.
+   The new rule instances signal the prover themselves when pushed on the rule queue.
+   When the search is cancelled, the worker stops and the prover is signalled, since it may wait for this worker.
 
-   The signalling in the end of the loop is either to signal the prover that a new rule instance is arriving, 
-   or that it is again waiting, such that the backup process in the disjunction treatment can continue.
+   Returns true if the worker still has work, and must be pushed on the pool again. 
+   Otherwise the worker is no longer scheduled.
 **/
-void * queue_worker_routine(void* arg){
-  const rete_node* alpha;
-  const clp_atom* fact;
-  unsigned int step;
-  rete_worker * worker = arg;
-  substitution* tmp_sub = create_empty_substitution(worker->net->th, worker->tmp_subs);
-  while(!worker->stop_signalled){
-    lock_worker_queue(worker->work, __FILE__, __LINE__);
-    while(worker_pause(worker))
-      wait_worker_queue(worker->work, __FILE__, __LINE__);
-    unlock_worker_queue(worker->work, __FILE__, __LINE__);
-    if(worker->stop_signalled)
+bool run_rete_worker(rete_worker* worker, substitution** tmp_sub){
+  unsigned int n_popped;
+  bool reschedule;
+  if(*tmp_sub == NULL)
+    *tmp_sub = create_empty_substitution(worker->net->th, worker->tmp_subs);
+  lock_worker_queue(worker->work, __FILE__, __LINE__);
+  for(n_popped = 0; n_popped < RETE_WORKER_BATCH_SIZE; n_popped++){
+    if(worker->pause_signalled || worker->stop_signalled)
       break;
-    if(read_recheck_net(worker)){
-      worker->state = has_popped;
-#ifdef __DEBUG_RETE_STATE
-      printf("Rechecking relevant parts of rete net for axiom %s.\n", worker->net->th->axioms[worker->axiom_no]->name);
-#endif
-      recheck_beta_node(worker->net, worker->node_subs, worker->tmp_subs, worker->timestamp_store, worker->net->rule_nodes[worker->axiom_no], worker->output, step, *(worker->constants));
-      worker_reinsert_uninserted(worker);
-    } else {
-      worker_thread_pop_worker_queue(worker, &fact, &alpha, & step);
-      if(worker->state == has_popped){
-	init_substitution(tmp_sub, worker->net->th, step, worker->timestamp_store);
-	if (!insert_rete_alpha_fact_single(worker->net, worker->node_subs, worker->tmp_subs, worker->timestamp_store, worker->output, alpha, fact, step, tmp_sub, *(worker->constants)) )
-	  insert_worker_uninserted_queue(worker, fact, alpha, step);
-      }
-    }
-    __sync_lock_test_and_set(& worker->state, waiting);
-    if(!worker->pause_signalled && !worker->stop_signalled){
+    if(__atomic_load_n(worker->cancelled, __ATOMIC_ACQUIRE)){
+      unlock_worker_queue(worker->work, __FILE__, __LINE__);
       lock_queue_single(worker->output, __FILE__, __LINE__);
-      signal_queue_single(worker->output, __FILE__, __LINE__);
+      broadcast_queue_single(worker->output, __FILE__, __LINE__);
       unlock_queue_single(worker->output, __FILE__, __LINE__);
-    } else {
       lock_worker_queue(worker->work, __FILE__, __LINE__);
-      signal_worker_queue(worker->work, __FILE__, __LINE__);
-      unlock_worker_queue(worker->work, __FILE__, __LINE__);
+      break;
     }
+    if(worker->recheck_net){
+      constant_classes classes = get_constant_classes(*(worker->constants), worker->recheck_constants, worker->n_recheck_constants);
+      worker->n_recheck_constants = 0;
+      worker->recheck_net = false;
+      __sync_lock_test_and_set(&worker->state, has_popped);
+      unlock_worker_queue(worker->work, __FILE__, __LINE__);
+#ifdef __DEBUG_RETE_STATE
+      printf("Rechecking relevant parts of rete net for axiom %s.\n", worker->net->th->axioms[worker->axiom_no]->name);
+#endif
+      recheck_beta_node(worker->net, worker->node_subs, worker->tmp_subs, worker->timestamp_store, worker->net->rule_nodes[worker->axiom_no], worker->output, worker->step, *(worker->constants), &classes);
+      worker_reinsert_uninserted(worker, *tmp_sub, &classes);
+      destroy_constant_classes(&classes);
+    } else if(!rete_worker_queue_is_empty(worker->work)){
+      const rete_node* alpha;
+      const clp_atom* fact;
+      unsigned int step;
+      pop_rete_worker_queue(worker->work, &fact, &alpha, &step);
+      __sync_lock_test_and_set(&worker->state, has_popped);
+      worker->step = step;
+      unlock_worker_queue(worker->work, __FILE__, __LINE__);
+      init_substitution(*tmp_sub, worker->net->th, step, worker->timestamp_store);
+      if (!insert_rete_alpha_fact_single(worker->net, worker->node_subs, worker->tmp_subs, worker->timestamp_store, worker->output, alpha, fact, step, *tmp_sub, *(worker->constants)) )
+	insert_worker_uninserted_queue(worker, fact, alpha, step);
+    } else 
+      break;
+    __sync_lock_test_and_set(& worker->state, waiting);
+    lock_worker_queue(worker->work, __FILE__, __LINE__);
   }
-  return NULL;
-}
-
-/**
-   The functions for starting the thread
-   Separated not to make init_rete_worker messy
-**/
-void start_worker_thread(rete_worker* worker){
-  pthread_attr_t attr;
-  int errval;
-  size_t stacksize = 10000;
-  pt_err(pthread_attr_init(&attr), __FILE__, __LINE__, "rete_worker.c: start_worker_thread: attr init");
-  pthread_attr_setstacksize(&attr, stacksize); 
-  errval = pthread_create(& worker->tid, &attr, queue_worker_routine, worker);
-  if(errval != 0){
-    fprintf(stderr,"%s: line %i: start_worker_thread: %s\n", __FILE__, __LINE__, strerror(errval));
-    if(errval == EAGAIN){
-      fprintf(stderr, "Insufficient resources to run all the threads in the rete network. Try increasing the limits on number of processes or on the virtual memory. You can also try limiting the stack memory, by running ulimit -Ss <limit>\n");
-      show_limit(RLIMIT_NPROC, stdout, "Process");
-      show_limit(RLIMIT_STACK, stdout, "Stack");
-    }
+  if(n_popped > 0 && !worker->pause_signalled && !worker->stop_signalled){
+    unlock_worker_queue(worker->work, __FILE__, __LINE__);
+    lock_queue_single(worker->output, __FILE__, __LINE__);
+    signal_queue_single(worker->output, __FILE__, __LINE__);
+    unlock_queue_single(worker->output, __FILE__, __LINE__);
+    lock_worker_queue(worker->work, __FILE__, __LINE__);
   }
-  pt_err(errval, __FILE__, __LINE__, "rete_worker.c: start_worker_thread: create thread");
-  pt_err(pthread_attr_destroy(&attr), __FILE__, __LINE__, "rete_worker.c: start_worker_thread: attr init");
+  reschedule = !worker->pause_signalled && !worker->stop_signalled && !__atomic_load_n(worker->cancelled, __ATOMIC_ACQUIRE)
+    && (worker->recheck_net || !rete_worker_queue_is_empty(worker->work));
+  if(!reschedule)
+    worker->scheduled = false;
+  broadcast_worker_queue(worker->work, __FILE__, __LINE__);
+  unlock_worker_queue(worker->work, __FILE__, __LINE__);
+  return reschedule;
 }
-/**
-   Creates the initial queue containing
-   all facts from the theory
 
-   Also allocates memory for the qeue
+/**
+   Creates the worker for an axiom. 
+   The worker is run by the threads in pool
  **/
-rete_worker* init_rete_worker(const rete_net* net, unsigned int axiom_no, substitution_store_mt * tmp_subs, substitution_store_array * node_subs, timestamp_store* timestamp_store, rule_queue_single * output, rete_worker_queue * work, constants** cs){
+rete_worker* init_rete_worker(const rete_net* net, unsigned int axiom_no, substitution_store_mt * tmp_subs, substitution_store_array * node_subs, timestamp_store* timestamp_store, rule_queue_single * output, rete_worker_queue * work, constants** cs, rete_worker_pool* pool, const bool* cancelled){
   rete_worker * worker = (rete_worker *) malloc_tester(sizeof(rete_worker));
+  worker->pool = pool;
   worker->work = work;
   worker->output = output;
   worker->state = waiting;
   worker->stop_signalled = false;
   worker->pause_signalled = false;
+  worker->cancelled = cancelled;
+  worker->scheduled = false;
   worker->net = net;
   worker->tmp_subs = tmp_subs;
   worker->node_subs = node_subs;
@@ -217,29 +227,48 @@ rete_worker* init_rete_worker(const rete_net* net, unsigned int axiom_no, substi
   worker->axiom_no = axiom_no;
   worker->constants = cs;
   worker->recheck_net = false;
+  worker->recheck_constants = NULL;
+  worker->n_recheck_constants = 0;
+  worker->size_recheck_constants = 0;
+  worker->uses_equality = rete_node_uses_equality(net->rule_nodes[axiom_no]);
+  worker->step = 0;
   worker->uninserted = init_rete_worker_queue();
-  start_worker_thread(worker);
+  return worker;
+}
+
+/**
+   Creates a worker for the same axiom as orig, working on the given copies of the 
+   node caches and queues. Called when the rete state is split, while orig is paused. 
+   The facts not yet inserted and the pending rechecks of the net are copied.
+   The copy is not scheduled before continue_rete_worker or notify_rete_worker is called.
+**/
+rete_worker* copy_rete_worker(const rete_worker* orig, substitution_store_mt * tmp_subs, substitution_store_array * node_subs, timestamp_store* timestamp_store, rule_queue_single * output, rete_worker_queue * work, constants** cs){
+  rete_worker * worker = init_rete_worker(orig->net, orig->axiom_no, tmp_subs, node_subs, timestamp_store, output, work, cs, orig->pool, orig->cancelled);
+  destroy_rete_worker_queue(worker->uninserted);
+  worker->uninserted = copy_rete_worker_queue(orig->uninserted);
+  worker->step = orig->step;
+  worker->recheck_net = orig->recheck_net;
+  worker->n_recheck_constants = orig->n_recheck_constants;
+  worker->size_recheck_constants = orig->size_recheck_constants;
+  if(orig->size_recheck_constants > 0){
+    worker->recheck_constants = malloc_tester(worker->size_recheck_constants * sizeof(unsigned int));
+    memcpy(worker->recheck_constants, orig->recheck_constants, orig->n_recheck_constants * sizeof(unsigned int));
+  }
   return worker;
 }
 
 /**
    This is the only function that writes to the
    componend stop_signalled
-   Called from rete_state_single when destroying the state
+   Called from rete_state_single when destroying the state. 
+   Waits until no thread in the pool runs or has scheduled the worker.
 **/
 void stop_rete_worker(rete_worker* worker){
-  void* t_retval;
-  int join_rv;
-  if(!worker->stop_signalled){
-    worker->stop_signalled = true;
-    lock_worker_queue(worker->work, __FILE__, __LINE__);
-    signal_worker_queue(worker->work, __FILE__, __LINE__);
-    unlock_worker_queue(worker->work, __FILE__, __LINE__);
-    
-    join_rv = pthread_join(worker->tid, &t_retval);
-    if(join_rv != 0)
-      perror("rete_worker.c: stop_rete_worker: Error when joining with worker thread:"); 
-  }
+  lock_worker_queue(worker->work, __FILE__, __LINE__);
+  worker->stop_signalled = true;
+  while(worker->scheduled)
+    wait_worker_queue(worker->work, __FILE__, __LINE__);
+  unlock_worker_queue(worker->work, __FILE__, __LINE__);
 }
 
 /**
@@ -249,17 +278,6 @@ void stop_rete_worker(rete_worker* worker){
 void pause_rete_worker(rete_worker* worker){
   bool already_paused = __sync_lock_test_and_set(&worker->pause_signalled, true);
   assert(!already_paused);
-  lock_worker_queue(worker->work, __FILE__, __LINE__);
-  signal_worker_queue(worker->work, __FILE__, __LINE__);
-  unlock_worker_queue(worker->work, __FILE__, __LINE__);
-}
-
-/**
-   Called after restoring a backup
-**/
-void restart_rete_worker(rete_worker* rq){
-  rq->stop_signalled = false;
-  start_worker_thread(rq);
 }
 
 /**
@@ -269,7 +287,7 @@ void continue_rete_worker(rete_worker* worker){
   bool was_paused = __sync_lock_test_and_set(&worker->pause_signalled, false);
   assert(was_paused);
   lock_worker_queue(worker->work, __FILE__, __LINE__);
-  signal_worker_queue(worker->work, __FILE__, __LINE__);
+  schedule_rete_worker(worker);
   unlock_worker_queue(worker->work, __FILE__, __LINE__);
 }
 
@@ -279,6 +297,9 @@ void continue_rete_worker(rete_worker* worker){
 **/
 void destroy_rete_worker(rete_worker* rq){
   stop_rete_worker(rq);
+  destroy_rete_worker_queue(rq->uninserted);
+  if(rq->recheck_constants != NULL)
+    free(rq->recheck_constants);
   free(rq);
 }
 
@@ -28,28 +28,46 @@
 #include "substitution_store_mt.h"
 #include "theory.h"
 #include "rete_net.h"
+#include "rete_worker_pool.h"
 #ifdef HAVE_PTHREAD
 #include "pthread.h"
 
 /**
    Represents the "worker" that takes care of inserting into the
    part of the rete network coresponding to a single rule. 
-   This should run in a separate thread. 
-   It is started by rete_state_single.
-   It "sleeps" while the rete_worker_queue is empty, pops from this
-   and eventually inserts into the rule_queue_single.
+   It is created by rete_state_single, and run by one of the threads in the rete_worker_pool.
+   It is scheduled on the pool when the rete_worker_queue gets elements, 
+   pops from this and eventually inserts into the rule_queue_single.
+   scheduled is true from the worker is pushed on the pool until a thread
+   has finished running it. It is protected by the lock of the worker queue,
+   and ensures that at most one thread runs the worker at a time.
    The latter is popped by the prover, and the worker queue is pushed
    in rete_insert_single.c
 
    The pointers must be double, because both the queues are realloced as a whole (and therefore invalidated.)
 
+   recheck_constants are the ids of constants in new equalities since the last recheck of the net. 
+   Only the substitutions and uninserted facts with constants in the equivalence classes 
+   of these are reinserted when the worker rechecks the net. They are protected by the lock of the worker queue.
+
+   uses_equality is false if the rete nodes of the axiom cannot be affected by equalities,
+   see rete_node_uses_equality in rete.c. Such workers are not paused or rechecked on new equalities.
+
    work and output are pointers to single elements (not arrays)
+   cancelled points to the flag set by cancel_rete_state in rete_state_single.c when the proof search is over. 
+   The worker then stops inserting, and the prover waiting on the output queue is signalled.
 **/
 
 enum worker_state { working, waiting, has_popped };
 
+/**
+   The maximal number of elements popped from the worker queue before
+   the thread lets other workers run
+**/
+#define RETE_WORKER_BATCH_SIZE 64
+
 typedef struct rete_worker_t {
-  pthread_t tid;
+  rete_worker_pool * pool;
   substitution_store_array * node_subs;
   substitution_store_mt * tmp_subs;
   timestamp_store* timestamp_store;
@@ -62,22 +80,29 @@ typedef struct rete_worker_t {
   unsigned int axiom_no;
   bool working;
   bool recheck_net;
+  unsigned int * recheck_constants;
+  unsigned int n_recheck_constants;
+  unsigned int size_recheck_constants;
+  bool uses_equality;
+  bool scheduled;
   enum worker_state state;
   bool pause_signalled;
   bool stop_signalled;
+  const bool * cancelled;
 } rete_worker;
 
-rete_worker* init_rete_worker(const rete_net*, unsigned int, substitution_store_mt *, substitution_store_array *, timestamp_store*, rule_queue_single *, rete_worker_queue *, constants**);
+rete_worker* init_rete_worker(const rete_net*, unsigned int, substitution_store_mt *, substitution_store_array *, timestamp_store*, rule_queue_single *, rete_worker_queue *, constants**, rete_worker_pool*, const bool*);
+rete_worker* copy_rete_worker(const rete_worker*, substitution_store_mt *, substitution_store_array *, timestamp_store*, rule_queue_single *, rete_worker_queue *, constants**);
 void destroy_rete_worker(rete_worker*);
 void stop_rete_worker(rete_worker*);
-void restart_rete_worker(rete_worker*);
+bool run_rete_worker(rete_worker*, substitution**);
+void notify_rete_worker(rete_worker*);
 void pause_rete_worker(rete_worker*);
 void continue_rete_worker(rete_worker*);
 bool rete_worker_is_working(rete_worker*);
 unsigned int get_worker_step(rete_worker*);
 void wait_for_worker_to_pause(rete_worker*);
 bool worker_may_have_new_instance(rete_worker*);
-bool read_recheck_net(rete_worker*);
-void set_recheck_net(rete_worker*);
+void set_recheck_net(rete_worker*, dom_elem, dom_elem);
 #endif
 #endif
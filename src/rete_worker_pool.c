@@ -0,0 +1,257 @@
+/* rete_worker_pool.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   The thread pool running the rete workers. See rete_worker_pool.h
+**/
+#include "common.h"
+#include "rete_worker_pool.h"
+#include "rete_worker.h"
+#include "substitution.h"
+#include "error_handling.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+/**
+   The pool thread running in the current thread, if any. 
+   Used to push workers on the deque of the current thread
+**/
+static __thread rete_pool_thread* current_pool_thread = NULL;
+
+/**
+   The number of online processors, used when the 
+   number of threads is not given on the command line
+**/
+unsigned int default_rete_worker_pool_size(void){
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(n_cpus < 1)
+    return 1;
+  return n_cpus;
+}
+
+void init_mutex_rete_worker_pool(pthread_mutex_t* lock){
+  pthread_mutexattr_t mutex_attr;
+  pt_err(pthread_mutexattr_init(&mutex_attr),__FILE__, __LINE__, "rete_worker_pool.c: init_mutex_rete_worker_pool: mutex attr init");
+#ifndef NDEBUG
+  pt_err(pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK_NP), __FILE__, __LINE__,  "rete_worker_pool.c: init_mutex_rete_worker_pool: mutex attr settype");
+#endif
+  pt_err(pthread_mutex_init(lock, & mutex_attr), __FILE__, __LINE__,   "rete_worker_pool.c: init_mutex_rete_worker_pool: mutex init");
+  pt_err(pthread_mutexattr_destroy(&mutex_attr), __FILE__, __LINE__,   "rete_worker_pool.c: init_mutex_rete_worker_pool: mutexattr destroy");
+}
+
+/**
+   Deque functions. The owner thread pops from the front, 
+   which gives a round-robin order over the scheduled workers,
+   while other threads steal from the end.
+**/
+void init_rete_worker_deque(rete_worker_deque* d){
+  init_mutex_rete_worker_pool(& d->lock);
+  d->size_deque = RETE_WORKER_DEQUE_INIT_SIZE;
+  d->workers = calloc_tester(d->size_deque, sizeof(struct rete_worker_t*));
+  d->first = 0;
+  d->end = 0;
+}
+
+void destroy_rete_worker_deque(rete_worker_deque* d){
+  pt_err(pthread_mutex_destroy(& d->lock), __FILE__, __LINE__, "rete_worker_pool.c: destroy_rete_worker_deque: mutex destroy");
+  free(d->workers);
+}
+
+void push_rete_worker_deque(rete_worker_deque* d, struct rete_worker_t* worker){
+  pt_err(pthread_mutex_lock(& d->lock), __FILE__, __LINE__, "rete_worker_pool.c: push_rete_worker_deque: mutex lock");
+  if(d->end >= d->size_deque){
+    if(d->first > 0){
+      memmove(d->workers, d->workers + d->first, (d->end - d->first) * sizeof(struct rete_worker_t*));
+      d->end -= d->first;
+      d->first = 0;
+    } else {
+      d->size_deque *= 2;
+      d->workers = realloc_tester(d->workers, d->size_deque * sizeof(struct rete_worker_t*));
+    }
+  }
+  d->workers[d->end] = worker;
+  d->end++;
+  pt_err(pthread_mutex_unlock(& d->lock), __FILE__, __LINE__, "rete_worker_pool.c: push_rete_worker_deque: mutex unlock");
+}
+
+/**
+   Returns NULL if the deque is empty
+**/
+struct rete_worker_t* pop_rete_worker_deque(rete_worker_deque* d, bool steal){
+  struct rete_worker_t* worker = NULL;
+  pt_err(pthread_mutex_lock(& d->lock), __FILE__, __LINE__, "rete_worker_pool.c: pop_rete_worker_deque: mutex lock");
+  if(d->first < d->end){
+    if(steal){
+      d->end--;
+      worker = d->workers[d->end];
+    } else {
+      worker = d->workers[d->first];
+      d->first++;
+    }
+    if(d->first == d->end){
+      d->first = 0;
+      d->end = 0;
+    }
+  }
+  pt_err(pthread_mutex_unlock(& d->lock), __FILE__, __LINE__, "rete_worker_pool.c: pop_rete_worker_deque: mutex unlock");
+  return worker;
+}
+
+/**
+   Called by a thread that has claimed one of the n_ready workers. 
+   There is therefore always some worker in one of the deques, but 
+   it may have been stolen from the own deque, so the loop may have to run more than once.
+**/
+struct rete_worker_t* take_rete_worker_pool(rete_worker_pool* pool, unsigned int thread_no){
+  struct rete_worker_t* worker = pop_rete_worker_deque(& pool->deques[thread_no], false);
+  unsigned int i;
+  while(worker == NULL){
+    for(i = 1; i <= pool->n_threads && worker == NULL; i++)
+      worker = pop_rete_worker_deque(& pool->deques[(thread_no + i) % pool->n_threads], true);
+  }
+  return worker;
+}
+
+/**
+   The main routine of the pool threads. 
+   Sleeps while no worker is scheduled, and exits when the pool is stopped
+   and all scheduled workers have run.
+**/
+void * rete_pool_thread_routine(void* arg){
+  rete_pool_thread* thread = arg;
+  rete_worker_pool* pool = thread->pool;
+  current_pool_thread = thread;
+  while(true){
+    struct rete_worker_t* worker;
+    pt_err(pthread_mutex_lock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: rete_pool_thread_routine: mutex lock");
+    while(pool->n_ready == 0 && !pool->stop_signalled)
+      pt_err(pthread_cond_wait(& pool->cond, & pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: rete_pool_thread_routine: cond wait");
+    if(pool->n_ready == 0){
+      pt_err(pthread_mutex_unlock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: rete_pool_thread_routine: mutex unlock");
+      break;
+    }
+    pool->n_ready--;
+    pt_err(pthread_mutex_unlock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: rete_pool_thread_routine: mutex unlock");
+    worker = take_rete_worker_pool(pool, thread->thread_no);
+    if(run_rete_worker(worker, & thread->tmp_sub))
+      push_rete_worker_pool(pool, worker);
+  }
+  current_pool_thread = NULL;
+  return NULL;
+}
+
+void start_rete_pool_thread(rete_pool_thread* thread){
+  int errval = pthread_create(& thread->tid, NULL, rete_pool_thread_routine, thread);
+  if(errval != 0){
+    fprintf(stderr,"%s: line %i: start_rete_pool_thread: %s\n", __FILE__, __LINE__, strerror(errval));
+    if(errval == EAGAIN){
+      fprintf(stderr, "Insufficient resources to run the threads in the rete network. Try a smaller number of threads, or increasing the limits on number of processes or on the virtual memory.\n");
+      show_limit(RLIMIT_NPROC, stdout, "Process");
+      show_limit(RLIMIT_STACK, stdout, "Stack");
+    }
+  }
+  pt_err(errval, __FILE__, __LINE__, "rete_worker_pool.c: start_rete_pool_thread: create thread");
+}
+
+/**
+   Creates the pool and starts the threads. 
+   If n_threads is 0, the number of online processors is used.
+**/
+rete_worker_pool* init_rete_worker_pool(unsigned int n_threads){
+  unsigned int i;
+  rete_worker_pool* pool = malloc_tester(sizeof(rete_worker_pool));
+  if(n_threads == 0)
+    n_threads = default_rete_worker_pool_size();
+  init_mutex_rete_worker_pool(& pool->lock);
+  pt_err(pthread_cond_init(& pool->cond, NULL), __FILE__, __LINE__, "rete_worker_pool.c: init_rete_worker_pool: cond init");
+  pool->n_threads = n_threads;
+  pool->n_ready = 0;
+  pool->next_deque = 0;
+  pool->stop_signalled = false;
+  pool->deques = calloc_tester(n_threads, sizeof(rete_worker_deque));
+  pool->threads = calloc_tester(n_threads, sizeof(rete_pool_thread));
+  for(i = 0; i < n_threads; i++){
+    init_rete_worker_deque(& pool->deques[i]);
+    pool->threads[i].thread_no = i;
+    pool->threads[i].pool = pool;
+    pool->threads[i].tmp_sub = NULL;
+  }
+  for(i = 0; i < n_threads; i++)
+    start_rete_pool_thread(& pool->threads[i]);
+  return pool;
+}
+
+/**
+   Schedules a worker. Called from rete_worker.c. 
+   From a pool thread, the worker is put on the deque of this thread, 
+   otherwise the deques are used in turn.
+**/
+void push_rete_worker_pool(rete_worker_pool* pool, struct rete_worker_t* worker){
+  unsigned int deque_no;
+  if(current_pool_thread != NULL && current_pool_thread->pool == pool)
+    deque_no = current_pool_thread->thread_no;
+  else
+    deque_no = __sync_fetch_and_add(& pool->next_deque, 1) % pool->n_threads;
+  push_rete_worker_deque(& pool->deques[deque_no], worker);
+  pt_err(pthread_mutex_lock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: push_rete_worker_pool: mutex lock");
+  pool->n_ready++;
+  pt_err(pthread_cond_signal(& pool->cond), __FILE__, __LINE__, "rete_worker_pool.c: push_rete_worker_pool: cond signal");
+  pt_err(pthread_mutex_unlock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: push_rete_worker_pool: mutex unlock");
+}
+
+/**
+   Joins all the threads. The workers must be stopped first, 
+   such that no worker is scheduled after this
+**/
+void stop_rete_worker_pool(rete_worker_pool* pool){
+  unsigned int i;
+  if(pool->stop_signalled)
+    return;
+  pt_err(pthread_mutex_lock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: stop_rete_worker_pool: mutex lock");
+  pool->stop_signalled = true;
+  pt_err(pthread_cond_broadcast(& pool->cond), __FILE__, __LINE__, "rete_worker_pool.c: stop_rete_worker_pool: cond broadcast");
+  pt_err(pthread_mutex_unlock(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: stop_rete_worker_pool: mutex unlock");
+  for(i = 0; i < pool->n_threads; i++){
+    void* t_retval;
+    if(pthread_join(pool->threads[i].tid, &t_retval) != 0)
+      perror("rete_worker_pool.c: stop_rete_worker_pool: Error when joining with pool thread:"); 
+  }
+}
+
+void destroy_rete_worker_pool(rete_worker_pool* pool){
+  unsigned int i;
+  stop_rete_worker_pool(pool);
+  for(i = 0; i < pool->n_threads; i++){
+    destroy_rete_worker_deque(& pool->deques[i]);
+    if(pool->threads[i].tmp_sub != NULL)
+      free_substitution(pool->threads[i].tmp_sub);
+  }
+  pt_err(pthread_mutex_destroy(& pool->lock), __FILE__, __LINE__, "rete_worker_pool.c: destroy_rete_worker_pool: mutex destroy");
+  pt_err(pthread_cond_destroy(& pool->cond), __FILE__, __LINE__, "rete_worker_pool.c: destroy_rete_worker_pool: cond destroy");
+  free(pool->deques);
+  free(pool->threads);
+  free(pool);
+}
+
+#endif
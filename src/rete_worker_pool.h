@@ -0,0 +1,78 @@
+/* rete_worker_pool.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_RETE_WORKER_POOL_H
+#define __INCLUDED_RETE_WORKER_POOL_H
+
+#include "common.h"
+#include "substitution_struct.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+/**
+   A fixed number of threads running the rete workers.
+
+   There is one rete_worker per axiom, but a worker only occupies a thread
+   while it has work. A worker with work is "scheduled" by pushing it
+   on one of the deques. Each thread takes workers from the front 
+   of its own deque, and steals from the end of the other deques when its own is empty.
+   
+   n_ready is the number of workers in all the deques together, 
+   and is protected by lock. The deques have their own locks.
+**/
+struct rete_worker_t;
+
+#define RETE_WORKER_DEQUE_INIT_SIZE 16
+
+typedef struct rete_worker_deque_t {
+  pthread_mutex_t lock;
+  struct rete_worker_t ** workers;
+  unsigned int size_deque;
+  unsigned int first;
+  unsigned int end;
+} rete_worker_deque;
+
+struct rete_worker_pool_t;
+
+typedef struct rete_pool_thread_t {
+  pthread_t tid;
+  unsigned int thread_no;
+  struct rete_worker_pool_t * pool;
+  substitution* tmp_sub;
+} rete_pool_thread;
+
+typedef struct rete_worker_pool_t {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  unsigned int n_threads;
+  unsigned int n_ready;
+  unsigned int next_deque;
+  bool stop_signalled;
+  rete_pool_thread * threads;
+  rete_worker_deque * deques;
+} rete_worker_pool;
+
+unsigned int default_rete_worker_pool_size(void);
+rete_worker_pool* init_rete_worker_pool(unsigned int);
+void push_rete_worker_pool(rete_worker_pool*, struct rete_worker_t*);
+void stop_rete_worker_pool(rete_worker_pool*);
+void destroy_rete_worker_pool(rete_worker_pool*);
+#endif
+#endif
@@ -23,6 +23,7 @@
 #include "rete.h"
 #include "rete_worker_queue.h"
 #include "error_handling.h"
+#include "undo_trail.h"
 
 
 #ifdef HAVE_PTHREAD
@@ -93,6 +94,8 @@ rete_worker_queue* init_rete_worker_queue(void){
 #endif
   rq->first = 0;
   rq->end = 0;
+  rq->trail = NULL;
+  rq->trail_generation = 0;
 
 #ifdef HAVE_PTHREAD
   pt_err(pthread_mutexattr_init(&mutex_attr),__FILE__, __LINE__, "rete_worker_queue.c: initialize_queue_single: mutex attr init");
@@ -124,6 +127,20 @@ const worker_queue_elem* get_const_worker_queue_elem(const rete_worker_queue* rq
 
 
 
+/**
+   Returns a copy of the queue, used when the rete state is split in rete_state_single.c.
+   The queue must not be changed while copied. The copy is not on any undo trail.
+**/
+rete_worker_queue* copy_rete_worker_queue(const rete_worker_queue* orig){
+  rete_worker_queue* rq = init_rete_worker_queue();
+  rq->size_queue = orig->size_queue;
+  rq->queue = realloc_tester(rq->queue, rq->size_queue * sizeof(worker_queue_elem));
+  memcpy(rq->queue, orig->queue, orig->end * sizeof(worker_queue_elem));
+  rq->first = orig->first;
+  rq->end = orig->end;
+  return rq;
+}
+
 /**
    Frees memory allocated for the rule queue
 **/
@@ -157,6 +174,8 @@ void push_rete_worker_queue(rete_worker_queue * rq, const clp_atom* fact, const
 #ifdef HAVE_PTHREAD
   lock_worker_queue(rq, __FILE__, __LINE__ );
 #endif
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_worker_queue_undo_trail(rq->trail, rq);
   check_worker_queue_too_small(rq);
   pos = rq->end;
   rq->end ++;
@@ -167,6 +186,32 @@ void push_rete_worker_queue(rete_worker_queue * rq, const clp_atom* fact, const
 #endif
 }
 
+/**
+   Appends all elements of the batch to the queue, and empties the batch.
+   The queue is locked, grown and signalled only once
+**/
+void push_rete_worker_queue_batch(rete_worker_queue * rq, worker_queue_batch* batch){
+  if(batch->n_elems == 0)
+    return;
+#ifdef HAVE_PTHREAD
+  lock_worker_queue(rq, __FILE__, __LINE__ );
+#endif
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_worker_queue_undo_trail(rq->trail, rq);
+  if(rq->end + batch->n_elems >= rq->size_queue){
+    while(rq->end + batch->n_elems >= rq->size_queue)
+      rq->size_queue *= 2;
+    resize_worker_queue(rq);
+  }
+  memcpy(& rq->queue[rq->end], batch->elems, batch->n_elems * sizeof(worker_queue_elem));
+  rq->end += batch->n_elems;
+  batch->n_elems = 0;
+#ifdef HAVE_PTHREAD
+  signal_worker_queue(rq, __FILE__, __LINE__ );
+  unlock_worker_queue(rq, __FILE__, __LINE__ );
+#endif
+}
+
 unsigned int get_timestamp_rete_worker_queue(rete_worker_queue* rq){
   assert(!rete_worker_queue_is_empty(rq));
   return rq->queue[rq->first].step;
@@ -190,6 +235,8 @@ void  pop_rete_worker_queue(rete_worker_queue* rq, const clp_atom** fact, const
   *alpha = el->alpha;
   *step = el->step;
   assert(rq->end > rq->first);
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_worker_queue_undo_trail(rq->trail, rq);
   __sync_add_and_fetch(& rq->first, 1);
 }
 
@@ -199,6 +246,8 @@ void  pop_rete_worker_queue(rete_worker_queue* rq, const clp_atom** fact, const
 **/
 void unpop_rete_worker_queue(rete_worker_queue* rq){
   assert(rq->first > 0);
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_worker_queue_undo_trail(rq->trail, rq);
   rq->first--;
 }
 
@@ -218,6 +267,35 @@ rete_worker_queue* restore_rete_worker_queue(rete_worker_queue* rq, rete_worker_
 
 
 
+/**
+   Batches of elements collected before pushing them on a queue
+**/
+void init_worker_queue_batch(worker_queue_batch* batch){
+  batch->size_elems = WORKER_QUEUE_INIT_SIZE;
+  batch->n_elems = 0;
+  batch->elems = calloc_tester(batch->size_elems, sizeof(worker_queue_elem));
+}
+
+void destroy_worker_queue_batch(worker_queue_batch* batch){
+  free(batch->elems);
+}
+
+void add_worker_queue_batch(worker_queue_batch* batch, const clp_atom* fact, const rete_node* alpha, unsigned int step){
+  worker_queue_elem* el;
+  if(batch->n_elems >= batch->size_elems){
+    batch->size_elems *= 2;
+    batch->elems = realloc_tester(batch->elems, get_worker_queue_size_t(batch->size_elems));
+  }
+  el = & batch->elems[batch->n_elems++];
+  el->fact = fact;
+  el->alpha = alpha;
+  el->step = step;
+}
+
+bool worker_queue_batch_is_empty(const worker_queue_batch* batch){
+  return batch->n_elems == 0;
+}
+
 /**
    Printing
 **/
@@ -30,6 +30,8 @@
 
 #define WORKER_QUEUE_INIT_SIZE 10
 
+struct undo_trail_t;
+
 typedef struct worker_queue_elem_t {
   unsigned int step;
   const clp_atom* fact;
@@ -43,6 +45,9 @@ typedef struct worker_queue_elem_t {
    They are pushed by the prover and popped by the worker thread
 
    recheck_net is set to true by the prover whenever a new equality is encountered
+
+   trail is NULL, except for the worker queues of the axioms in the rete state, see undo_trail.h. 
+   They are pushed on the trail with the queue locked.
 **/
 typedef struct rete_worker_queue_t {
 #ifdef HAVE_PTHREAD
@@ -53,9 +58,22 @@ typedef struct rete_worker_queue_t {
   size_t size_queue;
   size_t first;
   size_t end;
+  struct undo_trail_t* trail;
+  unsigned long trail_generation;
 } rete_worker_queue;
 
 
+/**
+   Elements collected by the prover before they are pushed on a worker queue 
+   with push_rete_worker_queue_batch. Only used by the thread owning it, 
+   and therefore not locked
+**/
+typedef struct worker_queue_batch_t {
+  worker_queue_elem * elems;
+  size_t n_elems;
+  size_t size_elems;
+} worker_queue_batch;
+
 typedef struct rete_worker_queue_backup_t {
   unsigned int first;
   unsigned int end;
@@ -64,9 +82,11 @@ typedef struct rete_worker_queue_backup_t {
 
 rete_worker_queue* init_rete_worker_queue(void);
 void destroy_rete_worker_queue(rete_worker_queue*);
+rete_worker_queue* copy_rete_worker_queue(const rete_worker_queue*);
 
 
 void push_rete_worker_queue(rete_worker_queue*, const clp_atom*, const rete_node*, unsigned int); 
+void push_rete_worker_queue_batch(rete_worker_queue*, worker_queue_batch*);
 void pop_rete_worker_queue(rete_worker_queue*, const clp_atom**, const rete_node**, unsigned int*);
 unsigned int get_timestamp_rete_worker_queue(rete_worker_queue*);
 void unpop_rete_worker_queue(rete_worker_queue*);
@@ -83,6 +103,11 @@ rete_worker_queue_backup backup_rete_worker_queue(rete_worker_queue*);
 rete_worker_queue* restore_rete_worker_queue(rete_worker_queue*, rete_worker_queue_backup*);
 
 bool rete_worker_queue_is_empty(rete_worker_queue*);
+
+void init_worker_queue_batch(worker_queue_batch*);
+void destroy_worker_queue_batch(worker_queue_batch*);
+void add_worker_queue_batch(worker_queue_batch*, const clp_atom*, const rete_node*, unsigned int);
+bool worker_queue_batch_is_empty(const worker_queue_batch*);
 unsigned int get_rete_worker_queue_size(const rete_worker_queue*);
 
 void print_rete_worker_queue(rete_worker_queue*, const constants*, FILE*);
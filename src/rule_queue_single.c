@@ -27,6 +27,7 @@
 #include "substitution.h"
 #include "error_handling.h"
 #include "logger.h"
+#include "undo_trail.h"
 #include <sys/time.h>
 #include <errno.h>
 
@@ -100,7 +101,7 @@ void check_rq_too_small(rule_queue_single* rq){
 
    The axiom_no is only for debugging purposes
  **/
-rule_queue_single* initialize_queue_single(substitution_size_info ssi, unsigned int axiom_no, bool permanent, bool multi_rule_queue){
+rule_queue_single* initialize_queue_single(substitution_size_info ssi, unsigned int axiom_no, bool permanent, bool multi_rule_queue, bool sorted){
   rule_queue_single* rq = malloc_tester(sizeof(rule_queue_single));
   rq->size_queue = RULE_QUEUE_INIT_SIZE;
   rq->queue = malloc_tester(get_rq_size_t(rq->size_queue, ssi));
@@ -115,6 +116,21 @@ rule_queue_single* initialize_queue_single(substitution_size_info ssi, unsigned
   rq->n_appl = 0;
   rq->axiom_no = axiom_no;
   rq->permanent = permanent;
+  rq->sorted = sorted;
+  rq->trail = NULL;
+  rq->trail_generation = 0;
+  rq->n_heap = 0;
+  if(sorted){
+    rq->size_heap = RULE_QUEUE_INIT_SIZE;
+    rq->heap = calloc_tester(rq->size_heap, sizeof(unsigned int));
+    rq->size_popped = RULE_QUEUE_INIT_SIZE;
+    rq->popped = calloc_tester(rq->size_popped, sizeof(unsigned int));
+  } else {
+    rq->size_heap = 0;
+    rq->heap = NULL;
+    rq->size_popped = 0;
+    rq->popped = NULL;
+  }
 #ifdef HAVE_PTHREAD
   pt_err(pthread_mutexattr_init(&mutex_attr), __FILE__, __LINE__,  " initialize_queue_single: mutex attr init");
 #ifndef NDEBUG
@@ -133,6 +149,8 @@ unsigned int get_rule_queue_single_pos(const rule_queue_single* rq, unsigned int
 
 
 unsigned int get_rule_queue_single_size(const rule_queue_single* rq){
+  if(rq->sorted)
+    return rq->n_heap;
   return rq->end - rq->first;
 }
 
@@ -150,6 +168,33 @@ const rule_instance* get_const_rule_instance_single(const rule_queue_single* rq,
 
 
 
+/**
+   Returns a copy of the queue, used when the rete state is split in rete_state_single.c.
+   The queue must not be changed while copied. 
+   The rule instances are copied as they are, sharing the timestamp blocks with the original.
+   The copy is not on any undo trail.
+**/
+rule_queue_single* copy_rule_queue_single(const rule_queue_single* orig){
+  rule_queue_single* rq = initialize_queue_single(orig->ssi, orig->axiom_no, orig->permanent, orig->multi_rule_queue, orig->sorted);
+  rq->size_queue = orig->size_queue;
+  rq->queue = realloc_tester(rq->queue, get_rq_size_t(rq->size_queue, rq->ssi));
+  memcpy(rq->queue, orig->queue, get_rq_size_t(orig->end, orig->ssi));
+  rq->first = orig->first;
+  rq->end = orig->end;
+  rq->previous_appl = orig->previous_appl;
+  rq->n_appl = orig->n_appl;
+  if(orig->sorted){
+    rq->size_heap = orig->size_heap;
+    rq->heap = realloc_tester(rq->heap, rq->size_heap * sizeof(unsigned int));
+    memcpy(rq->heap, orig->heap, orig->n_heap * sizeof(unsigned int));
+    rq->n_heap = orig->n_heap;
+    rq->size_popped = orig->size_popped;
+    rq->popped = realloc_tester(rq->popped, rq->size_popped * sizeof(unsigned int));
+    memcpy(rq->popped, orig->popped, orig->size_popped * sizeof(unsigned int));
+  }
+  return rq;
+}
+
 /**
    Frees memory allocated for the rule queue
 **/
@@ -159,9 +204,67 @@ void destroy_rule_queue_single(rule_queue_single* rq){
   pt_err( pthread_cond_destroy(&rq->queue_cond), __FILE__, __LINE__,   "destroy_rule_queue_single: cond destroy");  
 #endif
   free(rq->queue);
+  free(rq->heap);
+  free(rq->popped);
   free(rq);
 }
 
+/**
+   Heap functions for the sorted queues. 
+   Positions are ordered by the timestamps of the substitutions, and then by the position
+**/
+bool rule_queue_heap_less(rule_queue_single* rq, unsigned int pos1, unsigned int pos2){
+  int cmp = compare_sub_timestamps(& (get_rule_instance_single(rq, pos1))->sub, & (get_rule_instance_single(rq, pos2))->sub);
+  return cmp < 0 || (cmp == 0 && pos1 < pos2);
+}
+
+void sift_up_rule_queue_heap(rule_queue_single* rq, unsigned int i){
+  while(i > 0){
+    unsigned int parent = (i - 1) / 2;
+    unsigned int tmp;
+    if(!rule_queue_heap_less(rq, rq->heap[i], rq->heap[parent]))
+      break;
+    tmp = rq->heap[i];
+    rq->heap[i] = rq->heap[parent];
+    rq->heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+void sift_down_rule_queue_heap(rule_queue_single* rq, unsigned int i){
+  while(2 * i + 1 < rq->n_heap){
+    unsigned int child = 2 * i + 1;
+    unsigned int tmp;
+    if(child + 1 < rq->n_heap && rule_queue_heap_less(rq, rq->heap[child + 1], rq->heap[child]))
+      child++;
+    if(!rule_queue_heap_less(rq, rq->heap[child], rq->heap[i]))
+      break;
+    tmp = rq->heap[i];
+    rq->heap[i] = rq->heap[child];
+    rq->heap[child] = tmp;
+    i = child;
+  }
+}
+
+void push_rule_queue_heap(rule_queue_single* rq, unsigned int pos){
+  if(rq->n_heap >= rq->size_heap){
+    rq->size_heap *= 2;
+    rq->heap = realloc_tester(rq->heap, rq->size_heap * sizeof(unsigned int));
+  }
+  rq->heap[rq->n_heap] = pos;
+  rq->n_heap++;
+  sift_up_rule_queue_heap(rq, rq->n_heap - 1);
+}
+
+unsigned int pop_rule_queue_heap(rule_queue_single* rq){
+  unsigned int top = rq->heap[0];
+  assert(rq->n_heap > 0);
+  rq->n_heap--;
+  rq->heap[0] = rq->heap[rq->n_heap];
+  sift_down_rule_queue_heap(rq, 0);
+  return top;
+}
+
 /**
    Assigns position pos in the rule queue the according values.
 **/
@@ -186,9 +289,10 @@ void assign_rule_queue_instance(rule_queue_single* rq, unsigned int pos, const c
 bool test_rule_queue_single(rule_queue_single* rq, const constants* cs){
   unsigned int i;
   assert(rq->first <= rq->end);
-  for(i = rq->first; i < rq->end; i++){
+  assert(rq->n_heap <= rq->end);
+  for(i = 0; i < get_rule_queue_single_size(rq); i++){
 #ifndef NDEBUG
-    rule_instance* ri = get_rule_instance_single(rq, i);
+    rule_instance* ri = get_rule_instance_single(rq, rq->sorted ? rq->heap[i] : rq->first + i);
 #endif
     if(!rq->multi_rule_queue){
       assert(ri->rule->axiom_no == rq->axiom_no);
@@ -201,8 +305,10 @@ bool test_rule_queue_single(rule_queue_single* rq, const constants* cs){
 /**
    Inserts a copy of the substitution into a new entry in the rule queue.
    The original substitution is not changed
+
+   The entry is always at the end of the array. In a sorted queue, the position is then pushed on the heap
 **/
-rule_instance* push_rule_instance_single(rule_queue_single * rq, const clp_axiom* rule, const substitution* sub, unsigned int step, bool clpl_sorted, timestamp_store* ts_store, const constants* cs){
+rule_instance* push_rule_instance_single(rule_queue_single * rq, const clp_axiom* rule, const substitution* sub, unsigned int step, timestamp_store* ts_store, const constants* cs){
   unsigned int pos;
   assert(test_substitution(sub, cs));
 #ifdef DEBUG_RETE_INSERT
@@ -216,26 +322,14 @@ rule_instance* push_rule_instance_single(rule_queue_single * rq, const clp_axiom
   lock_queue_single(rq, __FILE__, __LINE__);
 #endif
   assert(test_rule_queue_single(rq, cs));
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_rule_queue_undo_trail(rq->trail, rq);
   check_rq_too_small(rq);
-  assert(test_rule_queue_single(rq, cs));
-  if(clpl_sorted){
-    for(pos = rq->end
-	  ; pos > rq->first 
-	  && compare_sub_timestamps(& (get_rule_instance_single(rq, pos-1))->sub, sub) > 0
-	  ; pos--
-	)
-      copy_rule_instance_struct(get_rule_instance_single(rq, pos)
-				, get_rule_instance_single(rq, pos-1)
-				, rq->ssi
-				, ts_store
-				, rq->permanent
-				, cs
-				);
-  } else
-    pos = rq->end;
-  assert(test_rule_queue_single(rq, cs));
+  pos = rq->end;
   __sync_add_and_fetch(& rq->end, 1);
   assign_rule_queue_instance(rq, pos, rule, sub, step, ts_store, cs);
+  if(rq->sorted)
+    push_rule_queue_heap(rq, pos);
   assert(test_rule_queue_single(rq, cs));
 #ifdef HAVE_PTHREAD
   signal_queue_single(rq, __FILE__, __LINE__);
@@ -247,6 +341,8 @@ rule_instance* push_rule_instance_single(rule_queue_single * rq, const clp_axiom
 
 
 bool rule_queue_single_is_empty(rule_queue_single* rq){
+  if(rq->sorted)
+    return rq->n_heap == 0;
   return rq->first == rq->end;
 }
 
@@ -257,8 +353,8 @@ bool rule_queue_single_is_empty(rule_queue_single* rq){
    and the data maybe destroyed on the first backtracking
 **/
 rule_instance* peek_rule_queue_single(rule_queue_single* rq, const constants* cs){
-  assert(rq->first < rq->end);
-  rule_instance* ri = get_rule_instance_single(rq, rq->first);
+  assert(!rule_queue_single_is_empty(rq));
+  rule_instance* ri = get_rule_instance_single(rq, rq->sorted ? rq->heap[0] : rq->first);
   assert(test_rule_instance(ri, cs));
   return ri;
 }
@@ -281,8 +377,18 @@ unsigned int rule_queue_single_age(rule_queue_single* rq, const constants* cs){
 rule_instance* pop_rule_queue_single(rule_queue_single* rq, unsigned int step, const constants* cs){
   rule_instance* ri = peek_rule_queue_single(rq, cs);
   assert(test_rule_instance(ri, cs));
-  assert(rq->end > rq->first);
-  rq->first++;
+  if(needs_undo_trail(rq->trail, rq->trail_generation))
+    push_rule_queue_undo_trail(rq->trail, rq);
+  if(rq->sorted){
+    if(rq->n_appl >= rq->size_popped){
+      rq->size_popped *= 2;
+      rq->popped = realloc_tester(rq->popped, rq->size_popped * sizeof(unsigned int));
+    }
+    rq->popped[rq->n_appl] = pop_rule_queue_heap(rq);
+  } else {
+    assert(rq->end > rq->first);
+    rq->first++;
+  }
   rq->n_appl++;
   rq->previous_appl = step;
   return ri;
@@ -299,7 +405,34 @@ rule_queue_single_backup backup_rule_queue_single(rule_queue_single* rq){
   return backup;
 }
 
+/**
+   In a sorted queue, the heap is rebuilt from the instances in it that were 
+   pushed before the backup, and those popped after the backup.
+**/
+void restore_rule_queue_heap(rule_queue_single* rq, rule_queue_single_backup* backup){
+  unsigned int i, n_kept = 0;
+  assert(backup->n_appl <= rq->n_appl);
+  for(i = 0; i < rq->n_heap; i++){
+    if(rq->heap[i] < backup->end)
+      rq->heap[n_kept++] = rq->heap[i];
+  }
+  rq->n_heap = n_kept;
+  for(i = backup->n_appl; i < rq->n_appl; i++){
+    if(rq->popped[i] < backup->end){
+      if(rq->n_heap >= rq->size_heap){
+	rq->size_heap *= 2;
+	rq->heap = realloc_tester(rq->heap, rq->size_heap * sizeof(unsigned int));
+      }
+      rq->heap[rq->n_heap++] = rq->popped[i];
+    }
+  }
+  for(i = rq->n_heap / 2; i > 0; i--)
+    sift_down_rule_queue_heap(rq, i - 1);
+}
+
 rule_queue_single* restore_rule_queue_single(rule_queue_single* rq, rule_queue_single_backup* backup){
+  if(rq->sorted)
+    restore_rule_queue_heap(rq, backup);
   rq->first = backup->first;
   rq->end = backup->end;
   rq->previous_appl = backup->previous_appl;
@@ -323,7 +456,8 @@ void print_rule_queue_single(rule_queue_single* rq, const constants* cs, FILE* f
   lock_queue_single(rq, __FILE__, __LINE__);
 #endif
   fprintf(f, "queue with %u entries: \n", get_rule_queue_single_size(rq));
-  for(j=0, i = rq->first; i < rq->end; i++, j++){
+  for(j = 0; j < get_rule_queue_single_size(rq); j++){
+    i = rq->sorted ? rq->heap[j] : rq->first + j;
     fprintf(f, "\t%i: ", j);
     print_rule_instance(get_const_rule_instance_single(rq, i), cs, f);
     fprintf(f, "\n");
@@ -28,6 +28,8 @@
 #endif
 
 #define RULE_QUEUE_INIT_SIZE 10
+
+struct undo_trail_t;
 /**
    The queue of rule instances to be treated
    Called "conflict set" by Forgy
@@ -42,6 +44,16 @@
 
    permanent is true for the queue used for the history in rete_state_single. 
    It leads to the timestamps not being freed on backtracking
+
+   If sorted is true (the CL.pl strategy), the instances are popped in the order of 
+   their timestamps (compare_sub_timestamps), and in the order they were pushed when the 
+   timestamps are equal. The instances then stay in the position they were pushed to, 
+   and heap is a binary min-heap of these positions. first is not used. 
+   popped[i] is the position of the instance popped when n_appl was i. This is used 
+   to put back the instances popped after a backup.
+
+   trail is NULL, except for the rule queues of the axioms in the rete state, see undo_trail.h. 
+   They are pushed on the trail with the queue locked.
 **/
 typedef struct rule_queue_single_t {
 #ifdef HAVE_PTHREAD
@@ -58,6 +70,14 @@ typedef struct rule_queue_single_t {
   unsigned int previous_appl;
   unsigned int n_appl;
   substitution_size_info ssi;
+  bool sorted;
+  unsigned int * heap;
+  unsigned int n_heap;
+  unsigned int size_heap;
+  unsigned int * popped;
+  unsigned int size_popped;
+  struct undo_trail_t* trail;
+  unsigned long trail_generation;
 } rule_queue_single;
 
 
@@ -68,10 +88,11 @@ typedef struct rule_queue_single_backup_t {
   unsigned int n_appl;
 } rule_queue_single_backup;
 
-rule_queue_single* initialize_queue_single(substitution_size_info, unsigned int, bool permanent, bool multi_rule_queue);
+rule_queue_single* initialize_queue_single(substitution_size_info, unsigned int, bool permanent, bool multi_rule_queue, bool sorted);
 void destroy_rule_queue_single(rule_queue_single*);
+rule_queue_single* copy_rule_queue_single(const rule_queue_single*);
 
-rule_instance* push_rule_instance_single(rule_queue_single*, const clp_axiom*, const substitution*, unsigned int, bool, timestamp_store*, const constants*);
+rule_instance* push_rule_instance_single(rule_queue_single*, const clp_axiom*, const substitution*, unsigned int, timestamp_store*, const constants*);
 rule_instance* pop_rule_queue_single(rule_queue_single*, unsigned int, const constants*);
 rule_instance* peek_rule_queue_single(rule_queue_single*, const constants*);
 rule_instance* get_rule_instance_single(rule_queue_single*, unsigned int);
@@ -80,6 +101,7 @@ rule_instance* get_rule_instance_single(rule_queue_single*, unsigned int);
 void wait_queue_single(rule_queue_single*, const char*, int);
 bool timedwait_queue_single(rule_queue_single*, unsigned int, const char*, int);
 void signal_queue_single(rule_queue_single*, const char*, int);
+void broadcast_queue_single(rule_queue_single*, const char*, int);
 void lock_queue_single(rule_queue_single*, const char*, int);
 void unlock_queue_single(rule_queue_single*, const char*, int);
 
@@ -34,6 +34,114 @@
 #define  RAND_DIV (RAND_MAX / RAND_RULE_WEIGHT)
 		 
 
+/**
+   See axiom_heap_kind in strategy.h
+**/
+axiom_heap_kind get_axiom_heap_kind(const clp_axiom* rule){
+  if(rule->type == goal || rule->type == fact)
+    return definite_axiom_heap;
+  if(rule->is_existential)
+    return existential_axiom_heap;
+  if(rule->rhs->n_args == 1)
+    return definite_axiom_heap;
+  return splitting_axiom_heap;
+}
+
+unsigned int axiom_weight(const clp_axiom* rule, unsigned int age, unsigned int previous_application){
+  return (age + previous_application + 1) * (rule->rhs->n_args * 10 );
+  //	* (1 + rand() / RAND_DIV);
+#if false
+  return (age + previous_application) 
+    * (rule->lhs->n_args + 1)
+    * (1 + rand() / RAND_DIV);
+#endif
+}
+
+/**
+   The weight of the axiom in its axiom heap, see normal_next_instance. 
+   The definite rules are taken in the order of the theory. Without all_disjuncts, 
+   the splitting rules are taken from the last in the theory, otherwise by their weights, 
+   as the existential rules.
+**/
+unsigned int axiom_heap_weight(rule_queue_state state
+			       , const rete_net* net
+			       , unsigned int axiom_no
+			       , unsigned int (*possible_age)(rule_queue_state, unsigned int)
+			       , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+			       )
+{
+  const clp_axiom* rule = net->th->axioms[axiom_no];
+  switch(get_axiom_heap_kind(rule)){
+  case definite_axiom_heap:
+    return 0;
+  case splitting_axiom_heap:
+    if(!net->treat_all_disjuncts)
+      return net->th->n_axioms - axiom_no;
+    break;
+  default:
+    break;
+  }
+  return axiom_weight(rule, possible_age(state, axiom_no), previous_application(state, axiom_no));
+}
+
+/**
+   Moves the lightest rule that may have new instances to the top of the axiom heap. 
+   The weights in the heap are updated by the rule queue state when instances are pushed and popped, 
+   but the age of the instances still in the rete network changes with the workers. 
+   The weight of the top is therefore recalculated, until it is unchanged.
+**/
+void update_axiom_heap_top(rule_queue_state state
+			   , const rete_net* net
+			   , axiom_heap* heap
+			   , unsigned int (*possible_age)(rule_queue_state, unsigned int)
+			   , bool (*may_have)(rule_queue_state, unsigned int)
+			   , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+			   )
+{
+  while(!axiom_heap_is_empty(heap)){
+    unsigned int top = peek_axiom_heap(heap);
+    unsigned int weight;
+    if(!may_have(state, top)){
+      remove_axiom_heap(heap, top);
+      continue;
+    }
+    weight = axiom_heap_weight(state, net, top, possible_age, previous_application);
+    if(weight == get_axiom_heap_weight(heap, top))
+      return;
+    set_axiom_heap_weight(heap, top, weight);
+  }
+}
+
+/**
+   Tries the rules in the heap from the top, until one has a new instance, which is returned. 
+   The tried rules are taken out of the heap and added to tried_rules. 
+   Returns NULL if no rule in the heap has new instances.
+**/
+rule_instance* next_instance_axiom_heap(rule_queue_state state
+					, const rete_net* net
+					, axiom_heap* heap
+					, unsigned int* tried_rules
+					, unsigned int* n_tried
+					, bool (*has_new_instance)(rule_queue_state, unsigned int)
+					, unsigned int (*possible_age)(rule_queue_state, unsigned int)
+					, bool (*may_have)(rule_queue_state, unsigned int)
+					, rule_instance* (*pop_axiom)(rule_queue_state, unsigned int)
+					, unsigned int (*previous_application)(rule_queue_state, unsigned int)
+					)
+{
+  while(true){
+    unsigned int rule;
+    update_axiom_heap_top(state, net, heap, possible_age, may_have, previous_application);
+    if(axiom_heap_is_empty(heap))
+      return NULL;
+    rule = peek_axiom_heap(heap);
+    remove_axiom_heap(heap, rule);
+    tried_rules[(*n_tried)++] = rule;
+    if(has_new_instance(state, rule))
+      return pop_axiom(state, rule);
+  }
+}
+
 /**
    This is where the strategy is chosen
 
@@ -42,8 +150,14 @@
    Then take any without disjunction or exist. quantifiers, then 
    any without exist. quantifiers.
 
-   If no such rule is in the queue, there is a rotation based on
-   state->next
+   The rules that may have new instances are kept in the axiom heaps of the rule queue state, 
+   one for each kind of rule, see axiom_heap_kind in strategy.h. Finding the next rule is therefore 
+   logarithmic in the number of axioms. 
+
+   With all_disjuncts, the splitting and existential rules are tried in the order of their weights. 
+   The lightest existential rule is always tried, the others only while their weights are below max_weight. 
+   The first axiom is preferred on ties with the lightest existential rule, as when the weights were scanned from axiom 0. 
+   Each rule is tried only once, and the tried rules are put back in their heaps afterwards.
 **/
 rule_instance* normal_next_instance(rule_queue_state state
 					 , const rete_net* net
@@ -56,108 +170,80 @@ rule_instance* normal_next_instance(rule_queue_state state
 					 , rule_instance* (*pop_axiom)(rule_queue_state, unsigned int)
 					 , void (*add_to_queue) (const clp_axiom*, const substitution*, rule_queue_state)
 					 , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+					 , axiom_heap* (*axiom_heaps)(rule_queue_state, axiom_heap_kind)
 					 )
 {
   unsigned int i;
   const theory* th = net->th;
-  bool has_definite = false;
-  bool has_definite_non_splitting = false;
-  bool may_have_next_rule = false;
-  unsigned int definite_non_splitting_rule = th->n_axioms;
-  unsigned int definite_rule = th->n_axioms;
-  unsigned int lightest_rule = 0;
-  unsigned int min_weight = 2 * step_no * (1 + RAND_RULE_WEIGHT);
-  unsigned int axiom_weights[th->n_axioms];
+  axiom_heap* definite = axiom_heaps(state, definite_axiom_heap);
+  axiom_heap* splitting = axiom_heaps(state, splitting_axiom_heap);
+  axiom_heap* existential = axiom_heaps(state, existential_axiom_heap);
+  unsigned int tried_rules[th->n_axioms];
+  unsigned int n_tried = 0;
+  bool try_lightest = true;
+  rule_instance* next;
   unsigned int max_weight = 50 * (step_no + 1) * (1 + RAND_RULE_WEIGHT);
-  for(i = 0; i < net->th->n_axioms; i++){
-    const clp_axiom* rule = th->axioms[i];
-    unsigned int axiom_no = rule->axiom_no;
-    assert(axiom_no == i);
-    if(may_have(state, axiom_no)){
-      unsigned int rule_previously_applied = previous_application(state, i);
-      if( (rule->type == goal || rule->type == fact)){
-	if (has_new_instance(state, axiom_no))
-	  return pop_axiom(state, axiom_no);
-	else {
-	  if(may_have(state, axiom_no))
-	    may_have_next_rule = true;
-	  axiom_weights[axiom_no] = max_weight;
-	  continue;
-	}
-      }
-
-      axiom_weights[axiom_no] = 
-	(possible_age(state, axiom_no) + rule_previously_applied + 1) 
-	* (rule->rhs->n_args * 10 );
-      //	* (1 + rand() / RAND_DIV);
-#if false
-      axiom_weights[axiom_no] = 
-	(possible_age(state, axiom_no) + rule_previously_applied) 
-	* (rule->lhs->n_args + 1)
-	* (1 + rand() / RAND_DIV);
-#endif
-      
-           
-      if(!rule->is_existential){
-	if(has_new_instance(state, axiom_no)){
-	  may_have_next_rule = true;
-	  has_definite = true;
-	  definite_rule = axiom_no;
-	  if(rule->rhs->n_args == 1){
-	    has_definite_non_splitting = true;
-	    definite_non_splitting_rule = axiom_no;
-	    return pop_axiom(state, definite_non_splitting_rule);
-	  }
-	} else {
-	  if(may_have(state, axiom_no))
-	    may_have_next_rule = true;
-	  axiom_weights[axiom_no] = max_weight;
-	  continue;
-	}
-      } else { // not definite rule
-	may_have_next_rule = true;
-	if(axiom_no == 0 || axiom_weights[axiom_no] < axiom_weights[lightest_rule]){
-	  min_weight = axiom_weights[axiom_no];
-	  lightest_rule = axiom_no;
-	}
-	if(axiom_weights[axiom_no] >= max_weight){
-	  max_weight = axiom_weights[axiom_no];
-	}
-	assert(min_weight <=  max_weight);
-      } // end not definite rule
-
-    } // end if rule queue not empty
-    else 
-      axiom_weights[axiom_no] = max_weight;
-  } // end for all axioms
-
-  if(has_definite_non_splitting)
-    return pop_axiom(state, definite_non_splitting_rule);
-
-  if(!net->treat_all_disjuncts && has_definite)
-    return pop_axiom(state, definite_rule);
-
-  assert(lightest_rule < th->n_axioms && min_weight <= max_weight && axiom_weights[lightest_rule] == min_weight);
-
-  while(may_have_next_rule){
-    assert(lightest_rule < th->n_axioms && min_weight <= max_weight && axiom_weights[lightest_rule] == min_weight);
-    if(has_new_instance(state, lightest_rule))
-      return pop_axiom(state, lightest_rule);
-    if(!may_have(state, lightest_rule))
-      may_have_next_rule = false;
-    axiom_weights[lightest_rule] = max_weight;
-    min_weight = max_weight;
-    for(i = 0; i < th->n_axioms; i++){
-      if(axiom_weights[i] < min_weight){
-	lightest_rule = i;
-	min_weight = axiom_weights[i];
-	may_have_next_rule = true;
-      }
-      if(axiom_weights[i] > max_weight)
-	max_weight = axiom_weights[i];
+
+  next = next_instance_axiom_heap(state, net, definite, tried_rules, &n_tried, has_new_instance, possible_age, may_have, pop_axiom, previous_application);
+  if(next == NULL && !net->treat_all_disjuncts)
+    next = next_instance_axiom_heap(state, net, splitting, tried_rules, &n_tried, has_new_instance, possible_age, may_have, pop_axiom, previous_application);
+
+  // As before the heaps, the first axiom is tried first if it is a splitting rule not heavier than the lightest existential rule
+  if(next == NULL && axiom_in_heap(splitting, 0) && may_have(state, 0)){
+    update_axiom_heap_top(state, net, existential, possible_age, may_have, previous_application);
+    if(axiom_heap_is_empty(existential) 
+       || axiom_heap_weight(state, net, 0, possible_age, previous_application) <= get_axiom_heap_weight(existential, peek_axiom_heap(existential))){
+      remove_axiom_heap(splitting, 0);
+      tried_rules[n_tried++] = 0;
+      if(has_new_instance(state, 0))
+	next = pop_axiom(state, 0);
     }
   }
-  return NULL;
+
+  while(next == NULL){
+    unsigned int next_rule;
+    bool from_existential;
+    bool has_splitting;
+    update_axiom_heap_top(state, net, existential, possible_age, may_have, previous_application);
+    update_axiom_heap_top(state, net, splitting, possible_age, may_have, previous_application);
+    has_splitting = !axiom_heap_is_empty(splitting) && get_axiom_heap_weight(splitting, peek_axiom_heap(splitting)) < max_weight;
+    if(axiom_heap_is_empty(existential) && !has_splitting)
+      break;
+    if(axiom_heap_is_empty(existential))
+      from_existential = false;
+    else if(try_lightest || !has_splitting)
+      from_existential = true;
+    else {
+      unsigned int top = peek_axiom_heap(existential);
+      unsigned int split = peek_axiom_heap(splitting);
+      unsigned int top_weight = get_axiom_heap_weight(existential, top);
+      unsigned int split_weight = get_axiom_heap_weight(splitting, split);
+      from_existential = top_weight < split_weight || (top_weight == split_weight && top < split);
+    }
+    if(from_existential){
+      next_rule = peek_axiom_heap(existential);
+      // The lightest rule is tried even if its weight is not below max_weight
+      if(!try_lightest && get_axiom_heap_weight(existential, next_rule) >= max_weight)
+	break;
+      remove_axiom_heap(existential, next_rule);
+      try_lightest = false;
+    } else {
+      next_rule = peek_axiom_heap(splitting);
+      remove_axiom_heap(splitting, next_rule);
+    }
+    tried_rules[n_tried++] = next_rule;
+    if(has_new_instance(state, next_rule))
+      next = pop_axiom(state, next_rule);
+  }
+
+  for(i = 0; i < n_tried; i++){
+    unsigned int axiom_no = tried_rules[i];
+    if(may_have(state, axiom_no))
+      set_axiom_heap_weight(axiom_heaps(state, get_axiom_heap_kind(th->axioms[axiom_no]))
+			    , axiom_no
+			    , axiom_heap_weight(state, net, axiom_no, possible_age, previous_application));
+  }
+  return next;
 }
   
 /**
@@ -209,6 +295,7 @@ rule_instance* choose_next_instance(rule_queue_state state
 				    , rule_instance* (*pop_axiom)(rule_queue_state, unsigned int)
 				    , void (*add_to_queue) (const clp_axiom*, const substitution*, rule_queue_state)
 				    , unsigned int (*previous_application)(rule_queue_state, unsigned int)
+				    , axiom_heap* (*axiom_heaps)(rule_queue_state, axiom_heap_kind)
 				    )
 {
   rule_instance* ri;
@@ -217,7 +304,7 @@ rule_instance* choose_next_instance(rule_queue_state state
     ri = clpl_next_instance(state, net, has_new_instance, pop_axiom);
     break;
   case normal_strategy:
-    ri = normal_next_instance(state, net, step_no, is_empty, peek_axiom, has_new_instance, possible_age, may_have, pop_axiom, add_to_queue, previous_application);
+    ri = normal_next_instance(state, net, step_no, is_empty, peek_axiom, has_new_instance, possible_age, may_have, pop_axiom, add_to_queue, previous_application, axiom_heaps);
     break;
   default:
     fprintf(stderr, "Unknown strategy %i\n", strat);
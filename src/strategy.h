@@ -28,6 +28,15 @@
 
 typedef enum strategy_t { clpl_strategy, normal_strategy } strategy;
 
+/**
+   The rule queue state keeps the axioms that may have new instances in one axiom heap 
+   for each kind, see axiom_heap.h and normal_next_instance in strategy.c
+   definite_axiom_heap: the goal and fact rules, and the definite rules without disjunctions
+   splitting_axiom_heap: the definite rules with disjunctions
+   existential_axiom_heap: the other rules, which have existential quantifiers
+**/
+typedef enum axiom_heap_kind_t { definite_axiom_heap, splitting_axiom_heap, existential_axiom_heap, n_axiom_heap_kinds } axiom_heap_kind;
+
 rule_instance* factset_next_instance(const theory*, const fact_set*);
 
 #endif
@@ -43,7 +43,7 @@ unsigned int get_size_rule_instance(substitution_size_info);
 unsigned int get_max_n_timestamps(substitution_size_info);
 unsigned int get_sub_values_offset(substitution_size_info);
 
-// Note that this is defined in timestamp_array.c _or_ timestamp_linked_list.c, 
+// Note that this is defined in timestamp_array.c _or_ timestamp_vector.c, 
 // depending on USE_TIMESTAMP_ARRAY, defined in common.h
 substitution_size_info init_sub_size_info(unsigned int n_vars, unsigned int max_lhs_conjuncts);
 
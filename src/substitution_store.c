@@ -24,10 +24,13 @@
    These are not thread-safe, and used for the rete nodes 
 **/
 #include "common.h"
+#include <string.h>
 #include "term.h"
 #include "theory.h"
+#include "constants.h"
 #include "substitution_store.h"
 #include "substitution_size_info.h"
+#include "undo_trail.h"
 
 substitution_store init_substitution_store(substitution_size_info ssi){
   substitution_store new_store;
@@ -35,58 +38,406 @@ substitution_store init_substitution_store(substitution_size_info ssi){
   new_store.n_subst = 0;
   new_store.ssi = ssi;
   new_store.store = calloc_tester(new_store.max_n_subst, get_size_substitution(ssi));
+  new_store.join_index = NULL;
+  new_store.dup_index = NULL;
+  new_store.columns = NULL;
+  new_store.occurrences = NULL;
+  new_store.compact_vars = NULL;
+  new_store.entry_size = get_size_substitution(ssi);
+  new_store.trail = NULL;
+  new_store.trail_generation = 0;
   return new_store;
 }
 
 void destroy_substitution_store(substitution_store* store){
   free(store->store);
+  if(store->join_index != NULL)
+    destroy_sub_store_index(store->join_index);
+  if(store->dup_index != NULL)
+    destroy_sub_store_index(store->dup_index);
+  if(store->columns != NULL)
+    destroy_sub_store_columns(store->columns);
+  if(store->occurrences != NULL)
+    destroy_sub_store_occurrences(store->occurrences);
+}
+
+/**
+   Returns a copy of the store, used when the rete state is split in rete_state_single.c.
+   The substitutions are copied as they are, sharing the timestamp blocks with the original.
+   The indexes are not copied, but are built again on first use, except 
+   the duplicate index of a compact store, which is rebuilt by insert_compact_sub_store. 
+   The copy is not on any undo trail.
+**/
+substitution_store copy_substitution_store(const substitution_store* orig){
+  substitution_store copy = *orig;
+  copy.store = malloc_tester(orig->max_n_subst * orig->entry_size);
+  memcpy(copy.store, orig->store, orig->n_subst * orig->entry_size);
+  copy.join_index = NULL;
+  copy.dup_index = (orig->compact_vars != NULL) ? init_sub_store_index(NULL, true) : NULL;
+  copy.columns = NULL;
+  copy.occurrences = NULL;
+  copy.trail = NULL;
+  copy.trail_generation = 0;
+  return copy;
 }
 
 unsigned int alloc_store_substitution(substitution_store* store){
-  unsigned int new_i = store->n_subst;
+  unsigned int new_i;
+  if(needs_undo_trail(store->trail, store->trail_generation))
+    push_sub_store_undo_trail(store->trail, store);
+  new_i = store->n_subst;
   store->n_subst ++;
   if(store->n_subst >= store->max_n_subst){
     store->max_n_subst *= 2;
-    store->store = realloc_tester(store->store, store->max_n_subst * get_size_substitution(store->ssi));
+    store->store = realloc_tester(store->store, store->max_n_subst * store->entry_size);
   }
   return new_i;
 }
 
+/**
+   Adds substitution number sub_no to the index, if the index is up to date. 
+   Otherwise the index is rebuilt before it is used the next time
+**/
+void index_new_substitution(sub_store_index* index, unsigned int sub_no, const substitution* sub, constants* cs){
+  unsigned int hash;
+  if(index == NULL || index->disabled || index->n_entries != sub_no)
+    return;
+  if(!index->literal && index->version != cs->version)
+    return;
+  if(hash_sub_store_index_key(index, sub, cs, &hash))
+    add_sub_store_index(index, hash);
+  else
+    index->disabled = true;
+}
+
 /**
   Adds a copy of the substitution and all its substructures to the store
 **/
-void push_substitution_sub_store(substitution_store* store, const substitution* new_sub, timestamp_store* ts_store, const constants* cs){
+void push_substitution_sub_store(substitution_store* store, const substitution* new_sub, timestamp_store* ts_store, constants* cs){
   unsigned int sub_no = alloc_store_substitution(store);
   copy_substitution_struct(get_substitution(sub_no, store), new_sub, store->ssi, ts_store, false, cs);
+  index_new_substitution(store->join_index, sub_no, new_sub, cs);
+  index_new_substitution(store->dup_index, sub_no, new_sub, cs);
+  if(store->columns != NULL && store->columns->n_rows == sub_no && store->columns->version == cs->version)
+    add_sub_store_columns(store->columns, new_sub, cs);
+  if(store->occurrences != NULL && store->occurrences->n_subst == sub_no)
+    add_sub_store_occurrences(store->occurrences, sub_no, get_substitution(sub_no, store));
 }
 
 substitution* get_substitution(unsigned int i, substitution_store* store){
-  assert(i < store->max_n_subst);
-  return (substitution*) (store->store + (i * get_size_substitution(store->ssi)));
+  assert(i < store->max_n_subst && store->compact_vars == NULL);
+  return (substitution*) (store->store + (i * store->entry_size));
+}
+
+unsigned int* get_compact_substitution(unsigned int i, substitution_store* store){
+  assert(i < store->max_n_subst && store->compact_vars != NULL);
+  return (unsigned int*) (store->store + (i * store->entry_size));
+}
+
+/**
+   The hash value of a compact substitution, used in the dup_index of compact stores
+**/
+unsigned int hash_compact_substitution(const unsigned int* values, unsigned int n_vars){
+  unsigned int i, h = 0;
+  for(i = 0; i < n_vars; i++){
+    if(values[i] == COMPACT_SUB_NO_VALUE)
+      h = h * 31;
+    else
+      h = (h * 31) ^ ((values[i] + 1) * 2654435761u);
+  }
+  return h;
+}
+
+/**
+   Makes the empty store compact, with an element for each variable in vars.
+   The memory is shrunk accordingly
+**/
+void make_sub_store_compact(substitution_store* store, const freevars* vars){
+  assert(store->n_subst == 0 && store->dup_index == NULL && store->join_index == NULL);
+  store->compact_vars = vars;
+  store->entry_size = (vars->n_vars > 0 ? vars->n_vars : 1) * sizeof(unsigned int);
+  store->store = realloc_tester(store->store, store->max_n_subst * store->entry_size);
+  store->dup_index = init_sub_store_index(NULL, true);
+}
+
+/**
+   Inserts the constant ids of the values of vars in sub into the store, 
+   unless there is already an element with the same constant ids. 
+   Returns true if the element was inserted. 
+   Corresponds to sub_store_has_literally_equal followed by push_substitution_sub_store, 
+   but only for stores that are never iterated. 
+
+   The same vars must be given at every call for the same store.
+**/
+bool insert_compact_sub_store(substitution_store* store, const substitution* sub, const freevars* vars){
+  unsigned int i, n, hash, sub_no;
+  unsigned int* values;
+  sub_store_index* index;
+  if(store->compact_vars == NULL)
+    make_sub_store_compact(store, vars);
+  assert(store->compact_vars == vars);
+  index = store->dup_index;
+  if(index->n_entries != store->n_subst){
+    reset_sub_store_index(index, 0);
+    for(i = 0; i < store->n_subst; i++)
+      add_sub_store_index(index, hash_compact_substitution(get_compact_substitution(i, store), vars->n_vars));
+  }
+  sub_no = alloc_store_substitution(store);
+  values = get_compact_substitution(sub_no, store);
+  for(i = 0; i < vars->n_vars; i++){
+    const clp_term* t = get_sub_value(sub, vars->vars[i]->var_no);
+    assert(t == NULL || t->type == constant_term);
+    values[i] = (t == NULL) ? COMPACT_SUB_NO_VALUE : t->val.constant.id;
+  }
+  hash = hash_compact_substitution(values, vars->n_vars);
+  for(n = first_sub_store_index(index, hash); n != SUB_STORE_INDEX_END; n = next_sub_store_index(index, n, hash)){
+    if(memcmp(get_compact_substitution(n, store), values, vars->n_vars * sizeof(unsigned int)) == 0){
+      store->n_subst--;
+      return false;
+    }
+  }
+  add_sub_store_index(index, hash);
+  return true;
 }
 
 
 sub_store_iter get_sub_store_iter(substitution_store* store){
   sub_store_iter iter;
+  assert(store->compact_vars == NULL);
   iter.n = 0;
   iter.store = store;
+  iter.index = NULL;
+  iter.matches = NULL;
+  iter.n_matches = 0;
+  iter.i_match = 0;
+  iter.columns = NULL;
+  iter.key = NULL;
+  return iter;
+}
+
+/**
+   Rehashes all substitutions in the store. Called when the 
+   index is created, and when the equalities between constants 
+   have changed since the index was built
+**/
+void rebuild_sub_store_index(substitution_store* store, sub_store_index* index, constants* cs){
+  unsigned int i, hash;
+  reset_sub_store_index(index, cs->version);
+  for(i = 0; i < store->n_subst && !index->disabled; i++){
+    if(hash_sub_store_index_key(index, get_substitution(i, store), cs, &hash))
+      add_sub_store_index(index, hash);
+    else
+      index->disabled = true;
+  }
+}
+
+/**
+   Recreates the columns from the substitutions in the store. Called when the 
+   columns are created, and when the equalities between constants 
+   have changed since the columns were built
+**/
+void rebuild_sub_store_columns(substitution_store* store, sub_store_columns* columns, constants* cs){
+  unsigned int i;
+  reset_sub_store_columns(columns, cs->version);
+  for(i = 0; i < store->n_subst && !columns->disabled; i++)
+    add_sub_store_columns(columns, get_substitution(i, store), cs);
+}
+
+/**
+   Iterates over the substitutions in the store that agree with sub on the 
+   variables in vars, modulo equality of constants, where both have a value. 
+   This is the same test as subs_equal_intersection restricted to vars, 
+   and the order is the same as for get_sub_store_iter. 
+
+   The columns are created at the first call, and scanned by next_sub_store_columns.
+   The same vars must be given at every call for the same store. 
+   Falls back to iterating over the whole store if vars is empty, 
+   or if some value is not a constant.
+
+   key is a buffer with SUB_STORE_COLUMNS_KEY_SIZE(vars) entries, 
+   usually on the stack of the caller, which must live as long as the iterator.
+**/
+sub_store_iter get_sub_store_columns_iter(substitution_store* store, const freevars* vars, const substitution* sub, constants* cs, unsigned int* key){
+  sub_store_iter iter = get_sub_store_iter(store);
+  sub_store_columns* columns;
+  if(vars == NULL || vars->n_vars == 0)
+    return iter;
+  if(store->columns == NULL){
+    store->columns = init_sub_store_columns(vars);
+    rebuild_sub_store_columns(store, store->columns, cs);
+  }
+  columns = store->columns;
+  assert(columns->vars == vars);
+  // Disabled columns are not rebuilt until the equalities change, see substitution_store_columns.h
+  if(columns->disabled && columns->version == cs->version)
+    return iter;
+  if(columns->version != cs->version || columns->n_rows != store->n_subst)
+    rebuild_sub_store_columns(store, columns, cs);
+  if(columns->disabled)
+    return iter;
+  if(get_sub_store_columns_key(columns, sub, cs, key)){
+    iter.key = key;
+    iter.columns = columns;
+  }
+  return iter;
+}
+
+/**
+   Iterates over the substitutions in the store that may agree 
+   with sub on the join variables, modulo equality of constants. 
+   The order is the same as for get_sub_store_iter, but substitutions
+   that cannot agree with sub are skipped. The caller must still check 
+   the substitutions returned.
+
+   The hash index on the join variables is created at the first call. 
+   Falls back to scanning the columns, see get_sub_store_columns_iter, if some 
+   substitution lacks a value for a join variable. key is then used as 
+   in get_sub_store_columns_iter.
+**/
+sub_store_iter get_sub_store_join_iter(substitution_store* store, const freevars* join_vars, const substitution* sub, constants* cs, unsigned int* key){
+  sub_store_iter iter = get_sub_store_iter(store);
+  sub_store_index* index;
+  if(join_vars == NULL || join_vars->n_vars == 0)
+    return iter;
+  if(store->join_index == NULL){
+    store->join_index = init_sub_store_index(join_vars, false);
+    rebuild_sub_store_index(store, store->join_index, cs);
+  }
+  index = store->join_index;
+  assert(index->vars == join_vars);
+  if(!index->disabled && (index->version != cs->version || index->n_entries != store->n_subst))
+    rebuild_sub_store_index(store, store->join_index, cs);
+  if(index->disabled || !hash_sub_store_index_key(index, sub, cs, &iter.hash))
+    return get_sub_store_columns_iter(store, join_vars, sub, cs, key);
+  iter.index = index;
+  iter.n = first_sub_store_index(index, iter.hash);
+  return iter;
+}
+
+/**
+   Returns true if some value of sub is a constant in one of the classes
+**/
+bool sub_in_constant_classes(const substitution* sub, const constant_classes* classes, constants* cs){
+  unsigned int i;
+  for(i = 0; i < sub->allvars->n_vars; i++){
+    const clp_term* t = get_sub_value(sub, i);
+    if(t != NULL && t->type == constant_term && in_constant_classes(t->val.constant.id, classes, cs))
+      return true;
+  }
+  return false;
+}
+
+int compare_sub_numbers(const void* a, const void* b){
+  unsigned int n1 = *((const unsigned int*) a);
+  unsigned int n2 = *((const unsigned int*) b);
+  return (n1 > n2) - (n1 < n2);
+}
+
+/**
+   Iterates over the substitutions in the store that contain a constant 
+   in one of the given equivalence classes, in the same order as get_sub_store_iter. 
+   Used when rechecking the rete network after an equality, since only these
+   substitutions may join or pass equality tests that they did not before.
+
+   The occurrence index is created at the first call, and brought up 
+   to date with the store at later calls. Only the occurrences of the members 
+   of the classes are read, and the numbers found are sorted, 
+   such that the time does not depend on the size of the store or the number of constants.
+**/
+sub_store_iter get_sub_store_class_iter(substitution_store* store, const constant_classes* classes, constants* cs){
+  unsigned int m, i, n_found = 0, size_found = 0;
+  unsigned int* found = NULL;
+  sub_store_iter iter = get_sub_store_iter(store);
+  sub_store_occurrences* occ = store->occurrences;
+  if(occ == NULL){
+    occ = init_sub_store_occurrences();
+    store->occurrences = occ;
+  }
+  while(occ->n_subst < store->n_subst)
+    add_sub_store_occurrences(occ, occ->n_subst, get_substitution(occ->n_subst, store));
+  for(m = 0; m < classes->n_members; m++){
+    unsigned int c = classes->members[m];
+    if(c >= occ->n_constants)
+      continue;
+    for(i = 0; i < occ->n_occs[c] && occ->occs[c][i] < store->n_subst; i++){
+      if(n_found >= size_found){
+	size_found = (size_found == 0) ? 16 : 2 * size_found;
+	found = realloc_tester(found, size_found * sizeof(unsigned int));
+      }
+      found[n_found++] = occ->occs[c][i];
+    }
+  }
+  if(n_found > 1)
+    qsort(found, n_found, sizeof(unsigned int), compare_sub_numbers);
+  iter.matches = malloc_tester((n_found + 1) * sizeof(unsigned int));
+  for(i = 0; i < n_found; i++){
+    unsigned int n = found[i];
+    if(i > 0 && n == found[i-1])
+      continue;
+    if(sub_in_constant_classes(get_substitution(n, store), classes, cs))
+      iter.matches[iter.n_matches++] = n;
+  }
+  if(found != NULL)
+    free(found);
   return iter;
 }
 
+/**
+   Returns true if the store contains a substitution literally equal 
+   to sub on the variables in vars. 
+   Uses the dup_index, which is created at the first call. 
+   The same vars must be given at every call for the same store.
+**/
+bool sub_store_has_literally_equal(substitution_store* store, const substitution* sub, const freevars* vars, constants* cs){
+  unsigned int n, hash;
+  sub_store_index* index = store->dup_index;
+  if(index == NULL){
+    index = init_sub_store_index(vars, true);
+    store->dup_index = index;
+    rebuild_sub_store_index(store, index, cs);
+  } else if(index->n_entries != store->n_subst)
+    rebuild_sub_store_index(store, index, cs);
+  assert(index->vars == vars && !index->disabled);
+  hash_sub_store_index_key(index, sub, cs, &hash);
+  for(n = first_sub_store_index(index, hash); n != SUB_STORE_INDEX_END; n = next_sub_store_index(index, n, hash)){
+    if(literally_equal_substitutions(sub, get_substitution(n, store), vars, cs))
+      return true;
+  }
+  return false;
+}
+
 bool has_next_sub_store(sub_store_iter* iter){
+  if(iter->index != NULL)
+    return iter->n != SUB_STORE_INDEX_END;
+  if(iter->columns != NULL){
+    iter->n = next_sub_store_columns(iter->columns, iter->key, iter->n);
+    return iter->n != SUB_STORE_COLUMNS_END;
+  }
+  if(iter->matches != NULL){
+    if(iter->i_match >= iter->n_matches)
+      return false;
+    iter->n = iter->matches[iter->i_match];
+    return true;
+  }
   return iter->n < iter->store->n_subst;
 }
 
 substitution* get_next_sub_store(sub_store_iter* iter){
   substitution* sub = get_substitution(iter->n, iter->store);
   assert(iter->n < iter->store->n_subst);
-  iter->n ++;
+  if(iter->index != NULL)
+    iter->n = next_sub_store_index(iter->index, iter->n, iter->hash);
+  else if(iter->matches != NULL)
+    iter->i_match++;
+  else
+    iter->n ++;
   return sub;
 }
 
 
 void destroy_sub_store_iter(sub_store_iter* iter){
-  ;
+  if(iter->matches != NULL)
+    free(iter->matches);
 }
 
 
@@ -105,6 +456,14 @@ substitution_store_backup backup_substitution_store(substitution_store* store){
 void restore_substitution_store(substitution_store* store, substitution_store_backup backup){
   assert(store == backup.store);
   store->n_subst = backup.n_subst;
+  if(store->join_index != NULL && store->join_index->n_entries > store->n_subst)
+    truncate_sub_store_index(store->join_index, store->n_subst);
+  if(store->dup_index != NULL && store->dup_index->n_entries > store->n_subst)
+    truncate_sub_store_index(store->dup_index, store->n_subst);
+  if(store->columns != NULL)
+    truncate_sub_store_columns(store->columns, store->n_subst);
+  if(store->occurrences != NULL && store->occurrences->n_subst > store->n_subst)
+    store->occurrences->n_subst = store->n_subst;
 }
 
 void destroy_substitution_backup(substitution_store_backup * backup){
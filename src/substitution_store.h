@@ -23,9 +23,14 @@
 #define __INCLUDED_SUBSTITUTION_STORE_H
 
 #define INIT_SUBST_STORE_SIZE 1000
+#define COMPACT_SUB_NO_VALUE ((unsigned int) -1)
 
 #include "substitution.h"
 #include "substitution_size_info.h"
+#include "substitution_store_index.h"
+#include "substitution_store_columns.h"
+
+struct undo_trail_t;
 
 /**
    A store of substitutions for use in states
@@ -39,14 +44,44 @@
 
 /**
    Implements a cache of substitutions in a alpha or beta node
-**/
 
+   join_index is NULL, except for the alpha and beta stores of 
+   beta_and nodes with join variables. It is then a hash index on 
+   the join variables, see get_sub_store_join_iter
+
+   dup_index is a literal hash index on the variables relevant for 
+   duplicate detection, see sub_store_has_literally_equal
+
+   columns is NULL until the store is first iterated by get_sub_store_columns_iter, 
+   or by get_sub_store_join_iter when the join_index cannot be used. 
+   It then holds the values of the join variables column-wise, for vectorized scans. 
+
+   occurrences is NULL until the store is first iterated by get_sub_store_class_iter. 
+   It then indexes the constants in the substitutions.
+
+   compact_vars is NULL for stores of whole substitutions. Stores that are only used 
+   for detecting duplicates (the stores of rule nodes, equality nodes and the left stores of beta_not nodes) 
+   are made compact by the first call to insert_compact_sub_store. 
+   Each element is then only the constant ids of the values of the variables in compact_vars, 
+   with COMPACT_SUB_NO_VALUE for variables without value. There are no timestamps. 
+   entry_size is the size of each element in bytes.
 
+   trail is NULL, except for the stores in the rete state, which push a backup 
+   on the undo trail the first time they are changed after a backup, see undo_trail.h
+**/
 typedef struct substitution_store_t {
   char* store;
   unsigned int max_n_subst;
   unsigned int n_subst;
   substitution_size_info ssi;
+  sub_store_index* join_index;
+  sub_store_index* dup_index;
+  sub_store_columns* columns;
+  sub_store_occurrences* occurrences;
+  const freevars* compact_vars;
+  unsigned int entry_size;
+  struct undo_trail_t* trail;
+  unsigned long trail_generation;
 } substitution_store;
 
 typedef struct substitution_store_backup_t {
@@ -54,18 +89,42 @@ typedef struct substitution_store_backup_t {
   unsigned int n_subst;
 } substitution_store_backup;
 
+/**
+   If index is not NULL, only the substitutions in the index
+   with the given hash value are iterated over
+
+   If matches is not NULL, only the n_matches substitutions with these numbers are iterated over, 
+   and i_match is the position in matches. matches is then freed by destroy_sub_store_iter
+
+   If columns is not NULL, only the substitutions agreeing with key 
+   in the columns are iterated over, see next_sub_store_columns. 
+   key is then a buffer given by the caller of get_sub_store_columns_iter
+**/
 typedef struct sub_store_iter_t {
   substitution_store* store;
   unsigned int n;
+  const sub_store_index* index;
+  unsigned int hash;
+  unsigned int* matches;
+  unsigned int n_matches;
+  unsigned int i_match;
+  const sub_store_columns* columns;
+  const unsigned int* key;
 } sub_store_iter;
 
 substitution_store init_substitution_store(substitution_size_info);
 void destroy_substitution_store(substitution_store*);
+substitution_store copy_substitution_store(const substitution_store*);
 unsigned int alloc_store_substitution(substitution_store*);
-void push_substitution_sub_store(substitution_store*, const substitution*, timestamp_store*, const constants* cs);
+void push_substitution_sub_store(substitution_store*, const substitution*, timestamp_store*, constants* cs);
 substitution* get_substitution(unsigned int, substitution_store*);
 
 sub_store_iter get_sub_store_iter(substitution_store*);
+sub_store_iter get_sub_store_join_iter(substitution_store*, const freevars*, const substitution*, constants*, unsigned int* key);
+sub_store_iter get_sub_store_columns_iter(substitution_store*, const freevars*, const substitution*, constants*, unsigned int* key);
+sub_store_iter get_sub_store_class_iter(substitution_store*, const constant_classes*, constants*);
+bool insert_compact_sub_store(substitution_store*, const substitution*, const freevars*);
+bool sub_store_has_literally_equal(substitution_store*, const substitution*, const freevars*, constants*);
 bool has_next_sub_store(sub_store_iter*);
 substitution* get_next_sub_store(sub_store_iter*);
 void destroy_sub_store_iter(sub_store_iter*);
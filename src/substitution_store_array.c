@@ -42,6 +42,19 @@ substitution_store_array* init_substitution_store_array(substitution_size_info s
 
 
 
+/**
+   Called when splitting the rete state, see copy_substitution_store
+**/
+substitution_store_array* copy_substitution_store_array(const substitution_store_array* orig){
+  unsigned int i;
+  substitution_store_array * stores = malloc_tester(sizeof(substitution_store_array));
+  stores->stores = calloc_tester(orig->n_stores, sizeof(substitution_store));
+  stores->n_stores = orig->n_stores;
+  for(i = 0; i < stores->n_stores; i++)
+    stores->stores[i] = copy_substitution_store(& orig->stores[i]);
+  return stores;
+}
+
 void destroy_substitution_store_array(substitution_store_array* stores){
   unsigned int i;
   for(i = 0; i < stores->n_stores; i++)
@@ -59,6 +72,18 @@ sub_store_iter get_array_sub_store_iter(substitution_store_array* stores, unsign
   return get_sub_store_iter(get_substitution_store(stores, node_no));
 }
 
+sub_store_iter get_array_sub_store_class_iter(substitution_store_array* stores, unsigned int node_no, const constant_classes* classes, constants* cs){
+  return get_sub_store_class_iter(get_substitution_store(stores, node_no), classes, cs);
+}
+
+sub_store_iter get_array_sub_store_columns_iter(substitution_store_array* stores, unsigned int node_no, const freevars* vars, const substitution* sub, constants* cs, unsigned int* key){
+  return get_sub_store_columns_iter(get_substitution_store(stores, node_no), vars, sub, cs, key);
+}
+
+sub_store_iter get_array_sub_store_join_iter(substitution_store_array* stores, unsigned int node_no, const freevars* join_vars, const substitution* sub, constants* cs, unsigned int* key){
+  return get_sub_store_join_iter(get_substitution_store(stores, node_no), join_vars, sub, cs, key);
+}
+
 
 /**
    Insert a copy of substition into the state, if not already there (modulo relevant_vars)
@@ -70,45 +95,18 @@ sub_store_iter get_array_sub_store_iter(substitution_store_array* stores, unsign
 
 **/
 bool insert_substitution_single(substitution_store_array* stores, unsigned int sub_no, const substitution* a, const freevars* relevant_vars, constants* cs, timestamp_store* ts_store){
-  sub_store_iter iter = get_array_sub_store_iter(stores, sub_no);
-  
-  while(has_next_sub_store(&iter)){
-    substitution* next_sub = get_next_sub_store(&iter);
-    if(literally_equal_substitutions(a, next_sub, relevant_vars, cs))
-      return false;
-  }
-  destroy_sub_store_iter(&iter);
-  push_substitution_sub_store(get_substitution_store(stores, sub_no), a, ts_store, cs);
+  substitution_store* store = get_substitution_store(stores, sub_no);
+  if(sub_store_has_literally_equal(store, a, relevant_vars, cs))
+    return false;
+  push_substitution_sub_store(store, a, ts_store, cs);
   return true;
 }
 
-
 /**
-   Auxiliaries for manipulating array of substitution store backups
+   As insert_substitution_single, but for the stores that are only used to detect duplicates. 
+   Only the constant ids of the values of relevant_vars are stored, see insert_compact_sub_store
 **/
-
-substitution_store_array_backup * backup_substitution_store_array(substitution_store_array* stores){
-  unsigned int i;
-  substitution_store_array_backup * backup = malloc(sizeof(substitution_store_array_backup)) ;
-  backup->backups = calloc_tester(stores->n_stores, sizeof(substitution_store_backup)); 
-  backup->stores = stores;
-  for(i = 0; i < stores->n_stores; i++)
-    backup->backups[i] = backup_substitution_store(& stores->stores[i]);
-  return backup;
-}
-
-substitution_store_array * restore_substitution_store_array(substitution_store_array_backup* backup){
-  unsigned int i;
-  substitution_store_array* stores = backup->stores;
-  for(i = 0; i < stores->n_stores; i++)
-    restore_substitution_store(& stores->stores[i], backup->backups[i]);
-  return stores;
+bool insert_compact_substitution_single(substitution_store_array* stores, unsigned int sub_no, const substitution* a, const freevars* relevant_vars){
+  return insert_compact_sub_store(get_substitution_store(stores, sub_no), a, relevant_vars);
 }
 
-void destroy_substitution_store_array_backup(substitution_store_array_backup* backups){
-  unsigned int i;
-  for(i = 0; i < backups->stores->n_stores; i++)
-    destroy_substitution_backup(& backups->backups[i]);
-  free(backups->backups);
-  free(backups);
-}
@@ -34,20 +34,16 @@ typedef struct substitution_store_array_t {
   substitution_store * stores;
 } substitution_store_array;
 
-typedef struct substitution_store_array_backup_t {
-  substitution_store_array* stores;
-  substitution_store_backup * backups;
-} substitution_store_array_backup;
-
 
 substitution_store_array * init_substitution_store_array(substitution_size_info, unsigned int n_stores);
 void destroy_substitution_store_array(substitution_store_array*);
+substitution_store_array * copy_substitution_store_array(const substitution_store_array*);
 
 substitution_store * get_substitution_store(substitution_store_array*, unsigned int);
 sub_store_iter get_array_sub_store_iter(substitution_store_array*, unsigned int);
+sub_store_iter get_array_sub_store_class_iter(substitution_store_array*, unsigned int, const constant_classes*, constants*);
+sub_store_iter get_array_sub_store_columns_iter(substitution_store_array*, unsigned int, const freevars*, const substitution*, constants*, unsigned int*);
+sub_store_iter get_array_sub_store_join_iter(substitution_store_array*, unsigned int, const freevars*, const substitution*, constants*, unsigned int*);
+bool insert_compact_substitution_single(substitution_store_array*, unsigned int, const substitution*, const freevars*);
 bool insert_substitution_single(substitution_store_array* stores, unsigned int sub_no, const substitution* a, const freevars* relevant_vars, constants*, timestamp_store*);
-
-substitution_store_array* restore_substitution_store_array(substitution_store_array_backup*);
-substitution_store_array_backup * backup_substitution_store_array(substitution_store_array*);
-void destroy_substitution_store_array_backup(substitution_store_array_backup*);
 #endif
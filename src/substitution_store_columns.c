@@ -0,0 +1,200 @@
+/* substitution_store_columns.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Column-wise copies of the join values of the substitutions in a 
+   substitution store, for scanning many substitutions at a time. 
+   Like the stores, these are not thread-safe.
+
+   The vectorized scans are used if the compiler defines __AVX2__ or __SSE2__,
+   (e.g. with -mavx2, SSE2 is always available on x86-64). Otherwise
+   the scalar scan is used.
+**/
+#include "common.h"
+#include "term.h"
+#include "constants.h"
+#include "substitution.h"
+#include "substitution_store_columns.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+sub_store_columns* init_sub_store_columns(const freevars* vars){
+  unsigned int i;
+  sub_store_columns* columns = malloc_tester(sizeof(sub_store_columns));
+  columns->vars = vars;
+  columns->disabled = false;
+  columns->version = 0;
+  columns->n_rows = 0;
+  columns->size_rows = INIT_SUB_STORE_COLUMNS_SIZE;
+  columns->cols = calloc_tester(vars->n_vars > 0 ? vars->n_vars : 1, sizeof(unsigned int*));
+  for(i = 0; i < vars->n_vars; i++)
+    columns->cols[i] = malloc_tester(columns->size_rows * sizeof(unsigned int));
+  return columns;
+}
+
+void destroy_sub_store_columns(sub_store_columns* columns){
+  unsigned int i;
+  for(i = 0; i < columns->vars->n_vars; i++)
+    free(columns->cols[i]);
+  free(columns->cols);
+  free(columns);
+}
+
+/**
+   Removes all rows. Called before rebuilding the columns
+**/
+void reset_sub_store_columns(sub_store_columns* columns, unsigned long version){
+  columns->n_rows = 0;
+  columns->disabled = false;
+  columns->version = version;
+}
+
+/**
+   The value stored in the columns for a term
+**/
+unsigned int _sub_store_columns_value(const clp_term* t, constants* cs, bool* is_constant){
+  if(t == NULL)
+    return SUB_STORE_COLUMNS_NO_VALUE;
+  if(t->type != constant_term){
+    *is_constant = false;
+    return SUB_STORE_COLUMNS_NO_VALUE;
+  }
+  return get_constant_root(t->val.constant, cs);
+}
+
+/**
+   Adds sub as the last row. 
+**/
+void add_sub_store_columns(sub_store_columns* columns, const substitution* sub, constants* cs){
+  unsigned int i;
+  bool is_constant = true;
+  if(columns->disabled)
+    return;
+  if(columns->n_rows >= columns->size_rows){
+    columns->size_rows *= 2;
+    for(i = 0; i < columns->vars->n_vars; i++)
+      columns->cols[i] = realloc_tester(columns->cols[i], columns->size_rows * sizeof(unsigned int));
+  }
+  for(i = 0; i < columns->vars->n_vars; i++)
+    columns->cols[i][columns->n_rows] = _sub_store_columns_value(get_sub_value(sub, columns->vars->vars[i]->var_no), cs, &is_constant);
+  if(is_constant)
+    columns->n_rows++;
+  else
+    columns->disabled = true;
+}
+
+/**
+   Removes the rows from n_rows and out. Used when restoring a store backup
+**/
+void truncate_sub_store_columns(sub_store_columns* columns, unsigned int n_rows){
+  if(columns->n_rows >= n_rows)
+    columns->disabled = false;
+  if(columns->n_rows > n_rows)
+    columns->n_rows = n_rows;
+}
+
+/**
+   Writes the key used to search for substitutions agreeing with sub, 
+   see next_sub_store_columns. key must have room for 
+   SUB_STORE_COLUMNS_KEY_SIZE(columns->vars) entries. 
+   Returns false if some value in sub is not a constant. 
+**/
+bool get_sub_store_columns_key(const sub_store_columns* columns, const substitution* sub, constants* cs, unsigned int* key){
+  unsigned int i;
+  bool is_constant = true;
+  for(i = 0; i < columns->vars->n_vars; i++)
+    key[i] = _sub_store_columns_value(get_sub_value(sub, columns->vars->vars[i]->var_no), cs, &is_constant);
+  return is_constant;
+}
+
+/**
+   Returns true if row n agrees with the key on all variables 
+   where both have a value
+**/
+bool _sub_store_columns_row_matches(const sub_store_columns* columns, const unsigned int* key, unsigned int n){
+  unsigned int i;
+  for(i = 0; i < columns->vars->n_vars; i++){
+    unsigned int val = columns->cols[i][n];
+    if(key[i] != SUB_STORE_COLUMNS_NO_VALUE && val != SUB_STORE_COLUMNS_NO_VALUE && val != key[i])
+      return false;
+  }
+  return true;
+}
+
+/**
+   Returns the number of the first row from start that agrees with 
+   the key on all variables where both have a value, or SUB_STORE_COLUMNS_END. 
+   The key is from get_sub_store_columns_key. start may be SUB_STORE_COLUMNS_END,
+   or past the last row, then SUB_STORE_COLUMNS_END is returned. 
+
+   This corresponds to the test in subs_equal_intersection, restricted
+   to the variables in the columns. Blocks of 8 (AVX2) or 4 (SSE2) rows 
+   are compared at a time, the remaining rows one at a time.
+**/
+unsigned int next_sub_store_columns(const sub_store_columns* columns, const unsigned int* key, unsigned int start){
+  unsigned int n = start;
+  if(start >= columns->n_rows)
+    return SUB_STORE_COLUMNS_END;
+#if defined(__AVX2__)
+  const __m256i no_value = _mm256_set1_epi32((int) SUB_STORE_COLUMNS_NO_VALUE);
+  for( ; n + 8 <= columns->n_rows; n += 8){
+    __m256i match = _mm256_set1_epi32(-1);
+    unsigned int i;
+    int mask;
+    for(i = 0; i < columns->vars->n_vars; i++){
+      __m256i vals, eq;
+      if(key[i] == SUB_STORE_COLUMNS_NO_VALUE)
+	continue;
+      vals = _mm256_loadu_si256((const __m256i*) (columns->cols[i] + n));
+      eq = _mm256_or_si256(_mm256_cmpeq_epi32(vals, _mm256_set1_epi32((int) key[i])), _mm256_cmpeq_epi32(vals, no_value));
+      match = _mm256_and_si256(match, eq);
+    }
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+    if(mask != 0)
+      return n + __builtin_ctz(mask);
+  }
+#elif defined(__SSE2__)
+  const __m128i no_value = _mm_set1_epi32((int) SUB_STORE_COLUMNS_NO_VALUE);
+  for( ; n + 4 <= columns->n_rows; n += 4){
+    __m128i match = _mm_set1_epi32(-1);
+    unsigned int i;
+    int mask;
+    for(i = 0; i < columns->vars->n_vars; i++){
+      __m128i vals, eq;
+      if(key[i] == SUB_STORE_COLUMNS_NO_VALUE)
+	continue;
+      vals = _mm_loadu_si128((const __m128i*) (columns->cols[i] + n));
+      eq = _mm_or_si128(_mm_cmpeq_epi32(vals, _mm_set1_epi32((int) key[i])), _mm_cmpeq_epi32(vals, no_value));
+      match = _mm_and_si128(match, eq);
+    }
+    mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+    if(mask != 0)
+      return n + __builtin_ctz(mask);
+  }
+#endif
+  for( ; n < columns->n_rows; n++){
+    if(_sub_store_columns_row_matches(columns, key, n))
+      return n;
+  }
+  return SUB_STORE_COLUMNS_END;
+}
@@ -0,0 +1,72 @@
+/* substitution_store_columns.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_SUBSTITUTION_STORE_COLUMNS_H
+#define __INCLUDED_SUBSTITUTION_STORE_COLUMNS_H
+
+#include "common.h"
+#include "substitution_struct.h"
+#include "constants_struct.h"
+
+#define INIT_SUB_STORE_COLUMNS_SIZE 64
+#define SUB_STORE_COLUMNS_NO_VALUE ((unsigned int) -1)
+#define SUB_STORE_COLUMNS_END ((unsigned int) -1)
+/**
+   The number of entries in a key for the columns of vars, see get_sub_store_columns_key. 
+   Always positive, so it can be used for the size of an array on the stack.
+**/
+#define SUB_STORE_COLUMNS_KEY_SIZE(vars) ((vars) == NULL ? 1 : (vars)->n_vars + 1)
+
+/**
+   A column-wise copy of the values of the variables in vars 
+   of the substitutions in a substitution_store. 
+
+   cols[i][n] is the root of the equivalence class of the value of 
+   vars->vars[i] in substitution number n, or SUB_STORE_COLUMNS_NO_VALUE 
+   if the variable has no value. Like non-literal sub_store_index, the 
+   columns are only valid as long as version equals the version of the 
+   constants, and must otherwise be rebuilt. The timestamps and terms 
+   stay in the substitutions in the store.
+
+   The columns are scanned by next_sub_store_columns, which compares 
+   several substitutions at a time with SSE2 or AVX2 instructions when 
+   the compiler supports these, see substitution_store_columns.c
+
+   disabled is set if a value that is not a constant is added. This substitution 
+   is then number n_rows in the store. The columns are not used until it is removed from 
+   the store by truncate_sub_store_columns, or the equalities change.
+**/
+typedef struct sub_store_columns_t {
+  const freevars* vars;
+  bool disabled;
+  unsigned long version;
+  unsigned int n_rows;
+  unsigned int size_rows;
+  unsigned int ** cols;
+} sub_store_columns;
+
+sub_store_columns* init_sub_store_columns(const freevars*);
+void destroy_sub_store_columns(sub_store_columns*);
+void reset_sub_store_columns(sub_store_columns*, unsigned long version);
+void add_sub_store_columns(sub_store_columns*, const substitution*, constants*);
+void truncate_sub_store_columns(sub_store_columns*, unsigned int);
+bool get_sub_store_columns_key(const sub_store_columns*, const substitution*, constants*, unsigned int* key);
+unsigned int next_sub_store_columns(const sub_store_columns*, const unsigned int* key, unsigned int start);
+#endif
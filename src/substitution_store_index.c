@@ -0,0 +1,250 @@
+/* substitution_store_index.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Hash indexes on the substitutions in a substitution store. 
+   Like the stores, these are not thread-safe.
+**/
+#include "common.h"
+#include "term.h"
+#include "substitution.h"
+#include "substitution_store_index.h"
+
+sub_store_index* init_sub_store_index(const freevars* vars, bool literal){
+  sub_store_index* index = malloc_tester(sizeof(sub_store_index));
+  index->vars = vars;
+  index->literal = literal;
+  index->disabled = false;
+  index->version = 0;
+  index->n_buckets = INIT_SUB_STORE_INDEX_BUCKETS;
+  index->bucket_first = malloc_tester(index->n_buckets * sizeof(unsigned int));
+  index->bucket_last = malloc_tester(index->n_buckets * sizeof(unsigned int));
+  index->size_entries = INIT_SUB_STORE_INDEX_BUCKETS;
+  index->entry_hash = malloc_tester(index->size_entries * sizeof(unsigned int));
+  index->entry_next = malloc_tester(index->size_entries * sizeof(unsigned int));
+  index->entry_prev = malloc_tester(index->size_entries * sizeof(unsigned int));
+  reset_sub_store_index(index, 0);
+  return index;
+}
+
+void destroy_sub_store_index(sub_store_index* index){
+  free(index->bucket_first);
+  free(index->bucket_last);
+  free(index->entry_hash);
+  free(index->entry_next);
+  free(index->entry_prev);
+  free(index);
+}
+
+/**
+   Removes all entries. Called before rebuilding the index
+**/
+void reset_sub_store_index(sub_store_index* index, unsigned long version){
+  unsigned int i;
+  for(i = 0; i < index->n_buckets; i++){
+    index->bucket_first[i] = SUB_STORE_INDEX_END;
+    index->bucket_last[i] = SUB_STORE_INDEX_END;
+  }
+  index->n_entries = 0;
+  index->version = version;
+}
+
+/**
+   Calculates the hash value of the key of sub. 
+   Returns false if sub has no value for some of the variables in the key, 
+   unless the index is literal
+**/
+bool hash_sub_store_index_key(const sub_store_index* index, const substitution* sub, constants* cs, unsigned int* hash){
+  unsigned int i;
+  unsigned int h = 0;
+  for(i = 0; i < index->vars->n_vars; i++){
+    const clp_term* t = get_sub_value(sub, index->vars->vars[i]->var_no);
+    if(t == NULL){
+      if(!index->literal)
+	return false;
+      h = h * 31;
+    } else
+      h = (h * 31) ^ hash_term(t, cs, index->literal);
+  }
+  *hash = h;
+  return true;
+}
+
+/**
+   Appends entry number n to the end of its bucket
+**/
+void _link_sub_store_index_entry(sub_store_index* index, unsigned int n){
+  unsigned int b = index->entry_hash[n] & (index->n_buckets - 1);
+  index->entry_next[n] = SUB_STORE_INDEX_END;
+  index->entry_prev[n] = index->bucket_last[b];
+  if(index->bucket_last[b] == SUB_STORE_INDEX_END)
+    index->bucket_first[b] = n;
+  else
+    index->entry_next[index->bucket_last[b]] = n;
+  index->bucket_last[b] = n;
+}
+
+/**
+   Doubles the number of buckets and relinks all entries.
+   The stored hash values are reused, so the constants are not needed
+**/
+void _grow_sub_store_index(sub_store_index* index){
+  unsigned int i, n_entries = index->n_entries;
+  index->n_buckets *= 2;
+  index->bucket_first = realloc_tester(index->bucket_first, index->n_buckets * sizeof(unsigned int));
+  index->bucket_last = realloc_tester(index->bucket_last, index->n_buckets * sizeof(unsigned int));
+  reset_sub_store_index(index, index->version);
+  for(i = 0; i < n_entries; i++)
+    _link_sub_store_index_entry(index, i);
+  index->n_entries = n_entries;
+}
+
+/**
+   Adds the next substitution of the store, with the given hash value.
+   The number of the entry is the number of entries already in the index
+**/
+void add_sub_store_index(sub_store_index* index, unsigned int hash){
+  unsigned int n = index->n_entries;
+  if(n >= index->size_entries){
+    index->size_entries *= 2;
+    index->entry_hash = realloc_tester(index->entry_hash, index->size_entries * sizeof(unsigned int));
+    index->entry_next = realloc_tester(index->entry_next, index->size_entries * sizeof(unsigned int));
+    index->entry_prev = realloc_tester(index->entry_prev, index->size_entries * sizeof(unsigned int));
+  }
+  index->entry_hash[n] = hash;
+  _link_sub_store_index_entry(index, n);
+  index->n_entries++;
+  if(index->n_entries > 2 * index->n_buckets)
+    _grow_sub_store_index(index);
+}
+
+/**
+   Removes all entries with number n_entries or higher.
+   Called when restoring a substitution store. 
+   Since the newest entries are last in each bucket, this 
+   takes time proportional to the number of removed entries
+**/
+void truncate_sub_store_index(sub_store_index* index, unsigned int n_entries){
+  while(index->n_entries > n_entries){
+    unsigned int n = index->n_entries - 1;
+    unsigned int b = index->entry_hash[n] & (index->n_buckets - 1);
+    unsigned int prev = index->entry_prev[n];
+    assert(index->bucket_last[b] == n);
+    index->bucket_last[b] = prev;
+    if(prev == SUB_STORE_INDEX_END)
+      index->bucket_first[b] = SUB_STORE_INDEX_END;
+    else
+      index->entry_next[prev] = SUB_STORE_INDEX_END;
+    index->n_entries--;
+  }
+}
+
+/**
+   Iteration over the entries with a given hash value, oldest first.
+   Returns SUB_STORE_INDEX_END when there are no more entries
+**/
+unsigned int _skip_sub_store_index(const sub_store_index* index, unsigned int n, unsigned int hash){
+  while(n != SUB_STORE_INDEX_END && index->entry_hash[n] != hash)
+    n = index->entry_next[n];
+  return n;
+}
+
+unsigned int first_sub_store_index(const sub_store_index* index, unsigned int hash){
+  return _skip_sub_store_index(index, index->bucket_first[hash & (index->n_buckets - 1)], hash);
+}
+
+unsigned int next_sub_store_index(const sub_store_index* index, unsigned int n, unsigned int hash){
+  assert(n < index->n_entries);
+  return _skip_sub_store_index(index, index->entry_next[n], hash);
+}
+
+/**
+   The occurrence index of constants in a substitution store
+**/
+sub_store_occurrences* init_sub_store_occurrences(void){
+  sub_store_occurrences* occ = malloc_tester(sizeof(sub_store_occurrences));
+  occ->n_subst = 0;
+  occ->n_constants = 0;
+  occ->n_occs = NULL;
+  occ->size_occs = NULL;
+  occ->occs = NULL;
+  return occ;
+}
+
+void destroy_sub_store_occurrences(sub_store_occurrences* occ){
+  unsigned int i;
+  for(i = 0; i < occ->n_constants; i++){
+    if(occ->occs[i] != NULL)
+      free(occ->occs[i]);
+  }
+  free(occ->n_occs);
+  free(occ->size_occs);
+  free(occ->occs);
+  free(occ);
+}
+
+/**
+   Appends sub_no to the list of constant c, unless it is already last. 
+   Entries for removed substitutions with higher numbers are removed first
+**/
+void _add_sub_store_occurrence(sub_store_occurrences* occ, unsigned int c, unsigned int sub_no){
+  unsigned int n;
+  if(c >= occ->n_constants){
+    unsigned int i, n_constants = (occ->n_constants == 0) ? 64 : occ->n_constants;
+    while(n_constants <= c)
+      n_constants *= 2;
+    occ->n_occs = realloc_tester(occ->n_occs, n_constants * sizeof(unsigned int));
+    occ->size_occs = realloc_tester(occ->size_occs, n_constants * sizeof(unsigned int));
+    occ->occs = realloc_tester(occ->occs, n_constants * sizeof(unsigned int*));
+    for(i = occ->n_constants; i < n_constants; i++){
+      occ->n_occs[i] = 0;
+      occ->size_occs[i] = 0;
+      occ->occs[i] = NULL;
+    }
+    occ->n_constants = n_constants;
+  }
+  n = occ->n_occs[c];
+  while(n > 0 && occ->occs[c][n-1] > sub_no)
+    n--;
+  occ->n_occs[c] = n;
+  if(n > 0 && occ->occs[c][n-1] == sub_no)
+    return;
+  if(n >= occ->size_occs[c]){
+    occ->size_occs[c] = (occ->size_occs[c] == 0) ? 4 : 2 * occ->size_occs[c];
+    occ->occs[c] = realloc_tester(occ->occs[c], occ->size_occs[c] * sizeof(unsigned int));
+  }
+  occ->occs[c][n] = sub_no;
+  occ->n_occs[c] = n + 1;
+}
+
+/**
+   Adds the constants in substitution number sub_no to the index.
+   Must be called for the substitutions in the order of their numbers
+**/
+void add_sub_store_occurrences(sub_store_occurrences* occ, unsigned int sub_no, const substitution* sub){
+  unsigned int i;
+  assert(sub_no == occ->n_subst);
+  for(i = 0; i < sub->allvars->n_vars; i++){
+    const clp_term* t = get_sub_value(sub, i);
+    if(t != NULL && t->type == constant_term)
+      _add_sub_store_occurrence(occ, t->val.constant.id, sub_no);
+  }
+  occ->n_subst = sub_no + 1;
+}
@@ -0,0 +1,106 @@
+/* substitution_store_index.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_SUBSTITUTION_STORE_INDEX_H
+#define __INCLUDED_SUBSTITUTION_STORE_INDEX_H
+
+#include "common.h"
+#include "substitution_struct.h"
+#include "constants_struct.h"
+
+#define INIT_SUB_STORE_INDEX_BUCKETS 64
+#define SUB_STORE_INDEX_END ((unsigned int) -1)
+
+/**
+   A hash index on the substitutions in a substitution_store. 
+
+   The key of a substitution is the values of the variables in vars. 
+   If literal is true, the constant ids are used, otherwise the roots 
+   of the equivalence classes of the constants. In the latter case
+   the index is only valid as long as version equals the version 
+   of the constants, and must otherwise be rebuilt.
+
+   The substitutions are referred to by their number in the store. 
+   Each bucket is a doubly linked list of substitution numbers, oldest first, 
+   such that iterating over a bucket gives the same order as iterating 
+   over the store. Since substitutions are only added at the end of the 
+   store, restoring a store backup only removes entries from the end 
+   of the bucket lists, see truncate_sub_store_index.
+
+   The index is also used by fact_store, with vars set to NULL and
+   the hash values calculated by the caller.
+
+   disabled is set if a substitution without values for all of vars is
+   added to an index that is not literal. The index is then not used anymore.
+   Literal indexes hash missing values as a special value, since 
+   literally_equal_substitutions treats two missing values as equal.
+**/
+typedef struct sub_store_index_t {
+  const freevars* vars;
+  bool literal;
+  bool disabled;
+  unsigned long version;
+  unsigned int n_buckets;
+  unsigned int * bucket_first;
+  unsigned int * bucket_last;
+  unsigned int n_entries;
+  unsigned int size_entries;
+  unsigned int * entry_hash;
+  unsigned int * entry_next;
+  unsigned int * entry_prev;
+} sub_store_index;
+
+/**
+   An index from constants to the substitutions in a substitution_store
+   that have the constant as the value of some variable. 
+   Used when rechecking the rete network after a new equality, 
+   such that only the substitutions containing a constant in the 
+   merged equivalence class are reinserted, see get_sub_store_class_iter.
+
+   occs[c] is an increasing list of the numbers of the substitutions containing the constant with id c.
+   n_subst is the number of substitutions in the store that have been indexed.
+
+   Restoring a store backup only lowers n_subst, the lists are not truncated. 
+   The lists may therefore contain numbers of substitutions that have been removed, 
+   or replaced by other substitutions. Such entries are removed from the end of
+   a list when a new substitution is added to it. The users of the index must therefore 
+   check that the substitutions found really contain the constants.
+**/
+typedef struct sub_store_occurrences_t {
+  unsigned int n_subst;
+  unsigned int n_constants;
+  unsigned int * n_occs;
+  unsigned int * size_occs;
+  unsigned int ** occs;
+} sub_store_occurrences;
+
+sub_store_index* init_sub_store_index(const freevars*, bool literal);
+void destroy_sub_store_index(sub_store_index*);
+void reset_sub_store_index(sub_store_index*, unsigned long version);
+bool hash_sub_store_index_key(const sub_store_index*, const substitution*, constants*, unsigned int*);
+void add_sub_store_index(sub_store_index*, unsigned int hash);
+void truncate_sub_store_index(sub_store_index*, unsigned int);
+unsigned int first_sub_store_index(const sub_store_index*, unsigned int hash);
+unsigned int next_sub_store_index(const sub_store_index*, unsigned int entry, unsigned int hash);
+
+sub_store_occurrences* init_sub_store_occurrences(void);
+void destroy_sub_store_occurrences(sub_store_occurrences*);
+void add_sub_store_occurrences(sub_store_occurrences*, unsigned int sub_no, const substitution*);
+#endif
@@ -0,0 +1,103 @@
+/* symbol_table.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   The names read by the parser. See symbol_table.h
+**/
+#include "common.h"
+#include "symbol_table.h"
+
+symbol_table* init_symbol_table(void){
+  symbol_table* table = malloc_tester(sizeof(symbol_table));
+  table->size_table = SYMBOL_TABLE_INIT_SIZE;
+  table->n_symbols = 0;
+  table->symbols = calloc_tester(table->size_table, sizeof(symbol));
+  table->names = init_arena(ARENA_BLOCK_SIZE);
+  return table;
+}
+
+/**
+   Frees the table and the names. Called from delete_theory
+**/
+void destroy_symbol_table(symbol_table* table){
+  destroy_arena(table->names);
+  free(table->symbols);
+  free(table);
+}
+
+unsigned int hash_symbol_name(const char* name, size_t length){
+  size_t i;
+  unsigned int h = 2166136261u;
+  for(i = 0; i < length; i++)
+    h = (h ^ (unsigned char) name[i]) * 16777619u;
+  return h;
+}
+
+/**
+   Doubles the size of the hash table
+**/
+void grow_symbol_table(symbol_table* table){
+  size_t i;
+  size_t old_size = table->size_table;
+  symbol* old_symbols = table->symbols;
+  table->size_table *= 2;
+  table->symbols = calloc_tester(table->size_table, sizeof(symbol));
+  for(i = 0; i < old_size; i++){
+    if(old_symbols[i].name != NULL){
+      size_t pos = old_symbols[i].hash & (table->size_table - 1);
+      while(table->symbols[pos].name != NULL)
+	pos = (pos + 1) & (table->size_table - 1);
+      table->symbols[pos] = old_symbols[i];
+    }
+  }
+  free(old_symbols);
+}
+
+/**
+   Returns the symbol with the name given by the length characters starting at name, 
+   which need not be terminated by '\0'. The name is copied the first time it is seen.
+
+   The returned pointer is only valid until the next call, since the table may be moved. 
+   The name of the symbol is valid until the table is destroyed.
+**/
+symbol* intern_symbol(symbol_table* table, const char* name, size_t length){
+  unsigned int hash = hash_symbol_name(name, length);
+  size_t pos = hash & (table->size_table - 1);
+  symbol* s;
+  while(table->symbols[pos].name != NULL){
+    s = & table->symbols[pos];
+    if(s->hash == hash && s->length == length && memcmp(s->name, name, length) == 0)
+      return s;
+    pos = (pos + 1) & (table->size_table - 1);
+  }
+  if(2 * (table->n_symbols + 1) > table->size_table){
+    grow_symbol_table(table);
+    pos = hash & (table->size_table - 1);
+    while(table->symbols[pos].name != NULL)
+      pos = (pos + 1) & (table->size_table - 1);
+  }
+  s = & table->symbols[pos];
+  s->name = arena_strndup(table->names, name, length);
+  s->length = length;
+  s->hash = hash;
+  s->is_predicate = false;
+  s->is_constant = false;
+  table->n_symbols++;
+  return s;
+}
@@ -0,0 +1,65 @@
+/* symbol_table.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+#ifndef __INCLUDED_SYMBOL_TABLE_H
+#define __INCLUDED_SYMBOL_TABLE_H
+
+#include "common.h"
+#include "arena.h"
+
+#define SYMBOL_TABLE_INIT_SIZE 1024
+
+/**
+   A name read by the parser. Each name is stored only once, 
+   such that two symbols are equal if and only if their names are the same pointer.
+
+   If is_predicate is true, pred_no is the number of the first predicate with this name 
+   in the theory, see parser_new_predicate. 
+   If is_constant is true, constant_no is the id of the constant with this name, see parser_create_constant_term.
+**/
+typedef struct symbol_t {
+  const char* name;
+  size_t length;
+  unsigned int hash;
+  bool is_predicate;
+  unsigned int pred_no;
+  bool is_constant;
+  unsigned int constant_no;
+} symbol;
+
+/**
+   The names in a theory. The lexers intern the names of the tokens directly from the input, 
+   such that each name is copied only once, and not for every occurrence.
+
+   symbols is an open addressing hash table with linear probing, and size_table is a power of 2. 
+   Empty entries have name NULL. The names are allocated in the arena names, 
+   and live until the theory is deleted.
+   The table is only used by the parser, and is not locked.
+**/
+typedef struct symbol_table_t {
+  symbol* symbols;
+  size_t size_table;
+  size_t n_symbols;
+  arena* names;
+} symbol_table;
+
+symbol_table* init_symbol_table(void);
+void destroy_symbol_table(symbol_table*);
+symbol* intern_symbol(symbol_table*, const char*, size_t);
+#endif
@@ -58,7 +58,7 @@ typedef struct term_list_t term_list;
 
 
 clp_term* create_function_term(const char*, const term_list*);
-clp_term* prover_create_constant_term(dom_elem);
+clp_term* prover_create_constant_term(dom_elem, arena*);
 
 clp_term* copy_term(const clp_term*);
 term_list* copy_term_list(const term_list*);
@@ -85,5 +85,7 @@ void print_geolog_term(const clp_term*, const constants*, FILE*);
 void print_geolog_term_list(const term_list*, const constants*, FILE*);
 
 bool equal_terms(const clp_term*, const clp_term*, constants*, timestamps*, timestamp_store*, bool update_ts);
+unsigned int hash_term(const clp_term*, constants*, bool literal);
+unsigned int hash_term_list(const term_list*, constants*, bool literal);
 bool literally_equal_terms(const clp_term*, const clp_term*, constants*, timestamps*, timestamp_store*, bool update_ts);
 #endif
@@ -57,6 +57,7 @@ theory* create_theory(void){
 
 
   ret_val->constants = init_constants(100);
+  ret_val->symbols = init_symbol_table();
 
   ret_val->vars = init_freevars();
   ret_val->name = NULL;
@@ -89,7 +90,8 @@ void extend_theory(theory *th, clp_axiom *ax){
 
   assert(!th->finalized);
   if(!ax->has_name){
-    char* axname = malloc_tester(10 + abs(log10(th->n_axioms)));
+    // log10 is -infinity for the first axiom
+    char* axname = malloc_tester(10 + (th->n_axioms > 0 ? (unsigned int) log10(th->n_axioms) : 0));
     sprintf(axname, "axiom_%i", th->n_axioms);
     set_axiom_name(ax, axname);
   }
@@ -119,6 +121,7 @@ void delete_theory(theory* t){
     free(t->predicates[i]);
   free(t->predicates);
   del_freevars(t->vars);
+  destroy_symbol_table(t->symbols);
   if(t->name != NULL)
     free(t->name);
   free(t);
@@ -166,17 +169,38 @@ void finalize_theory(theory* th){
 #endif
 }
 
+/**
+   Returns an array indexed by pred_no with the number of facts with each predicate
+   in the initial model. Used by the join planner. Must be freed by the caller.
+**/
+unsigned int* count_static_facts(const theory* th){
+  unsigned int i, j;
+  unsigned int* counts = calloc_tester(th->n_predicates, sizeof(unsigned int));
+  for(i = 0; i < th->n_init_model; i++){
+    const clp_conjunction* fact = th->init_model[i];
+    for(j = 0; j < fact->n_args; j++)
+      counts[fact->args[j]->pred->pred_no]++;
+  }
+  return counts;
+}
+
 /**
    Creates new rete network for the whole theory
 
 **/
-rete_net* create_rete_net(const theory* th, unsigned long maxsteps, bool existdom, strategy strat, bool lazy, bool coq, bool use_beta_not, bool factset_lhs, bool print_model, bool all_disjuncts, bool verbose, bool multithread_rete){
+rete_net* create_rete_net(const theory* th, unsigned long maxsteps, bool existdom, strategy strat, bool lazy, bool coq, bool use_beta_not, bool factset_lhs, bool print_model, bool all_disjuncts, bool verbose, bool multithread_rete, unsigned int n_rete_threads, bool plan_joins){
 #ifdef HAVE_PTHREAD
   pthread_mutexattr_t p_attr;
 #endif
   unsigned int i;
-  rete_net* net = init_rete(th, maxsteps, lazy, coq, multithread_rete);
+  rete_net* net = init_rete(th, maxsteps, lazy, coq, multithread_rete, n_rete_threads);
   assert(th->finalized);
+  // The coq proofs are written with the premisses of the rule instances in the order of the lhs
+  assert(!(plan_joins && coq));
+  if(plan_joins){
+    net->plan_joins = true;
+    net->static_fact_counts = count_static_facts(th);
+  }
   net->rule_nodes = calloc_tester(th->n_axioms, sizeof(rete_node*));
   for(i = 0; i < th->n_axioms; i++){
 #ifndef NDEBUG
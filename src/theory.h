@@ -27,12 +27,16 @@
 #include "term.h"
 #include "atom.h"
 #include "substitution_size_info.h"
+#include "symbol_table.h"
 
 
 /**
    max_lhs_conjuncts is the maximum number of conjuncts in the left hand side
    of any axiom. This is nice to have for the subsitution timestamp lists, since we
    then know the exact size
+
+   symbols has the names of the predicates, constants, functions and variables, 
+   which are interned by the lexers, see symbol_table.h
 **/
 typedef struct theory_t {
   const clp_axiom** axioms;
@@ -58,6 +62,7 @@ typedef struct theory_t {
   bool finalized;
 #endif
   constants* constants;
+  symbol_table* symbols;
 } theory;
 
 
@@ -66,6 +71,7 @@ void extend_theory(theory*, clp_axiom*);
 void set_theory_name(theory*, const char*);
 bool has_theory_name(const theory*);
 void finalize_theory(theory*);
+unsigned int* count_static_facts(const theory*);
 
 void print_coq_proof_intro(const theory*, const constants*, FILE*);
 void print_coq_proof_ending(const theory*, FILE*);
@@ -23,7 +23,7 @@
    track of the steps at which the left-hand side were first inferred.
 
    Included from timestamp_list _if_ USE_TIMESTAMP_ARRAY is defined in common.h
-   Otherwise, timestamp_linked_list is used
+   Otherwise, timestamp_vector is used
 **/
 #include "common.h"
 #include "timestamp_array_struct.h"
@@ -168,5 +168,7 @@ timestamp_store_backup backup_timestamp_store(timestamp_store* ts){
 timestamp_store* restore_timestamp_store(timestamp_store_backup b){
   return (timestamp_store*) NULL;
 }
+void destroy_timestamp_store_backup(timestamp_store_backup* b){
+}
 void destroy_timestamp_store(timestamp_store* ts){
 }
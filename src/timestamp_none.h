@@ -0,0 +1,100 @@
+/* timestamp_none.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2012 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Included from timestamps.h if NO_TIMESTAMPS is defined, 
+   by "configure --disable-timestamps". 
+
+   No timestamps are kept. All the timestamp functions are 
+   empty and inlined, such that the bookkeeping in the rete network, 
+   the substitutions and the union-find of the constants disappears 
+   at compile time. The timestamps are needed for the proof output (-q, -p), 
+   which is then not available, and for knowing which disjunctive steps 
+   were used in a proof. All disjuncts are therefore treated, see main.c
+
+   compare_timestamps always returns 0, so the sorted rule queues 
+   of the CL.pl strategy are ordered by insertion only.
+**/
+#ifndef __INCLUDED_TIMESTAMP_NONE_H
+#define __INCLUDED_TIMESTAMP_NONE_H
+
+#include "common.h"
+#include "timestamp.h"
+#include "substitution_size_info.h"
+
+#ifndef NO_TIMESTAMPS
+#abort
+#endif
+
+typedef struct timestamps_t {
+} timestamps;
+
+typedef struct timestamps_iter_t {
+} timestamps_iter;
+
+typedef struct timestamp_store_t {
+  unsigned int id;
+} timestamp_store;
+
+typedef struct timestamp_store_backup_t {
+  timestamp_store* store;
+} timestamp_store_backup;
+
+static inline void init_empty_timestamp_vector(timestamps* ts, bool permanent){ }
+static inline void init_empty_timestamps(timestamps* ts, substitution_size_info ssi){ }
+static inline unsigned int get_n_timestamps(const timestamps* ts){ return 0; }
+
+static inline void add_normal_timestamp(timestamps* ts, unsigned int step, timestamp_store* store){ }
+static inline void add_equality_timestamp(timestamps* ts, unsigned int step, timestamp_store* store, bool normal_rewrite){ }
+static inline void add_reflexivity_timestamp(timestamps* ts, unsigned int step, timestamp_store* store){ }
+static inline void add_domain_timestamp(timestamps* ts, unsigned int step, timestamp_store* store){ }
+static inline void add_timestamp(timestamps* ts, timestamp t, timestamp_store* store){ }
+static inline void add_timestamps(timestamps* dest, const timestamps* orig, timestamp_store* store){ }
+
+static inline void copy_timestamps(timestamps* dest, const timestamps* orig, timestamp_store* store, bool permanent){ }
+static inline int compare_timestamps(const timestamps* first, const timestamps* last){ return 0; }
+#ifndef NDEBUG
+static inline bool test_timestamps(const timestamps* ts){ return true; }
+#endif
+
+static inline timestamps_iter get_timestamps_iter(const timestamps* ts){ 
+  timestamps_iter iter;
+  return iter;
+}
+static inline bool has_next_timestamps_iter(const timestamps_iter* iter){ return false; }
+static inline bool has_next_non_eq_timestamps_iter(const timestamps_iter* iter){ return false; }
+static inline timestamp get_next_timestamps_iter(timestamps_iter* iter){ 
+  timestamp t = create_normal_timestamp(0);
+  assert(false);
+  return t;
+}
+static inline void destroy_timestamps_iter(timestamps_iter* iter){ }
+
+static inline timestamp_store_backup backup_timestamp_store(timestamp_store* store){ 
+  timestamp_store_backup b;
+  b.store = store;
+  return b;
+}
+static inline timestamp_store* restore_timestamp_store(timestamp_store_backup b){ return b.store; }
+static inline void destroy_timestamp_store_backup(timestamp_store_backup* b){ }
+
+timestamp_store* init_timestamp_store(substitution_size_info);
+void destroy_timestamp_store(timestamp_store*);
+#endif
@@ -19,17 +19,9 @@
 
 /*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
 /**
-   Arrays of timestamps are used in substitutions, to keep
-   track of the steps at which the left-hand side were first inferred.
+   The memory for the timestamp blocks used by timestamp_vector.c
 
-   Included from timestamp_list _if_ USE_TIMESTAMP_ARRAY is defined in common.h
-   Otherwise, timestamp_linked_list is used
-
-   If there are n timestamps, there are n elements in the linked list. The oldest/first inserted has next pointer NULL
-   the other n-1 have valid next pointer.
-   
-   New timestamps are added at the end "list"
-   But union of timestamps is done by concatenation, so the order of the timestamps is not necessarily timestamp-ordered
+   Not used if USE_TIMESTAMP_ARRAY is defined in common.h
 **/
 #include "common.h"
 #include "timestamps.h"
@@ -40,44 +32,162 @@
 #ifdef HAVE_PTHREAD
 #include <pthread.h>
 #endif
-#ifndef USE_TIMESTAMP_ARRAY
+#if !defined(USE_TIMESTAMP_ARRAY) && !defined(NO_TIMESTAMPS)
 
+/**
+   Used to give each store a unique id, such that a thread does not use a cached
+   arena belonging to a destroyed store at the same address
+**/
+static unsigned int timestamp_store_id_counter = 0;
 
-timestamp_linked_list* get_timestamp_memory(timestamp_store* store, bool permanent){
-  timestamp_linked_list* retval;
-  if(permanent)
-    return malloc_tester(sizeof(timestamp_linked_list));
+#ifdef USE_TIMESTAMP_STORE_ARRAY
 #ifdef HAVE_PTHREAD
+/**
+   The arena last used by this thread, and the id of its store. 
+   The id is kept outside the arena, since the arena is freed with its store
+**/
+static __thread timestamp_arena* thread_arena = NULL;
+static __thread unsigned int thread_arena_store_id = 0;
+#endif
+
+unsigned int timestamp_arena_chunk_size(unsigned int chunk_no){
+  if(chunk_no > TIMESTAMP_ARENA_MAX_SHIFT)
+    chunk_no = TIMESTAMP_ARENA_MAX_SHIFT;
+  return TIMESTAMP_ARENA_FIRST_CHUNK << chunk_no;
+}
+
+timestamp_arena* init_timestamp_arena(timestamp_store* store){
+  timestamp_arena* arena = malloc_tester(sizeof(timestamp_arena));
+#ifdef HAVE_PTHREAD
+  arena->owner = pthread_self();
+#endif
+  arena->store_id = store->id;
+  arena->cur_chunk = 0;
+  arena->n_used = 0;
+  arena->n_chunks = 1;
+  arena->size_chunks = 4;
+  arena->chunks = malloc_tester(arena->size_chunks * sizeof(timestamp*));
+  arena->chunk_sizes = malloc_tester(arena->size_chunks * sizeof(unsigned int));
+  arena->chunk_sizes[0] = timestamp_arena_chunk_size(0);
+  arena->chunks[0] = calloc_tester(arena->chunk_sizes[0], sizeof(timestamp));
+  return arena;
+}
+
+void destroy_timestamp_arena(timestamp_arena* arena){
+  unsigned int i;
+  for(i = 0; i < arena->n_chunks; i++)
+    free(arena->chunks[i]);
+  free(arena->chunks);
+  free(arena->chunk_sizes);
+  free(arena);
+}
+
+/**
+   Returns the arena of the calling thread, registering a new one in the store
+   the first time the thread allocates from this store. 
+**/
+timestamp_arena* get_timestamp_arena(timestamp_store* store){
+#ifdef HAVE_PTHREAD
+  unsigned int i;
+  timestamp_arena* arena = NULL;
+  pthread_t self;
+  if(thread_arena != NULL && thread_arena_store_id == store->id)
+    return thread_arena;
+  self = pthread_self();
   pt_err(pthread_mutex_lock(& store->lock), __FILE__, __LINE__, ": mutex lock");
+  for(i = 0; i < store->n_arenas; i++){
+    if(pthread_equal(store->arenas[i]->owner, self)){
+      arena = store->arenas[i];
+      break;
+    }
+  }
+  if(arena == NULL){
+    arena = init_timestamp_arena(store);
+    if(store->n_arenas >= store->size_arenas){
+      store->size_arenas *= 2;
+      store->arenas = realloc_tester(store->arenas, store->size_arenas * sizeof(timestamp_arena*));
+    }
+    store->arenas[store->n_arenas] = arena;
+    store->n_arenas++;
+  }
+  pt_err(pthread_mutex_unlock(& store->lock), __FILE__, __LINE__, ": mutex unlock");
+  thread_arena = arena;
+  thread_arena_store_id = store->id;
+  return arena;
+#else
+  return store->arenas[0];
 #endif
-#ifdef USE_TIMESTAMP_STORE_ARRAY
-  if(store->n_timestamp_store >= store->size_timestamp_store){
-    store->n_stores++;
-    store->n_timestamp_store = 0;
-    while(store->n_stores >= store->size_stores){
-      unsigned int i;
-      unsigned int new_size_stores = store->size_stores * 2;
-      store->stores = realloc_tester(store->stores, new_size_stores * sizeof(timestamp_linked_list*));
-      for(i = store->size_stores; i < new_size_stores; i++)
-	store->stores[i] = calloc_tester((store->size_timestamp_store + 1), sizeof(timestamp_linked_list));
-      store->size_stores = new_size_stores;
+}
+
+/**
+   Moves the arena to the next chunk with room for n_elems elements, allocating it if necessary. 
+   A reused chunk that is too small is replaced.
+**/
+void next_timestamp_arena_chunk(timestamp_arena* arena, unsigned int n_elems){
+  unsigned int size;
+  arena->cur_chunk++;
+  arena->n_used = 0;
+  if(arena->cur_chunk >= arena->n_chunks){
+    if(arena->n_chunks >= arena->size_chunks){
+      arena->size_chunks *= 2;
+      arena->chunks = realloc_tester(arena->chunks, arena->size_chunks * sizeof(timestamp*));
+      arena->chunk_sizes = realloc_tester(arena->chunk_sizes, arena->size_chunks * sizeof(unsigned int));
     }
-    assert(store->n_stores < store->size_stores);
+    arena->chunks[arena->n_chunks] = NULL;
+    arena->chunk_sizes[arena->n_chunks] = 0;
+    arena->n_chunks++;
   }
-  retval =  & store->stores[store->n_stores][store->n_timestamp_store];
-  assert(retval != NULL);
-  store->n_timestamp_store++;
+  if(arena->chunk_sizes[arena->cur_chunk] < n_elems){
+    size = timestamp_arena_chunk_size(arena->cur_chunk);
+    if(size < n_elems)
+      size = n_elems;
+    free(arena->chunks[arena->cur_chunk]);
+    arena->chunks[arena->cur_chunk] = calloc_tester(size, sizeof(timestamp));
+    arena->chunk_sizes[arena->cur_chunk] = size;
+  }
+  assert(arena->cur_chunk < arena->n_chunks);
+}
+#endif
+
+/**
+   The number of timestamp elements taking up the memory of a block with size elements
+**/
+unsigned int timestamp_block_n_elems(unsigned int size){
+  return (sizeof(timestamp_block) + size * sizeof(timestamp) + sizeof(timestamp) - 1) / sizeof(timestamp);
+}
+
+/**
+   Returns memory for a timestamp block with room for size timestamps. 
+   The caller sets the header of the block.
+**/
+timestamp_block* get_timestamp_memory(timestamp_store* store, unsigned int size, bool permanent){
+  timestamp_block* retval;
+  unsigned int n_elems = timestamp_block_n_elems(size);
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  timestamp_arena* arena;
+#endif
+  if(permanent)
+    return malloc_tester(n_elems * sizeof(timestamp));
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  arena = get_timestamp_arena(store);
+  if(arena->n_used + n_elems > arena->chunk_sizes[arena->cur_chunk])
+    next_timestamp_arena_chunk(arena, n_elems);
+  retval = (timestamp_block*) & arena->chunks[arena->cur_chunk][arena->n_used];
+  arena->n_used += n_elems;
 #else
-  retval = malloc_tester(sizeof(timestamp_linked_list));
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& store->lock), __FILE__, __LINE__, ": mutex lock");
+#endif
+  retval = malloc_tester(n_elems * sizeof(timestamp));
   if(store->n_timestamp_store >= store->size_timestamp_store){
     store->size_timestamp_store *= 2;
-    store->stores = realloc(store->stores, sizeof(timestamp_linked_list*) * store->size_timestamp_store);
+    store->stores = realloc(store->stores, sizeof(timestamp_block*) * store->size_timestamp_store);
   }
   store->stores[store->n_timestamp_store] = retval;
   store->n_timestamp_store++;
-#endif
 #ifdef HAVE_PTHREAD
   pthread_mutex_unlock(& store->lock);
+#endif
 #endif
   assert(retval != NULL);
   return retval;
@@ -87,8 +197,9 @@ timestamp_linked_list* get_timestamp_memory(timestamp_store* store, bool permane
 /**
    Called from rete_state_single. 
    
-   timestamps are in a double array, size_timestamp_store must never be changed after initializing,
-   while size_stores is changed whenever more memory is needed
+   With USE_TIMESTAMP_STORE_ARRAY, each thread gets its own arena the first
+   time it allocates. The arena for the calling thread is created here. 
+   Without pthreads there is only this arena.
 **/
 timestamp_store* init_timestamp_store(substitution_size_info ssi){
   timestamp_store* ts = malloc_tester(sizeof(timestamp_store));
@@ -98,17 +209,20 @@ timestamp_store* init_timestamp_store(substitution_size_info ssi){
 #ifndef NDEBUG
   pt_err(pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK_NP), __FILE__, __LINE__,  "rule_queue_single.c: initialize_queue_single: mutex attr settype");
 #endif
-  pt_err(pthread_mutex_init(& ts->lock, &mutex_attr), __FILE__, __LINE__, "timestamp_linked_list.c: init_timestamp_store: mutex init.\n");
+  pt_err(pthread_mutex_init(& ts->lock, &mutex_attr), __FILE__, __LINE__, "timestamp_store.c: init_timestamp_store: mutex init.\n");
+  ts->id = __sync_add_and_fetch(& timestamp_store_id_counter, 1);
+#else
+  ts->id = ++timestamp_store_id_counter;
 #endif
-  ts->size_timestamp_store = 1;
-  ts->n_timestamp_store = 0;
 #ifdef USE_TIMESTAMP_STORE_ARRAY
-  ts->size_stores = 1;
-  ts->n_stores = 0;
-  ts->stores = malloc_tester(ts->size_stores * sizeof(timestamp_linked_list*));
-  ts->stores[0] = calloc_tester(ts->size_timestamp_store + 1, sizeof(timestamp_linked_list));
+  ts->size_arenas = 4;
+  ts->arenas = malloc_tester(ts->size_arenas * sizeof(timestamp_arena*));
+  ts->arenas[0] = init_timestamp_arena(ts);
+  ts->n_arenas = 1;
 #else
-  ts->stores = calloc_tester(ts->size_timestamp_store + 1, sizeof(timestamp_linked_list*));
+  ts->size_timestamp_store = 1;
+  ts->n_timestamp_store = 0;
+  ts->stores = calloc_tester(ts->size_timestamp_store + 1, sizeof(timestamp_block*));
 #endif
   return ts;
 }
@@ -126,36 +240,82 @@ void backtrack_timestamp_store(timestamp_store* store, unsigned int limit){
 void destroy_timestamp_store(timestamp_store* store){
 #ifdef USE_TIMESTAMP_STORE_ARRAY
   unsigned int i;
-  for(i = 0; i < store->size_stores; i++)
-    free(store->stores[i]);
+  for(i = 0; i < store->n_arenas; i++)
+    destroy_timestamp_arena(store->arenas[i]);
+  free(store->arenas);
 #else
   backtrack_timestamp_store(store, 0);
+  free(store->stores);
 #endif
 #ifdef HAVE_PTHREAD
   pt_err(pthread_mutex_destroy(& store->lock), __FILE__, __LINE__, ": mutexdestroy");;
 #endif
-  free(store->stores);
   free(store);
 }
 
+/**
+   Must only be called when no other thread allocates from the store, 
+   that is, when the rete workers are paused
+**/
 timestamp_store_backup backup_timestamp_store(timestamp_store* ts){
   timestamp_store_backup b;
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  unsigned int i;
+#endif
   b.store = ts;
-  b.n_timestamp_store = ts->n_timestamp_store;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& ts->lock), __FILE__, __LINE__, ": mutex lock");
+#endif
 #ifdef USE_TIMESTAMP_STORE_ARRAY
-  b.n_stores = ts->n_stores;
+  b.n_arenas = ts->n_arenas;
+  b.marks = malloc_tester(b.n_arenas * sizeof(timestamp_arena_mark));
+  for(i = 0; i < b.n_arenas; i++){
+    b.marks[i].cur_chunk = ts->arenas[i]->cur_chunk;
+    b.marks[i].n_used = ts->arenas[i]->n_used;
+  }
+#else
+  b.n_timestamp_store = ts->n_timestamp_store;
 #endif  
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& ts->lock), __FILE__, __LINE__, ": mutex unlock");
+#endif
   return b;
-
 }
+
+/**
+   Truncates each arena to its position at the backup. 
+   Arenas registered after the backup are emptied.
+   Must only be called when the rete workers are paused
+**/
 timestamp_store* restore_timestamp_store(timestamp_store_backup b){
 #ifdef USE_TIMESTAMP_STORE_ARRAY
-  b.store->n_timestamp_store = b.n_timestamp_store;
-  b.store->n_stores = b.n_stores;
+  unsigned int i;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& b.store->lock), __FILE__, __LINE__, ": mutex lock");
+#endif
+  for(i = 0; i < b.store->n_arenas; i++){
+    timestamp_arena* arena = b.store->arenas[i];
+    if(i < b.n_arenas){
+      arena->cur_chunk = b.marks[i].cur_chunk;
+      arena->n_used = b.marks[i].n_used;
+    } else {
+      arena->cur_chunk = 0;
+      arena->n_used = 0;
+    }
+  }
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& b.store->lock), __FILE__, __LINE__, ": mutex unlock");
+#endif
 #else
   backtrack_timestamp_store(b.store, b.n_timestamp_store);
 #endif
   return b.store;
 }
 
+void destroy_timestamp_store_backup(timestamp_store_backup* b){
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  free(b->marks);
+#endif
+}
+
 #endif
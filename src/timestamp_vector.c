@@ -0,0 +1,218 @@
+/* timestamp_vector.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Vectors of timestamps are used in substitutions, to keep
+   track of the steps at which the left-hand side were first inferred.
+
+   Included from timestamps.c _unless_ USE_TIMESTAMP_ARRAY is defined in common.h
+
+   The timestamps are kept in insertion order, oldest first, in a block of memory 
+   from the timestamp store. Union of timestamps is done by concatenation, 
+   so the order of the timestamps is not necessarily timestamp-ordered. 
+   The proof writer depends on this order.
+
+   Copies share the block. A block is extended in place by the first
+   timestamps appending to it, and copied by the others, see timestamp_vector.h
+**/
+#include "common.h"
+#ifdef USE_TIMESTAMP_ARRAY
+#abort
+#endif
+#include "timestamps.h"
+#include "term.h"
+#include "substitution.h"
+#include "rule_instance.h"
+#include "error_handling.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+
+#ifndef NDEBUG
+bool test_timestamps(const timestamps* ts){
+  assert(ts->n_timestamps == 0 || ts->block != NULL);
+  assert(ts->block == NULL || (ts->n_timestamps <= ts->block->n_used && ts->block->n_used <= ts->block->size));
+  return true;
+}
+#endif
+
+/**
+   Initializes already allocated timestamps
+**/
+void init_empty_timestamp_vector(timestamps* ts, bool permanent){
+  ts->block = NULL;
+  ts->n_timestamps = 0;
+  ts->permanent = permanent;
+}
+void init_empty_timestamps(timestamps* ts, substitution_size_info ssi){
+  init_empty_timestamp_vector(ts, false);
+}
+
+
+timestamp get_oldest_timestamp(timestamps* ts){
+  assert(ts != NULL && ts->n_timestamps > 0);
+  return ts->block->elems[0];
+}
+
+timestamps_iter get_timestamps_iter(const timestamps* ts){
+  timestamps_iter iter;
+  iter.ts = ts;
+  iter.n = 0;
+  return iter;
+}
+
+bool has_next_timestamps_iter(const timestamps_iter* iter){
+  return iter->n < iter->ts->n_timestamps;
+}
+
+bool has_next_non_eq_timestamps_iter(const timestamps_iter* iter){
+  return iter->n < iter->ts->n_timestamps && !is_equality_timestamp(iter->ts->block->elems[iter->n]);
+}
+
+timestamp get_next_timestamps_iter(timestamps_iter* iter){
+  assert(iter != NULL && iter->n < iter->ts->n_timestamps);
+  return iter->ts->block->elems[iter->n++];
+}
+
+void destroy_timestamps_iter(timestamps_iter* iter){
+  ;
+}
+ 
+unsigned int get_n_timestamps(const timestamps* ts){
+  return ts->n_timestamps;
+}
+
+/**
+   Makes room for n_new more timestamps at the end of ts. 
+
+   The block is extended in place if there is room and no other timestamps 
+   has appended to it. Otherwise a new block is allocated, and the timestamps 
+   of ts copied to it. The new block has room for TIMESTAMP_BLOCK_INIT_SIZE 
+   more timestamps, since equality steps are often added one by one after a copy, 
+   or twice the room if the old block was full. 
+**/
+void reserve_timestamps(timestamps* ts, unsigned int n_new, timestamp_store* store){
+  timestamp_block* new_block;
+  unsigned int size, n = ts->n_timestamps;
+  if(ts->block != NULL && n + n_new <= ts->block->size){
+#ifdef HAVE_PTHREAD
+    if(__sync_bool_compare_and_swap(& ts->block->n_used, n, n + n_new))
+      return;
+#else
+    if(ts->block->n_used == n){
+      ts->block->n_used = n + n_new;
+      return;
+    }
+#endif
+  }
+  if(ts->block != NULL && ts->block->n_used == n)
+    size = 2 * (n + n_new);
+  else
+    size = n + n_new + TIMESTAMP_BLOCK_INIT_SIZE;
+  new_block = get_timestamp_memory(store, size, ts->permanent);
+  new_block->size = size;
+  new_block->n_used = n + n_new;
+  if(n > 0)
+    memcpy(new_block->elems, ts->block->elems, n * sizeof(timestamp));
+  ts->block = new_block;
+}
+
+/**
+   Adds a single timestamp.
+
+   Necessary for the output of correct coq proofs
+**/
+void add_timestamp(timestamps* ts, timestamp t, timestamp_store* store){  
+  unsigned int n = ts->n_timestamps;
+  reserve_timestamps(ts, 1, store);
+  ts->block->elems[n] = t;
+  ts->n_timestamps = n + 1;
+  assert(test_timestamps(ts));
+}
+
+/**
+   Adds the timestamps in orig to those in dest.
+   Called from union_substitutions_struct_with_ts in substitution.c
+**/
+void add_timestamps(timestamps* dest, const timestamps* orig, timestamp_store* store){
+  unsigned int n = dest->n_timestamps;
+  assert(test_timestamps(dest));
+  assert(test_timestamps(orig));
+  if(orig->n_timestamps == 0)
+    return;
+  if(n == 0 && (orig->permanent || !dest->permanent)){
+    dest->block = orig->block;
+    dest->n_timestamps = orig->n_timestamps;
+    return;
+  }
+  reserve_timestamps(dest, orig->n_timestamps, store);
+  memcpy(dest->block->elems + n, orig->block->elems, orig->n_timestamps * sizeof(timestamp));
+  dest->n_timestamps = n + orig->n_timestamps;
+  assert(test_timestamps(dest));
+}
+
+/**
+   Called from copy_substitution_struct in substitution.c
+
+   Shares the block of orig, unless dest is permanent and orig is not.
+**/
+void copy_timestamps(timestamps* dest, const timestamps* orig, timestamp_store* store, bool permanent){
+  init_empty_timestamp_vector(dest, permanent);
+  add_timestamps(dest, orig, store);
+}
+/**
+   Internal function for comparing timestamps on a substition
+
+   They correspond to the times at which the matching for each conjunct
+   was introduced to the factset
+
+   Returns positive if first is larger(newer) than last, negative if oldest is smaller(older) than last,
+   and 0 if they are equal. 
+   The timestamps are compared newest first. 
+**/
+int compare_timestamps(const timestamps* first, const timestamps* last){
+  unsigned int i = first->n_timestamps, j = last->n_timestamps;
+  while(i > 0){
+    assert(j > 0);
+    i--;
+    j--;
+    if(first->block->elems[i].step != last->block->elems[j].step)
+      return first->block->elems[i].step - last->block->elems[j].step;
+  }
+  assert(j == 0);
+  return 0;
+}
+
+/**
+   Discovers how much space is needed for the timestmaps, substitutions and rule instances
+
+   This is declared in substitution_size_info.h
+**/
+substitution_size_info init_sub_size_info(unsigned int n_vars, unsigned int max_lhs_conjuncts){
+  substitution_size_info ssi;
+  unsigned int size_vars;
+  ssi.max_n_timestamps = max_lhs_conjuncts + 1;
+  size_vars = n_vars * sizeof(clp_term*);
+  ssi.size_substitution = sizeof(substitution) + size_vars;
+  ssi.size_rule_instance = sizeof(rule_instance) + size_vars;
+  ssi.sub_values_offset =  0;
+  return ssi;
+}
@@ -0,0 +1,161 @@
+/* timestamp_vector.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011-2012 by Dag Hovland, hovlanddag@gmail.com  */
+/**
+   Included from timestamps.h, depending on USE_TIMESTAMP_ARRAY, defined in common.h
+**/
+#ifndef __INCLUDED_TIMESTAMP_VECTOR_H
+#define __INCLUDED_TIMESTAMP_VECTOR_H
+
+#include "common.h"
+#include "timestamp.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+// This file should not have been included if USE_TIMESTAMP_ARRAY was defined
+// Defined in common.h. 
+#ifdef USE_TIMESTAMP_ARRAY
+#abort
+#endif
+
+
+/**
+   Used to keep info about the steps that were necessary to infer a fact
+**/
+
+/**
+   The memory of a timestamp vector. size is the number of elements 
+   allocated after the header, and n_used the number of these written.
+
+   A block may be shared by several timestamps, each seeing the first 
+   n_timestamps elements. Elements are only written once, by the timestamps 
+   that increase n_used, see add_timestamp. The block is therefore only 
+   appended to in place by a timestamps with n_timestamps equal to n_used, 
+   the others copy it first. 
+**/
+typedef struct timestamp_block_t {
+  unsigned int n_used;
+  unsigned int size;
+  timestamp elems[];
+} timestamp_block;
+
+/**
+   The timestamps are the first n_timestamps elements of block, oldest first. 
+   block is NULL if there are no timestamps.
+
+   Copying is done by sharing the block, see copy_timestamps. 
+   Plain struct assignment is also a valid copy, as used by the 
+   trail in constants.c
+**/
+typedef struct timestamps_t {
+  timestamp_block* block;
+  unsigned int n_timestamps;
+  bool permanent;
+} timestamps;
+
+typedef struct timestamps_iter_t {
+  const timestamps* ts;
+  unsigned int n;
+} timestamps_iter;
+
+/**
+   The number of free elements in a new block of a timestamps
+**/
+#define TIMESTAMP_BLOCK_INIT_SIZE 4
+
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+/**
+   Size (in timestamps) of the first chunk in a timestamp arena. 
+   Chunk k has TIMESTAMP_ARENA_FIRST_CHUNK << k elements, 
+   but the growth stops at TIMESTAMP_ARENA_MAX_SHIFT. 
+   Chunks are made larger if a single block does not fit.
+**/
+#define TIMESTAMP_ARENA_FIRST_CHUNK 256
+#define TIMESTAMP_ARENA_MAX_SHIFT 12
+
+/**
+   Bump allocator for the timestamp blocks of one thread. 
+
+   Only the owner thread allocates from the arena, so this needs no lock. 
+   cur_chunk is the chunk allocated from, and n_used the number
+   of used timestamp elements in this chunk. Chunks are never freed before 
+   the store is destroyed, so they are reused after a restore.
+**/
+typedef struct timestamp_arena_t {
+#ifdef HAVE_PTHREAD
+  pthread_t owner;
+#endif
+  unsigned int store_id;
+  unsigned int cur_chunk;
+  unsigned int n_used;
+  unsigned int n_chunks;
+  unsigned int size_chunks;
+  unsigned int *chunk_sizes;
+  timestamp **chunks;
+} timestamp_arena;
+
+/**
+   The position of an arena at a backup
+**/
+typedef struct timestamp_arena_mark_t {
+  unsigned int cur_chunk;
+  unsigned int n_used;
+} timestamp_arena_mark;
+#endif
+
+/**
+   With USE_TIMESTAMP_STORE_ARRAY, there is one arena per thread. 
+   The lock is then only used when a thread registers its arena, 
+   and when backing up and restoring.
+**/
+typedef struct timestamp_store_t {
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t lock;
+#endif
+  unsigned int id;
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  unsigned int n_arenas;
+  unsigned int size_arenas;
+  timestamp_arena **arenas;
+#else
+  unsigned int size_timestamp_store;
+  unsigned int n_timestamp_store;
+  timestamp_block **stores;
+#endif
+} timestamp_store;
+
+typedef struct timestamp_store_backup_t {
+  timestamp_store* store;
+#ifdef USE_TIMESTAMP_STORE_ARRAY
+  unsigned int n_arenas;
+  timestamp_arena_mark* marks;
+#else
+  unsigned int n_timestamp_store;
+#endif
+} timestamp_store_backup;
+
+
+
+timestamp_block* get_timestamp_memory(timestamp_store* store, unsigned int size, bool permanent);
+
+void init_empty_timestamp_vector(timestamps*, bool);
+#endif
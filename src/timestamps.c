@@ -22,7 +22,9 @@
    Lists or arrays of timestamps are used in substitutions, to keep
    track of the steps at which the left-hand side were first inferred.
 
-   USE_TIMESTAMP_ARRAY is defined in common.h
+   USE_TIMESTAMP_ARRAY is defined in common.h. 
+   NO_TIMESTAMPS is defined by "configure --disable-timestamps", 
+   the timestamp functions are then inlined from timestamp_none.h
 **/
 #include "common.h"
 #include "timestamps.h"
@@ -31,12 +33,32 @@
 #include "rule_instance.h"
 
 
-#ifdef USE_TIMESTAMP_ARRAY
+#if defined(NO_TIMESTAMPS)
+timestamp_store* init_timestamp_store(substitution_size_info ssi){
+  return malloc_tester(sizeof(timestamp_store));
+}
+
+void destroy_timestamp_store(timestamp_store* store){
+  free(store);
+}
+
+substitution_size_info init_sub_size_info(unsigned int n_vars, unsigned int max_lhs_conjuncts){
+  substitution_size_info ssi;
+  unsigned int size_vars = n_vars * sizeof(clp_term*);
+  ssi.max_n_timestamps = 0;
+  ssi.size_substitution = sizeof(substitution) + size_vars;
+  ssi.size_rule_instance = sizeof(rule_instance) + size_vars;
+  ssi.sub_values_offset =  0;
+  return ssi;
+}
+#elif defined(USE_TIMESTAMP_ARRAY)
 #include "timestamp_array.c"
 #else 
-#include "timestamp_linked_list.c"
+#include "timestamp_vector.c"
 #endif
 
+#ifndef NO_TIMESTAMPS
+
 
 void add_normal_timestamp(timestamps* ts, unsigned int step, timestamp_store* store){
   timestamp t;
@@ -75,4 +97,4 @@ void add_domain_timestamp(timestamps* ts, unsigned int step, timestamp_store* st
   t.init_model = false;
   add_timestamp(ts, t, store);
 }
-
+#endif
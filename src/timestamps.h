@@ -25,20 +25,24 @@
 #include "common.h"
 #include "timestamp.h"
 
-#ifdef USE_TIMESTAMP_ARRAY
+#if defined(NO_TIMESTAMPS)
+#include "timestamp_none.h"
+#elif defined(USE_TIMESTAMP_ARRAY)
 #include "timestamp_array_struct.h"
 #else
-#include "timestamp_linked_list.h"
+#include "timestamp_vector.h"
 #endif
 
 #include "substitution_size_info.h"
 
 /**
    Used to keep info about the steps that were necessary to infer a fact
-**/
 
+   With NO_TIMESTAMPS, these are inline functions in timestamp_none.h
+**/
 
 
+#ifndef NO_TIMESTAMPS
 void init_empty_timestamps(timestamps*, substitution_size_info);
 unsigned int get_n_timestamps(const timestamps*);
 
@@ -61,10 +65,12 @@ bool has_next_timestamps_iter(const timestamps_iter*);
 bool has_next_non_eq_timestamps_iter(const timestamps_iter*);
 timestamp get_next_timestamps_iter(timestamps_iter*);
 void destroy_timestamps_iter(timestamps_iter*);
-bool is_init_timestamp(timestamp);
 
 timestamp_store* init_timestamp_store(substitution_size_info);
 timestamp_store_backup backup_timestamp_store(timestamp_store*);
 timestamp_store* restore_timestamp_store(timestamp_store_backup);
+void destroy_timestamp_store_backup(timestamp_store_backup*);
 void destroy_timestamp_store(timestamp_store*);
 #endif
+bool is_init_timestamp(timestamp);
+#endif
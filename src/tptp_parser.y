@@ -37,6 +37,7 @@
 #include "axiom.h"
 #include "theory.h"
 #include "parser.h"
+#include "filereader.h"
 
  
 
@@ -44,7 +45,8 @@
   
   theory *th;
 
-  extern FILE* tptp_in;
+  extern void tptp_scan_input(input_buffer*);
+  extern void tptp_end_input(void);
   
   extern int fileno(FILE*);
   extern int tptp_lineno;
@@ -276,12 +278,18 @@ void tptp_error(YYLTYPE *locp, char const *msg){
 }
 
 
+/**
+   The input is read from memory, see filereader.h
+**/
 theory* tptp_parser(FILE* f){
+  input_buffer* input = init_input_buffer(f);
   th = create_theory();
-  tptp_in = f;
+  tptp_scan_input(input);
   tptp_lineno = 1;
   //yydebug = 1;
   tptp_parse();
+  tptp_end_input();
+  destroy_input_buffer(input);
   finalize_theory(th);
   return th;
 }
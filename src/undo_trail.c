@@ -0,0 +1,200 @@
+/* undo_trail.c
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+
+#include "common.h"
+#include "undo_trail.h"
+#include "error_handling.h"
+
+void init_undo_trail(undo_trail* trail){
+  trail->entries = NULL;
+  trail->n_entries = 0;
+  trail->size_entries = 0;
+  trail->n_backups = 0;
+  trail->generation = 0;
+  trail->next_generation = 1;
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_init(& trail->trail_mutex, NULL), __FILE__, __LINE__, "init_undo_trail: mutex init");
+#endif
+}
+
+void destroy_undo_trail(undo_trail* trail){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_destroy(& trail->trail_mutex), __FILE__, __LINE__, "destroy_undo_trail: mutex destroy");
+#endif
+  free(trail->entries);
+}
+
+/**
+   Returns a new entry at the end of the trail. 
+   Must be called with the trail locked
+**/
+undo_trail_entry* alloc_undo_trail_entry(undo_trail* trail, undo_trail_entry_type type, unsigned long generation){
+  undo_trail_entry* entry;
+  if(trail->n_entries >= trail->size_entries){
+    trail->size_entries = (trail->size_entries == 0) ? 64 : trail->size_entries * 2;
+    trail->entries = realloc_tester(trail->entries, trail->size_entries * sizeof(undo_trail_entry));
+  }
+  entry = & trail->entries[trail->n_entries];
+  trail->n_entries++;
+  entry->type = type;
+  entry->generation = generation;
+  return entry;
+}
+
+void lock_undo_trail(undo_trail* trail){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_lock(& trail->trail_mutex), __FILE__, __LINE__, "undo_trail.c: lock_undo_trail: mutex_lock");
+#endif
+}
+
+void unlock_undo_trail(undo_trail* trail){
+#ifdef HAVE_PTHREAD
+  pt_err(pthread_mutex_unlock(& trail->trail_mutex), __FILE__, __LINE__, "undo_trail.c: unlock_undo_trail: mutex_unlock");
+#endif
+}
+
+/**
+   The push functions are called by the objects before they are changed, 
+   when needs_undo_trail is true. The object must not be changed concurrently 
+   by another thread.
+**/
+void push_sub_store_undo_trail(undo_trail* trail, substitution_store* store){
+  undo_trail_entry* entry;
+  lock_undo_trail(trail);
+  entry = alloc_undo_trail_entry(trail, sub_store_undo_entry, store->trail_generation);
+  entry->object.sub_store = store;
+  entry->backup.sub_store = backup_substitution_store(store);
+  store->trail_generation = trail->generation;
+  unlock_undo_trail(trail);
+}
+
+void push_rule_queue_undo_trail(undo_trail* trail, rule_queue_single* rq){
+  undo_trail_entry* entry;
+  lock_undo_trail(trail);
+  entry = alloc_undo_trail_entry(trail, rule_queue_undo_entry, rq->trail_generation);
+  entry->object.rule_queue = rq;
+  entry->backup.rule_queue = backup_rule_queue_single(rq);
+  rq->trail_generation = trail->generation;
+  unlock_undo_trail(trail);
+}
+
+void push_worker_queue_undo_trail(undo_trail* trail, rete_worker_queue* wq){
+  undo_trail_entry* entry;
+  lock_undo_trail(trail);
+  entry = alloc_undo_trail_entry(trail, worker_queue_undo_entry, wq->trail_generation);
+  entry->object.worker_queue = wq;
+  entry->backup.worker_queue = backup_rete_worker_queue(wq);
+  wq->trail_generation = trail->generation;
+  unlock_undo_trail(trail);
+}
+
+void push_fact_store_undo_trail(undo_trail* trail, fact_store* store){
+  undo_trail_entry* entry;
+  lock_undo_trail(trail);
+  entry = alloc_undo_trail_entry(trail, fact_store_undo_entry, store->trail_generation);
+  entry->object.fact_store = store;
+  entry->backup.fact_store = backup_fact_store(store);
+  store->trail_generation = trail->generation;
+  unlock_undo_trail(trail);
+}
+
+/**
+   Called before a fact store iterator in new_facts_iters is advanced
+**/
+void push_fact_iter_undo_trail(undo_trail* trail, fact_store_iter* iter){
+  undo_trail_entry* entry;
+  if(trail->n_backups == 0)
+    return;
+  lock_undo_trail(trail);
+  entry = alloc_undo_trail_entry(trail, fact_iter_undo_entry, 0);
+  entry->object.fact_iter = iter;
+  entry->backup.fact_iter = *iter;
+  unlock_undo_trail(trail);
+}
+
+/**
+   Called from rete_state_single when in a disjunctive split. 
+   The workers must be paused.
+**/
+undo_trail_backup backup_undo_trail(undo_trail* trail){
+  undo_trail_backup backup;
+  backup.trail_mark = trail->n_entries;
+  backup.prev_generation = trail->generation;
+  backup.generation = trail->next_generation;
+  trail->next_generation++;
+  trail->generation = backup.generation;
+  trail->n_backups++;
+  return backup;
+}
+
+/**
+   Pops the entries pushed after the backup, newest first, and 
+   restores the objects in them. Each object is then as it was at the backup, 
+   and pushes itself again on the next change. 
+   The workers must be paused.
+**/
+void restore_undo_trail(undo_trail* trail, const undo_trail_backup* backup){
+  assert(trail->n_backups > 0 && backup->trail_mark <= trail->n_entries);
+  while(trail->n_entries > backup->trail_mark){
+    undo_trail_entry* entry;
+    trail->n_entries--;
+    entry = & trail->entries[trail->n_entries];
+    switch(entry->type){
+    case sub_store_undo_entry:
+      restore_substitution_store(entry->object.sub_store, entry->backup.sub_store);
+      entry->object.sub_store->trail_generation = entry->generation;
+      break;
+    case rule_queue_undo_entry:
+      restore_rule_queue_single(entry->object.rule_queue, & entry->backup.rule_queue);
+      entry->object.rule_queue->trail_generation = entry->generation;
+      break;
+    case worker_queue_undo_entry:
+      restore_rete_worker_queue(entry->object.worker_queue, & entry->backup.worker_queue);
+      entry->object.worker_queue->trail_generation = entry->generation;
+      break;
+    case fact_store_undo_entry:
+      restore_fact_store(entry->object.fact_store, entry->backup.fact_store);
+      entry->object.fact_store->trail_generation = entry->generation;
+      break;
+    case fact_iter_undo_entry:
+      *(entry->object.fact_iter) = entry->backup.fact_iter;
+      break;
+    default:
+      fprintf(stderr, "restore_undo_trail: Unknown trail entry type\n");
+      assert(false);
+      exit(EXIT_FAILURE);
+    }
+  }
+  trail->generation = backup->generation;
+}
+
+/**
+   Called when the backup is no longer needed. 
+   The entries are kept, since they are needed for restoring 
+   older backups. The trail is emptied when there are no more backups.
+**/
+void destroy_undo_trail_backup(undo_trail* trail, undo_trail_backup* backup){
+  assert(trail->n_backups > 0);
+  trail->n_backups--;
+  trail->generation = backup->prev_generation;
+  if(trail->n_backups == 0)
+    trail->n_entries = 0;
+}
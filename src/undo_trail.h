@@ -0,0 +1,121 @@
+/* undo_trail.h
+
+   Copyright 2011 
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,
+   51 Franklin Street - Fifth Floor, Boston, MA  02110-1301, USA */
+
+/*   Written 2011 by Dag Hovland, hovlanddag@gmail.com  */
+
+#ifndef __INCLUDED_UNDO_TRAIL_H
+#define __INCLUDED_UNDO_TRAIL_H
+
+#include "common.h"
+#include "substitution_store.h"
+#include "rule_queue_single.h"
+#include "rete_worker_queue.h"
+#include "fact_store.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/**
+   The undo trail of the rete state. Used for backtracking at disjunctions. 
+
+   The substitution stores, rule queues, worker queues and fact stores 
+   in the rete state point to the trail. The first time one of them is changed 
+   after a backup, it pushes its own backup on the trail, and sets its trail_generation 
+   to the generation of the trail. restore_undo_trail pops the entries pushed 
+   after the backup and restores the objects in them. So backing up is constant time, 
+   and restoring is linear in the number of objects changed since the backup. 
+
+   Each backup gets a new generation, taken from next_generation. 
+   Nothing is recorded while n_backups is 0.
+
+   The fact store iterators in new_facts_iters are only advanced when printing in 
+   verbose mode. They have no generation, and are recorded every time they are advanced.
+
+   trail_mutex is taken when pushing, since the workers push entries for 
+   the stores and queues of their own axioms concurrently.
+**/
+typedef enum undo_trail_entry_type_t { sub_store_undo_entry, rule_queue_undo_entry, worker_queue_undo_entry, fact_store_undo_entry, fact_iter_undo_entry } undo_trail_entry_type;
+
+/**
+   generation is the trail_generation of the object before the entry was pushed. 
+   It is put back by restore_undo_trail.
+**/
+typedef struct undo_trail_entry_t {
+  undo_trail_entry_type type;
+  unsigned long generation;
+  union {
+    substitution_store* sub_store;
+    rule_queue_single* rule_queue;
+    rete_worker_queue* worker_queue;
+    fact_store* fact_store;
+    fact_store_iter* fact_iter;
+  } object;
+  union {
+    substitution_store_backup sub_store;
+    rule_queue_single_backup rule_queue;
+    rete_worker_queue_backup worker_queue;
+    fact_store_backup fact_store;
+    fact_store_iter fact_iter;
+  } backup;
+} undo_trail_entry;
+
+typedef struct undo_trail_t {
+  undo_trail_entry* entries;
+  unsigned int n_entries;
+  unsigned int size_entries;
+  unsigned int n_backups;
+  unsigned long generation;
+  unsigned long next_generation;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t trail_mutex;
+#endif
+} undo_trail;
+
+/**
+   Returned by backup_undo_trail. trail_mark is the number of entries at the backup, 
+   and prev_generation the generation of the trail before the backup
+**/
+typedef struct undo_trail_backup_t {
+  unsigned int trail_mark;
+  unsigned long generation;
+  unsigned long prev_generation;
+} undo_trail_backup;
+
+void init_undo_trail(undo_trail*);
+void destroy_undo_trail(undo_trail*);
+
+undo_trail_backup backup_undo_trail(undo_trail*);
+void restore_undo_trail(undo_trail*, const undo_trail_backup*);
+void destroy_undo_trail_backup(undo_trail*, undo_trail_backup*);
+
+void push_sub_store_undo_trail(undo_trail*, substitution_store*);
+void push_rule_queue_undo_trail(undo_trail*, rule_queue_single*);
+void push_worker_queue_undo_trail(undo_trail*, rete_worker_queue*);
+void push_fact_store_undo_trail(undo_trail*, fact_store*);
+void push_fact_iter_undo_trail(undo_trail*, fact_store_iter*);
+
+/**
+   True if an object with the given trail_generation must push itself
+   on the trail before it is changed
+**/
+static inline bool needs_undo_trail(const undo_trail* trail, unsigned long generation){
+  return trail != NULL && trail->n_backups > 0 && generation != trail->generation;
+}
+
+#endif